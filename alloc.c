@@ -0,0 +1,533 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "game.h"
+#include "alloc.h"
+
+// every heap block carries a small header so frees and reallocs know what to un-track
+typedef struct
+{
+  size_t size;
+  int subsystem;
+} MemHeader;
+
+#define HEADER_SIZE ALLOC_ALIGN(sizeof(MemHeader))
+
+// the counters are shared between the game, music and SDL audio threads
+static pthread_mutex_t memLock = PTHREAD_MUTEX_INITIALIZER;
+static MemStats currentStats[MEM_SUBSYSTEM_COUNT];
+static MemStats lastStats[MEM_SUBSYSTEM_COUNT];
+static bool steadyState = false;
+static int loading = 0; // threads in the middle of loading an asset
+static bool loadedThisFrame = false; // a load overlapped the current frame, so its allocations are expected
+
+static const char* subsystemNames[MEM_SUBSYSTEM_COUNT] =
+{
+  "general", "sdl", "map", "render", "audio", "save"
+};
+
+/**
+ * This function will record a heap allocation against a subsystem
+ *
+ * @param subsystem the subsystem the memory belongs to
+ * @param size the number of bytes allocated
+ *
+ * @return void
+ */
+static void trackHeapAlloc (int subsystem, size_t size)
+{
+  pthread_mutex_lock(&memLock);
+  MemStats *stats = &currentStats[subsystem];
+  stats->liveBytes += size;
+  stats->peakBytes = max(stats->peakBytes, stats->liveBytes);
+  stats->frameBytes += size;
+  ++stats->frameAllocs;
+  ++stats->frameHeapAllocs;
+  pthread_mutex_unlock(&memLock);
+}
+
+/**
+ * This function will record a heap free against a subsystem
+ *
+ * @param subsystem the subsystem the memory belonged to
+ * @param size the number of bytes freed
+ *
+ * @return void
+ */
+static void trackHeapFree (int subsystem, size_t size)
+{
+  pthread_mutex_lock(&memLock);
+  currentStats[subsystem].liveBytes -= min(size, currentStats[subsystem].liveBytes);
+  pthread_mutex_unlock(&memLock);
+}
+
+/**
+ * This function will record an arena or pool allocation, which never touches the heap
+ *
+ * @param subsystem the subsystem the memory belongs to
+ * @param size the number of bytes handed out
+ *
+ * @return void
+ */
+static void trackTransientAlloc (int subsystem, size_t size)
+{
+  pthread_mutex_lock(&memLock);
+  currentStats[subsystem].frameBytes += size;
+  ++currentStats[subsystem].frameAllocs;
+  pthread_mutex_unlock(&memLock);
+}
+
+/**
+ * This function will allocate a tracked block from the heap
+ *
+ * @param subsystem the subsystem the memory belongs to
+ * @param size the number of bytes to allocate
+ *
+ * @return void* the block, or NULL if the heap is exhausted
+ */
+static void* headerAlloc (int subsystem, size_t size)
+{
+  MemHeader *header = malloc(HEADER_SIZE + size);
+  if (header == NULL)
+  {
+    return NULL;
+  }
+
+  header->size = size;
+  header->subsystem = subsystem;
+  trackHeapAlloc(subsystem, size);
+  return (unsigned char *) header + HEADER_SIZE;
+}
+
+/**
+ * This function will find the header of a tracked block
+ *
+ * @param ptr the block handed out by headerAlloc
+ *
+ * @return MemHeader* the header of the block
+ */
+static MemHeader* headerOf (void *ptr)
+{
+  return (MemHeader *) ((unsigned char *) ptr - HEADER_SIZE);
+}
+
+// these wrappers are handed to SDL so that everything it allocates is counted as well
+static void* sdlMalloc (size_t size)
+{
+  return headerAlloc(MEM_SDL, size);
+}
+
+static void* sdlCalloc (size_t count, size_t size)
+{
+  void *ptr = headerAlloc(MEM_SDL, count * size);
+  if (ptr != NULL)
+  {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+static void sdlFree (void *ptr)
+{
+  if (ptr == NULL)
+  {
+    return;
+  }
+
+  MemHeader *header = headerOf(ptr);
+  trackHeapFree(header->subsystem, header->size);
+  free(header);
+}
+
+static void* sdlRealloc (void *ptr, size_t size)
+{
+  if (ptr == NULL)
+  {
+    return sdlMalloc(size);
+  }
+
+  MemHeader *header = headerOf(ptr);
+  size_t oldSize = header->size;
+  int subsystem = header->subsystem;
+
+  MemHeader *resized = realloc(header, HEADER_SIZE + size);
+  if (resized == NULL)
+  {
+    return NULL;
+  }
+
+  // a realloc counts as a fresh heap allocation of the new size
+  resized->size = size;
+  trackHeapFree(subsystem, oldSize);
+  trackHeapAlloc(subsystem, size);
+  return (unsigned char *) resized + HEADER_SIZE;
+}
+
+/**
+ * This function will set up memory tracking, and must run before anything initializes SDL
+ *
+ * @return void
+ */
+void memInit (void)
+{
+  memset(currentStats, 0, sizeof(currentStats));
+  memset(lastStats, 0, sizeof(lastStats));
+  steadyState = false;
+
+  // route SDL's own allocations through the tracker
+  if (SDL_SetMemoryFunctions(sdlMalloc, sdlCalloc, sdlRealloc, sdlFree) < 0)
+  {
+    fprintf(stderr, "SDL memory functions could not be set! SDL_Error: %s\n", SDL_GetError());
+  }
+}
+
+/**
+ * This function will allocate tracked memory from the heap
+ *
+ * @param subsystem the subsystem the memory belongs to
+ * @param size the number of bytes to allocate
+ *
+ * @return void* the memory, or NULL if the heap is exhausted
+ */
+void* memAlloc (MemSubsystem subsystem, size_t size)
+{
+  return headerAlloc(subsystem, size);
+}
+
+/**
+ * This function will allocate zeroed, tracked memory from the heap
+ *
+ * @param subsystem the subsystem the memory belongs to
+ * @param count the number of elements
+ * @param size the size of each element
+ *
+ * @return void* the memory, or NULL if the heap is exhausted
+ */
+void* memCalloc (MemSubsystem subsystem, size_t count, size_t size)
+{
+  void *ptr = headerAlloc(subsystem, count * size);
+  if (ptr != NULL)
+  {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+/**
+ * This function will free memory handed out by memAlloc or memCalloc
+ *
+ * @param subsystem the subsystem the memory was allocated against (kept for readability at call sites)
+ * @param ptr the memory to free
+ *
+ * @return void
+ */
+void memFree (MemSubsystem subsystem, void *ptr)
+{
+  (void) subsystem; // the header already knows the real owner
+  sdlFree(ptr);
+}
+
+/**
+ * This function will start a new frame of per-frame counters
+ *
+ * @return void
+ */
+void memBeginFrame (void)
+{
+  pthread_mutex_lock(&memLock);
+  for (int i = 0; i < MEM_SUBSYSTEM_COUNT; ++i)
+  {
+    currentStats[i].frameBytes = 0;
+    currentStats[i].frameAllocs = 0;
+    currentStats[i].frameHeapAllocs = 0;
+  }
+  loadedThisFrame = loading > 0;
+  pthread_mutex_unlock(&memLock);
+}
+
+/**
+ * This function will close the current frame and keep its counters for reporting
+ *
+ * @return bool false if the loop is in its steady state and something touched the heap this frame
+ */
+bool memEndFrame (void)
+{
+  bool clean = true;
+
+  pthread_mutex_lock(&memLock);
+  memcpy(lastStats, currentStats, sizeof(lastStats));
+  bool loaded = loadedThisFrame;
+  pthread_mutex_unlock(&memLock);
+
+  if (steadyState && !loaded)
+  {
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; ++i)
+    {
+      if (lastStats[i].frameHeapAllocs > 0)
+      {
+        fprintf(stderr, "Steady-state heap allocation! subsystem: %s, allocations: %d, bytes: %zu\n",
+                subsystemNames[i], lastStats[i].frameHeapAllocs, lastStats[i].frameBytes);
+        clean = false;
+      }
+    }
+  }
+
+  return clean;
+}
+
+/**
+ * This function will mark whether the game loop is expected to stay off the heap
+ *
+ * @param steady true once loading is done and the loop should no longer allocate
+ *
+ * @return void
+ */
+void memSetSteadyState (bool steady)
+{
+  steadyState = steady;
+}
+
+/**
+ * This function will mark that this thread is loading an asset, the frames it overlaps may allocate
+ *
+ * @return void
+ */
+void memBeginLoad (void)
+{
+  pthread_mutex_lock(&memLock);
+  ++loading;
+  loadedThisFrame = true;
+  pthread_mutex_unlock(&memLock);
+}
+
+/**
+ * This function will mark that this thread has finished loading, the frame it ends in is still excused
+ *
+ * @return void
+ */
+void memEndLoad (void)
+{
+  pthread_mutex_lock(&memLock);
+  --loading;
+  loadedThisFrame = true;
+  pthread_mutex_unlock(&memLock);
+}
+
+/**
+ * This function will get the counters of the last finished frame
+ *
+ * @param subsystem the subsystem to look up
+ *
+ * @return const MemStats* the counters
+ */
+const MemStats* memLastFrameStats (MemSubsystem subsystem)
+{
+  return &lastStats[subsystem];
+}
+
+/**
+ * This function will get the printable name of a subsystem
+ *
+ * @param subsystem the subsystem to look up
+ *
+ * @return const char* the name
+ */
+const char* memSubsystemName (MemSubsystem subsystem)
+{
+  return subsystemNames[subsystem];
+}
+
+/**
+ * This function will print the last frame's counters for every subsystem
+ *
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void memPrintReport (FILE *out)
+{
+  fprintf(out, "MEM:");
+  for (int i = 0; i < MEM_SUBSYSTEM_COUNT; ++i)
+  {
+    fprintf(out, " %s %zuB live, %zuB/%d allocs (%d heap)", subsystemNames[i], lastStats[i].liveBytes,
+            lastStats[i].frameBytes, lastStats[i].frameAllocs, lastStats[i].frameHeapAllocs);
+  }
+  fprintf(out, "\n");
+}
+
+/**
+ * This function will set up a frame arena, the only time it touches the heap
+ *
+ * @param arena the arena to set up
+ * @param capacity the number of bytes available each frame
+ * @param subsystem the subsystem that owns the backing memory
+ *
+ * @return bool whether the arena could be allocated
+ */
+bool frameArenaInit (FrameArena *arena, size_t capacity, MemSubsystem subsystem)
+{
+  memset(arena, 0, sizeof(*arena));
+  arena->capacity = ALLOC_ALIGN(capacity);
+
+  for (int i = 0; i < 2; ++i)
+  {
+    arena->buffers[i] = memAlloc(subsystem, arena->capacity);
+    if (arena->buffers[i] == NULL)
+    {
+      fprintf(stderr, "Frame arena could not be allocated!\n");
+      frameArenaDestroy(arena, subsystem);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * This function will hand out transient memory from the current frame's buffer
+ *
+ * @param arena the arena to allocate from
+ * @param size the number of bytes needed
+ * @param subsystem the subsystem the memory is counted against
+ *
+ * @return void* the memory, or NULL if this frame's buffer is full
+ */
+void* frameArenaAlloc (FrameArena *arena, size_t size, MemSubsystem subsystem)
+{
+  size_t aligned = ALLOC_ALIGN(size);
+  size_t used = arena->used[arena->current];
+
+  // we never fall back on the heap, the caller has to cope with running out
+  if (aligned > arena->capacity - used)
+  {
+    ++arena->overflows;
+    return NULL;
+  }
+
+  arena->used[arena->current] = used + aligned;
+  arena->peakUsed = max(arena->peakUsed, used + aligned);
+  trackTransientAlloc(subsystem, aligned);
+  return arena->buffers[arena->current] + used;
+}
+
+/**
+ * This function will flip the arena to the other buffer, freeing everything from two frames ago
+ *
+ * @param arena the arena to flip
+ *
+ * @return void
+ */
+void frameArenaSwap (FrameArena *arena)
+{
+  arena->current ^= 1;
+  arena->used[arena->current] = 0;
+  arena->overflows = 0;
+}
+
+/**
+ * This function will free the buffers of a frame arena
+ *
+ * @param arena the arena to destroy
+ * @param subsystem the subsystem that owns the backing memory
+ *
+ * @return void
+ */
+void frameArenaDestroy (FrameArena *arena, MemSubsystem subsystem)
+{
+  memFree(subsystem, arena->buffers[0]);
+  memFree(subsystem, arena->buffers[1]);
+  memset(arena, 0, sizeof(*arena));
+}
+
+/**
+ * This function will set up a pool of fixed-size objects, the only time it touches the heap
+ *
+ * @param pool the pool to set up
+ * @param elementSize the size of one object
+ * @param capacity the number of objects in the pool
+ * @param subsystem the subsystem the pool is counted against
+ *
+ * @return bool whether the pool could be allocated
+ */
+bool objectPoolInit (ObjectPool *pool, size_t elementSize, int capacity, MemSubsystem subsystem)
+{
+  memset(pool, 0, sizeof(*pool));
+
+  // free slots store the next pointer in place, so every slot needs room for one
+  pool->elementSize = ALLOC_ALIGN(max(elementSize, sizeof(void *)));
+  pool->capacity = capacity;
+  pool->subsystem = subsystem;
+  pool->storage = memAlloc(subsystem, pool->elementSize * capacity);
+  if (pool->storage == NULL)
+  {
+    fprintf(stderr, "Object pool could not be allocated!\n");
+    return false;
+  }
+
+  // thread every slot onto the free list, first slot first
+  for (int i = capacity - 1; i >= 0; --i)
+  {
+    void *slot = pool->storage + pool->elementSize * i;
+    *(void **) slot = pool->freeList;
+    pool->freeList = slot;
+  }
+
+  return true;
+}
+
+/**
+ * This function will take an object out of the pool
+ *
+ * @param pool the pool to take from
+ *
+ * @return void* the zeroed object, or NULL if the pool is empty
+ */
+void* objectPoolAcquire (ObjectPool *pool)
+{
+  void *slot = pool->freeList;
+  if (slot == NULL)
+  {
+    return NULL;
+  }
+
+  pool->freeList = *(void **) slot;
+  ++pool->liveCount;
+  memset(slot, 0, pool->elementSize);
+  trackTransientAlloc(pool->subsystem, pool->elementSize);
+  return slot;
+}
+
+/**
+ * This function will return an object to the pool
+ *
+ * @param pool the pool the object came from
+ * @param object the object to return
+ *
+ * @return void
+ */
+void objectPoolRelease (ObjectPool *pool, void *object)
+{
+  if (object == NULL)
+  {
+    return;
+  }
+
+  *(void **) object = pool->freeList;
+  pool->freeList = object;
+  --pool->liveCount;
+}
+
+/**
+ * This function will free the storage of a pool
+ *
+ * @param pool the pool to destroy
+ *
+ * @return void
+ */
+void objectPoolDestroy (ObjectPool *pool)
+{
+  memFree(pool->subsystem, pool->storage);
+  memset(pool, 0, sizeof(*pool));
+}
@@ -0,0 +1,89 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <SDL.h>
+
+// every allocation is aligned to this many bytes (enough for SDL_FRect, doubles and pointers)
+#define ALLOC_ALIGNMENT 16
+
+// round a size up to the allocation alignment
+#define ALLOC_ALIGN(size) (((size) + (ALLOC_ALIGNMENT - 1)) & ~((size_t) ALLOC_ALIGNMENT - 1))
+
+// the subsystems that memory usage is reported against
+typedef enum
+{
+  MEM_GENERAL,
+  MEM_SDL,     // anything SDL, SDL_image or SDL_mixer allocates internally
+  MEM_MAP,
+  MEM_RENDER,
+  MEM_AUDIO,
+  MEM_SAVE,
+  MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+// the counters kept for each subsystem
+typedef struct
+{
+  size_t liveBytes;      // heap bytes currently allocated
+  size_t peakBytes;      // highest value liveBytes has reached
+  size_t frameBytes;     // bytes handed out this frame (heap, arena and pool)
+  int frameAllocs;       // allocations made this frame (heap, arena and pool)
+  int frameHeapAllocs;   // allocations this frame that went to the heap
+} MemStats;
+
+// a double-buffered bump allocator for memory that only lives for a frame or two
+// memory handed out in frame N stays valid until the start of frame N + 2
+typedef struct
+{
+  unsigned char *buffers[2];
+  size_t capacity; // capacity of each buffer
+  size_t used[2];
+  int current; // the buffer that allocations currently come from
+  size_t peakUsed; // highest number of bytes used in a single frame
+  int overflows; // allocations that did not fit this frame
+} FrameArena;
+
+// a pool of fixed-size objects with an intrusive free list
+typedef struct
+{
+  unsigned char *storage;
+  void *freeList;
+  size_t elementSize;
+  int capacity;
+  int liveCount;
+  MemSubsystem subsystem;
+} ObjectPool;
+
+// typed helpers so callers do not have to cast or pass sizeof by hand
+#define POOL_INIT(pool, Type, count, subsystem) objectPoolInit((pool), sizeof(Type), (count), (subsystem))
+#define POOL_ACQUIRE(pool, Type) ((Type *) objectPoolAcquire(pool))
+#define ARENA_ALLOC(arena, Type, count, subsystem) \
+  ((Type *) frameArenaAlloc((arena), sizeof(Type) * (count), (subsystem)))
+
+void memInit(void);
+void* memAlloc(MemSubsystem subsystem, size_t size);
+void* memCalloc(MemSubsystem subsystem, size_t count, size_t size);
+void memFree(MemSubsystem subsystem, void *ptr);
+void memBeginFrame(void);
+bool memEndFrame(void);
+void memSetSteadyState(bool steady);
+void memBeginLoad(void);
+void memEndLoad(void);
+const MemStats* memLastFrameStats(MemSubsystem subsystem);
+const char* memSubsystemName(MemSubsystem subsystem);
+void memPrintReport(FILE *out);
+
+bool frameArenaInit(FrameArena *arena, size_t capacity, MemSubsystem subsystem);
+void* frameArenaAlloc(FrameArena *arena, size_t size, MemSubsystem subsystem);
+void frameArenaSwap(FrameArena *arena);
+void frameArenaDestroy(FrameArena *arena, MemSubsystem subsystem);
+
+bool objectPoolInit(ObjectPool *pool, size_t elementSize, int capacity, MemSubsystem subsystem);
+void* objectPoolAcquire(ObjectPool *pool);
+void objectPoolRelease(ObjectPool *pool, void *object);
+void objectPoolDestroy(ObjectPool *pool);
+
+#endif
@@ -0,0 +1,181 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "sim.h"
+#include "state.h"
+#include "batch.h"
+
+// the slice of games one worker thread steps
+typedef struct
+{
+  GameInstance *instances;
+  int first;
+  int count;
+  int steps;
+  long long warps; // map switches seen by this worker
+} BatchWorker;
+
+/**
+ * This function will advance a bot's random number generator (xorshift32)
+ *
+ * @param state the generator state, never zero
+ *
+ * @return Uint32 the next random number
+ */
+static Uint32 nextRandom (Uint32 *state)
+{
+  Uint32 x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/**
+ * This function will pick a bot's keys for the next step, mostly walking on in the same direction
+ *
+ * @param input the input state to fill in
+ * @param rng the bot's random number generator
+ *
+ * @return void
+ */
+void botInput (InputState *input, Uint32 *rng)
+{
+  Uint32 roll = nextRandom(rng);
+
+  // three times out of four the bot keeps doing what it was doing
+  if ((roll & 3) != 0)
+  {
+    return;
+  }
+
+  memset(input, 0, sizeof(*input));
+  int choice = (roll >> 2) % (INPUT_DIRECTION_COUNT + 1);
+  if (choice < INPUT_DIRECTION_COUNT)
+  {
+    input->held[choice] = true;
+  }
+}
+
+/**
+ * This thread function will step its slice of games, each game runs all of its steps before the next
+ *
+ * @param arg the worker's slice
+ *
+ * @return void
+ */
+static void* batchWorker (void *arg)
+{
+  BatchWorker *worker = arg;
+
+  for (int i = worker->first; i < worker->first + worker->count; ++i)
+  {
+    GameInstance *instance = &worker->instances[i];
+    InputState input = {0};
+    Uint32 rng = (Uint32) (i + 1) * 2654435761u; // seeded by index, so results never depend on threads
+    Uint32 clock = 0;
+
+    for (int step = 0; step < worker->steps; ++step)
+    {
+      int mapBefore = (*instance).chooseMap;
+
+      botInput(&input, &rng);
+      clock += BATCH_TICK_MS;
+      updateGame(instance, &input, NULL, clock);
+
+      if ((*instance).chooseMap != mapBefore)
+      {
+        ++worker->warps;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * This function will step many independent headless games in parallel across all cores
+ *
+ * @param instanceCount the number of games
+ * @param steps the number of steps each game is advanced
+ * @param threadCount the number of worker threads, 0 for one per core
+ *
+ * @return bool whether the batch ran
+ */
+bool runBatch (int instanceCount, int steps, int threadCount)
+{
+  if (instanceCount <= 0 || steps <= 0)
+  {
+    fprintf(stderr, "Usage: ./game --batch <instances> <steps> [threads]\n");
+    return false;
+  }
+
+  if (threadCount <= 0)
+  {
+    threadCount = SDL_GetCPUCount();
+  }
+  threadCount = max(1, min(min(threadCount, MAX_BATCH_THREADS), instanceCount));
+
+  GameInstance *instances = memCalloc(MEM_GENERAL, instanceCount, sizeof(GameInstance));
+  if (instances == NULL)
+  {
+    fprintf(stderr, "Batch instances could not be allocated!\n");
+    return false;
+  }
+
+  for (int i = 0; i < instanceCount; ++i)
+  {
+    gameInstanceInit(&instances[i]);
+  }
+
+  // hand each worker a contiguous slice, so no two threads ever touch the same game
+  BatchWorker workers[MAX_BATCH_THREADS];
+  pthread_t threads[MAX_BATCH_THREADS];
+  bool started[MAX_BATCH_THREADS];
+  int first = 0;
+  Uint64 start = SDL_GetPerformanceCounter();
+
+  for (int t = 0; t < threadCount; ++t)
+  {
+    int count = instanceCount / threadCount + (t < instanceCount % threadCount ? 1 : 0);
+    workers[t] = (BatchWorker) {instances, first, count, steps, 0};
+    first += count;
+
+    started[t] = pthread_create(&threads[t], NULL, batchWorker, &workers[t]) == 0;
+    if (!started[t])
+    {
+      // run the slice on this thread instead
+      batchWorker(&workers[t]);
+    }
+  }
+
+  long long warps = 0;
+  for (int t = 0; t < threadCount; ++t)
+  {
+    if (started[t])
+    {
+      pthread_join(threads[t], NULL);
+    }
+    warps += workers[t].warps;
+  }
+
+  double seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+  // a checksum of every final state, identical for any thread count
+  Uint64 checksum = 0;
+  for (int i = 0; i < instanceCount; ++i)
+  {
+    checksum = checksum * 31 + gameInstanceHash(&instances[i]);
+  }
+
+  double totalSteps = (double) instanceCount * steps;
+  printf("BATCH: %d instances x %d steps on %d threads in %.3f s, %.2f million steps/s, %lld map switches, checksum %016llx\n",
+         instanceCount, steps, threadCount, seconds, totalSteps / seconds / 1e6, warps, (unsigned long long) checksum);
+
+  memFree(MEM_GENERAL, instances);
+  return true;
+}
@@ -0,0 +1,14 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include "game.h"
+#include "input.h"
+
+#define BATCH_TICK_MS MOVEMENT_DELAY // each batch step advances a game's clock by one movement window
+#define MAX_BATCH_THREADS 256
+
+void botInput(InputState *input, Uint32 *rng);
+bool runBatch(int instanceCount, int steps, int threadCount);
+
+#endif
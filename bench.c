@@ -0,0 +1,765 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "game.h"
+#include "alloc.h"
+#include "input.h"
+#include "tiles.h"
+#include "sim.h"
+#include "batch.h"
+#include "script.h"
+#include "renderstats.h"
+#include "palette.h"
+#include "timer.h"
+#include "particles.h"
+#include "spritebatch.h"
+
+#define BENCH_SAMPLES 15 // timed samples per benchmark, the median is reported
+#define BENCH_SAMPLE_MS 20 // each sample runs for at least this long
+#define BENCH_TOLERANCE_PCT 10.0 // slower than the baseline by more than this, or by 3 deviations, is a regression
+#define BENCH_MAX_RESULTS 32
+#define SAVE_PATH "save_data/save.txt"
+#define BENCH_TIMERS 100000 // repeating timers kept running for the timer wheel benchmark
+#define BENCH_PARTICLES 100000 // live particles kept on the screen for the particle benchmarks
+#define BENCH_SPRITE_TEXTURES 4 // textures the sprite benchmarks cut their sprites from
+
+// the game thread's functions being measured, from game.c built without its main
+void calculateSrcRect(SDL_Rect *srcRect, Direction direction, int currentFrame);
+int loadTextures(SDL_Texture **textures, SDL_Renderer **renderer, TileSet *tileSet);
+void destroyTextures(SDL_Texture **textures, int textureCount);
+
+// one benchmark, run is handed how many times to repeat the operation
+typedef struct
+{
+  const char *name;
+  void (*run)(int iterations);
+  bool needsRenderer;
+} Benchmark;
+
+// what a benchmark measured, per operation
+typedef struct
+{
+  char name[64];
+  int iterations; // operations per sample
+  double medianNs;
+  double minNs;
+  double deviationPct; // median absolute deviation of the samples, relative to the median
+} BenchResult;
+
+// results are folded in here so the compiler cannot drop the work
+static volatile Uint64 sink;
+
+// the software renderer and textures shared by the drawing benchmarks
+static SDL_Window *window = NULL;
+static SDL_Renderer *renderer = NULL;
+static SDL_Texture *textures[MAX_GAME_TEXTURES];
+static int textureCount = 0;
+static TileSet tileSet;
+static MapLayer bakedLayer;
+static TileFrameTable tileFrames;
+
+/**
+ * This function will load each of the three maps in turn
+ *
+ * @param iterations the number of maps to load
+ *
+ * @return void
+ */
+static void benchLoadMap (int iterations)
+{
+  int map[MAP_ROWS][MAP_COLS];
+  for (int i = 0; i < iterations; ++i)
+  {
+    loadMap(map, (MapType) (i % 3));
+    sink += (Uint64) map[i % MAP_ROWS][i % MAP_COLS];
+  }
+}
+
+/**
+ * This function will work out the sprite frame for every direction and frame
+ *
+ * @param iterations the number of frames to work out
+ *
+ * @return void
+ */
+static void benchCalculateSrcRect (int iterations)
+{
+  SDL_Rect srcRect;
+  for (int i = 0; i < iterations; ++i)
+  {
+    calculateSrcRect(&srcRect, (Direction) (i & 7), (i >> 3) % SPRITE_FRAMES);
+    sink += (Uint64) (srcRect.x + srcRect.y);
+  }
+}
+
+/**
+ * This function will check every cell of every map for collision
+ *
+ * @param iterations the number of cells to check
+ *
+ * @return void
+ */
+static void benchCollision (int iterations)
+{
+  static int maps[3][MAP_ROWS][MAP_COLS];
+  static bool loaded = false;
+  if (!loaded)
+  {
+    for (int m = 0; m < 3; ++m)
+    {
+      loadMap(maps[m], (MapType) m);
+    }
+    loaded = true;
+  }
+
+  int cells = MAP_ROWS * MAP_COLS;
+  for (int i = 0; i < iterations; ++i)
+  {
+    int cell = i % (3 * cells);
+    sink += tileIsWalkable(maps[cell / cells][(cell % cells) / MAP_COLS][cell % MAP_COLS]) ? 1 : 0;
+  }
+}
+
+/**
+ * This function will step a game with a bot at the keys, which runs the collision checks and the warp triggers
+ *
+ * @param iterations the number of steps
+ *
+ * @return void
+ */
+static void benchUpdateGame (int iterations)
+{
+  // every run starts from the same game, so every sample does the same work
+  GameInstance instance;
+  InputState input = {0};
+  Uint32 rng = 2654435761u;
+  Uint32 clock = 0;
+  gameInstanceInit(&instance);
+
+  for (int i = 0; i < iterations; ++i)
+  {
+    botInput(&input, &rng);
+    clock += MOVEMENT_DELAY;
+    updateGame(&instance, &input, NULL, clock);
+  }
+  sink += (Uint64) (instance.player.x + instance.player.y + instance.chooseMap);
+}
+
+/**
+ * This function will save the game and load it back
+ *
+ * @param iterations the number of saves and loads
+ *
+ * @return void
+ */
+static void benchSaveLoad (int iterations)
+{
+  GameInstance instance;
+  gameInstanceInit(&instance);
+
+  for (int i = 0; i < iterations; ++i)
+  {
+    saveGame(instance.player.x, instance.player.y, mapNameOf(instance.chooseMap), instance.musicSelector);
+    loadGame(&instance.loadError, &instance.player, instance.map, &instance.chooseMap, &instance.musicSelector);
+  }
+  sink += (Uint64) instance.player.x;
+}
+
+/**
+ * This function will advance a timer wheel one millisecond at a time with 100k repeating timers on it
+ *
+ * @param iterations the number of milliseconds
+ *
+ * @return void
+ */
+static void benchTimerTick (int iterations)
+{
+  // the timers repeat every 1 to 60 seconds, so the wheel stays as full as it started for every sample
+  static TimerWheel wheel;
+  if (wheel.nodes == NULL)
+  {
+    Uint32 rng = 2654435761u;
+    timerWheelInit(&wheel, BENCH_TIMERS, 0);
+    for (int i = 0; i < BENCH_TIMERS; ++i)
+    {
+      rng = rng * 1664525u + 1013904223u;
+      timerSchedule(&wheel, 1 + (rng >> 8) % 60000, 1000 + (rng >> 12) % 59000, NULL, NULL);
+    }
+  }
+
+  for (int i = 0; i < iterations; ++i)
+  {
+    sink += (Uint64) timerWheelAdvance(&wheel, wheel.current + 1);
+  }
+}
+
+/**
+ * This function will fill a particle system with snow that lives for as long as the benchmarks run
+ *
+ * @return ParticleSystem* the particles, shared by the particle benchmarks
+ */
+static ParticleSystem* benchParticles (void)
+{
+  static ParticleSystem particles;
+  if (particles.x == NULL)
+  {
+    particleSystemInit(&particles);
+    for (int i = 0; i < BENCH_PARTICLES; ++i)
+    {
+      particleEmit(&particles, PARTICLE_SNOW, (float) (i % X_RESOLUTION), (float) (i % Y_RESOLUTION), 1);
+    }
+    for (int i = 0; i < particles.count; ++i)
+    {
+      particles.vx[i] = 0.0f;
+      particles.vy[i] = 0.0f;
+      particles.life[i] = 1e9f;
+    }
+  }
+  return &particles;
+}
+
+/**
+ * This function will step 100k particles, moving, ageing and culling them
+ *
+ * @param iterations the number of steps
+ *
+ * @return void
+ */
+static void benchParticleUpdate (int iterations)
+{
+  ParticleSystem *particles = benchParticles();
+  for (int i = 0; i < iterations; ++i)
+  {
+    particleUpdate(particles, 1.0f / 60.0f);
+  }
+  sink += (Uint64) (*particles).count;
+}
+
+/**
+ * This function will draw 100k particles in their one geometry submission
+ *
+ * @param iterations the number of frames
+ *
+ * @return void
+ */
+static void benchParticleDraw (int iterations)
+{
+  ParticleSystem *particles = benchParticles();
+  for (int i = 0; i < iterations; ++i)
+  {
+    renderClear(renderer);
+    particleDraw(particles, renderer);
+    renderPresent(renderer);
+  }
+}
+
+/**
+ * This function will add a full batch of overlapping sprites, scattered over the screen and its layers
+ *
+ * @param batch the sprite batch to fill
+ *
+ * @return void
+ */
+static void benchFillSprites (SpriteBatch *batch)
+{
+  SDL_Rect src = {0, 0, TILE_WIDTH, TILE_HEIGHT};
+  Uint32 rng = 1;
+  for (int i = 0; i < SPRITE_BATCH_CAPACITY; ++i)
+  {
+    rng = rng * 1664525u + 1013904223u;
+    spriteBatchAdd(batch, (SpriteLayer) (i % SPRITE_LAYER_COUNT), (int) ((rng >> 8) % BENCH_SPRITE_TEXTURES), &src,
+                   (int) ((rng >> 12) % X_RESOLUTION), (int) ((rng >> 20) % (Y_RESOLUTION + TILE_HEIGHT)));
+  }
+}
+
+/**
+ * This function will set up the sprite batch the sprite benchmarks share, with its own frame arena
+ *
+ * @return SpriteBatch* the sprite batch
+ */
+static SpriteBatch* benchSpriteBatch (void)
+{
+  static FrameArena arena;
+  static SpriteBatch batch;
+  if (batch.sprites == NULL)
+  {
+    frameArenaInit(&arena, FRAME_ARENA_SIZE, MEM_RENDER);
+    spriteBatchInit(&batch, &arena);
+  }
+  frameArenaSwap(&arena);
+  return &batch;
+}
+
+/**
+ * This function will sort a full batch of sprites into drawing order
+ *
+ * @param iterations the number of batches
+ *
+ * @return void
+ */
+static void benchSpriteSort (int iterations)
+{
+  for (int i = 0; i < iterations; ++i)
+  {
+    SpriteBatch *batch = benchSpriteBatch();
+    benchFillSprites(batch);
+    sink += (Uint64) spriteBatchSort(batch)[0].key;
+    (*batch).count = 0;
+  }
+}
+
+/**
+ * This function will draw a full batch of sprites, sorted and merged into runs that share a texture
+ *
+ * @param iterations the number of frames
+ *
+ * @return void
+ */
+static void benchSpriteDraw (int iterations)
+{
+  for (int i = 0; i < iterations; ++i)
+  {
+    SpriteBatch *batch = benchSpriteBatch();
+    renderClear(renderer);
+    benchFillSprites(batch);
+    spriteBatchDraw(batch, renderer, textures);
+    renderPresent(renderer);
+  }
+}
+
+/**
+ * This function will load every game texture and free them again
+ *
+ * @param iterations the number of times to load the textures
+ *
+ * @return void
+ */
+static void benchLoadTextures (int iterations)
+{
+  SDL_Texture *loaded[MAX_GAME_TEXTURES];
+  for (int i = 0; i < iterations; ++i)
+  {
+    TileSet set;
+    tileSetInit(&set);
+    int count = loadTextures(loaded, &renderer, &set);
+    destroyTextures(loaded, count);
+    tileSetDestroy(&set);
+    sink += (Uint64) count;
+  }
+}
+
+/**
+ * This function will swap every loaded image between the day and night palettes
+ *
+ * @param iterations the number of palette swaps
+ *
+ * @return void
+ */
+static void benchPaletteSwap (int iterations)
+{
+  for (int i = 0; i < iterations; ++i)
+  {
+    tileSetApply(&tileSet, tileSet.mode == PALETTE_DAY ? PALETTE_NIGHT : PALETTE_DAY);
+    sink += (Uint64) tileSet.mode;
+  }
+}
+
+/**
+ * This function will draw whole frames of the map tile by tile, the way a renderer without targets draws it
+ *
+ * @param iterations the number of frames
+ *
+ * @return void
+ */
+static void benchDrawTiles (int iterations)
+{
+  int map[MAP_ROWS][MAP_COLS];
+  loadMap(map, PERLLERT_TOWN);
+
+  for (int i = 0; i < iterations; ++i)
+  {
+    MapLayer direct = {0};
+    renderClear(renderer);
+    mapLayerDraw(&direct, renderer, map, &tileFrames, textures);
+    renderPresent(renderer);
+  }
+}
+
+/**
+ * This function will draw whole frames of the map from the baked layer
+ *
+ * @param iterations the number of frames
+ *
+ * @return void
+ */
+static void benchDrawBaked (int iterations)
+{
+  int map[MAP_ROWS][MAP_COLS];
+  loadMap(map, PERLLERT_TOWN);
+
+  for (int i = 0; i < iterations; ++i)
+  {
+    renderClear(renderer);
+    mapLayerUpdate(&bakedLayer, renderer, map, &tileFrames, textures);
+    mapLayerDraw(&bakedLayer, renderer, map, &tileFrames, textures);
+    renderPresent(renderer);
+  }
+}
+
+static const Benchmark benchmarks[] =
+{
+  {"loadMap", benchLoadMap, false},
+  {"calculateSrcRect", benchCalculateSrcRect, false},
+  {"tileIsWalkable", benchCollision, false},
+  {"updateGame", benchUpdateGame, false},
+  {"saveGame+loadGame", benchSaveLoad, false},
+  {"timerTick100k", benchTimerTick, false},
+  {"particleUpdate100k", benchParticleUpdate, false},
+  {"spriteSort4k", benchSpriteSort, false},
+  {"loadTextures", benchLoadTextures, true},
+  {"paletteSwap", benchPaletteSwap, true},
+  {"drawTiles", benchDrawTiles, true},
+  {"drawBaked", benchDrawBaked, true},
+  {"particleDraw100k", benchParticleDraw, true},
+  {"spriteDraw4k", benchSpriteDraw, true},
+};
+
+/**
+ * This function will open a hidden window with a software renderer and load the game textures
+ *
+ * Textures that fail to load are replaced by a plain tile, so the draw benchmarks still draw something.
+ *
+ * @return bool whether a renderer could be made
+ */
+static bool openRenderer (void)
+{
+  // the dummy driver is enough for the software renderer and needs no display
+  SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+  if (SDL_Init(SDL_INIT_VIDEO) < 0)
+  {
+    fprintf(stderr, "SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+  IMG_Init(IMG_INIT_PNG);
+
+  window = SDL_CreateWindow("bench", 0, 0, X_RESOLUTION, Y_RESOLUTION, SDL_WINDOW_HIDDEN);
+  renderer = window != NULL ? SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE) : NULL;
+  if (renderer == NULL)
+  {
+    fprintf(stderr, "Software renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  tileSetInit(&tileSet);
+  textureCount = loadTextures(textures, &renderer, &tileSet);
+  Uint32 pixels[TILE_WIDTH * TILE_HEIGHT];
+  for (int i = 0; i < TILE_WIDTH * TILE_HEIGHT; ++i)
+  {
+    pixels[i] = 0xFF808080u;
+  }
+  for (int i = 0; i < textureCount; ++i)
+  {
+    if (textures[i] == NULL)
+    {
+      textures[i] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, TILE_WIDTH, TILE_HEIGHT);
+      SDL_UpdateTexture(textures[i], NULL, pixels, TILE_WIDTH * sizeof(Uint32));
+    }
+  }
+
+  tileFrameTableInit(&tileFrames);
+  mapLayerInit(&bakedLayer, renderer);
+  return true;
+}
+
+/**
+ * This function will free the renderer and textures
+ *
+ * @return void
+ */
+static void closeRenderer (void)
+{
+  mapLayerDestroy(&bakedLayer);
+  destroyTextures(textures, textureCount);
+  tileSetDestroy(&tileSet);
+  if (renderer != NULL)
+  {
+    SDL_DestroyRenderer(renderer);
+  }
+  if (window != NULL)
+  {
+    SDL_DestroyWindow(window);
+  }
+  IMG_Quit();
+  SDL_Quit();
+}
+
+/**
+ * This function will compare two doubles for qsort
+ *
+ * @param a the first double
+ * @param b the second double
+ *
+ * @return int the order of the two
+ */
+static int compareDoubles (const void *a, const void *b)
+{
+  double x = *(const double*) a, y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * This function will time a benchmark, sized so each sample runs long enough for the clock to be trusted
+ *
+ * One untimed sample warms the caches first, then the median of the samples is taken so a stray
+ * interruption does not move the result.
+ *
+ * @param benchmark the benchmark
+ * @param result the measurement
+ *
+ * @return void
+ */
+static void measure (const Benchmark *benchmark, BenchResult *result)
+{
+  double frequency = (double) SDL_GetPerformanceFrequency();
+  int iterations = 1;
+
+  // double the work until one sample is long enough
+  while (true)
+  {
+    Uint64 start = SDL_GetPerformanceCounter();
+    (*benchmark).run(iterations);
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+    if (ms >= BENCH_SAMPLE_MS || iterations >= (1 << 28))
+    {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  double samples[BENCH_SAMPLES];
+  for (int s = 0; s < BENCH_SAMPLES; ++s)
+  {
+    Uint64 start = SDL_GetPerformanceCounter();
+    (*benchmark).run(iterations);
+    samples[s] = (SDL_GetPerformanceCounter() - start) * 1e9 / frequency / iterations;
+  }
+  qsort(samples, BENCH_SAMPLES, sizeof(double), compareDoubles);
+
+  double median = samples[BENCH_SAMPLES / 2];
+  double deviations[BENCH_SAMPLES];
+  for (int s = 0; s < BENCH_SAMPLES; ++s)
+  {
+    deviations[s] = samples[s] > median ? samples[s] - median : median - samples[s];
+  }
+  qsort(deviations, BENCH_SAMPLES, sizeof(double), compareDoubles);
+
+  snprintf((*result).name, sizeof((*result).name), "%s", (*benchmark).name);
+  (*result).iterations = iterations;
+  (*result).medianNs = median;
+  (*result).minNs = samples[0];
+  (*result).deviationPct = median > 0 ? deviations[BENCH_SAMPLES / 2] * 100.0 / median : 0.0;
+}
+
+/**
+ * This function will write the results as JSON, one benchmark per line so the file is easy to diff and read back
+ *
+ * @param out the stream to write to
+ * @param results the results
+ * @param resultCount the number of results
+ *
+ * @return void
+ */
+static void writeResults (FILE *out, const BenchResult *results, int resultCount)
+{
+  fprintf(out, "{\n  \"samples\": %d,\n  \"benchmarks\": [\n", BENCH_SAMPLES);
+  for (int i = 0; i < resultCount; ++i)
+  {
+    fprintf(out, "    {\"name\": \"%s\", \"iterations\": %d, \"median_ns\": %.3f, \"min_ns\": %.3f, \"mad_pct\": %.2f}%s\n",
+            results[i].name, results[i].iterations, results[i].medianNs, results[i].minNs, results[i].deviationPct,
+            i + 1 < resultCount ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+/**
+ * This function will read the results from an earlier run
+ *
+ * @param path the JSON file an earlier run wrote
+ * @param results the results read
+ *
+ * @return int the number of results, -1 when the file could not be read
+ */
+static int readResults (const char *path, BenchResult *results)
+{
+  FILE *file = fopen(path, "r");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Could not read the baseline %s\n", path);
+    return -1;
+  }
+
+  char line[512];
+  int count = 0;
+  while (fgets(line, sizeof(line), file) != NULL && count < BENCH_MAX_RESULTS)
+  {
+    BenchResult *result = &results[count];
+    if (sscanf(line, " {\"name\": \"%63[^\"]\", \"iterations\": %d, \"median_ns\": %lf, \"min_ns\": %lf, \"mad_pct\": %lf",
+               (*result).name, &(*result).iterations, &(*result).medianNs, &(*result).minNs, &(*result).deviationPct) == 5)
+    {
+      ++count;
+    }
+  }
+
+  fclose(file);
+  return count;
+}
+
+/**
+ * This function will print each result against the baseline and count the regressions
+ *
+ * @param results this run's results
+ * @param resultCount the number of results
+ * @param baseline the baseline's results
+ * @param baselineCount the number of baseline results
+ *
+ * @return int the number of benchmarks that got slower than the tolerance allows
+ */
+static int compareResults (const BenchResult *results, int resultCount, const BenchResult *baseline, int baselineCount)
+{
+  int regressions = 0;
+  for (int i = 0; i < resultCount; ++i)
+  {
+    const BenchResult *before = NULL;
+    for (int j = 0; j < baselineCount; ++j)
+    {
+      if (strcmp(results[i].name, baseline[j].name) == 0)
+      {
+        before = &baseline[j];
+      }
+    }
+    if (before == NULL)
+    {
+      fprintf(stderr, "%-20s %12.1f ns  (not in baseline)\n", results[i].name, results[i].medianNs);
+      continue;
+    }
+
+    // noisy benchmarks get more room before a slowdown counts
+    double change = ((*before).medianNs > 0 ? results[i].medianNs / (*before).medianNs - 1.0 : 0.0) * 100.0;
+    double tolerance = max(BENCH_TOLERANCE_PCT, 3.0 * max(results[i].deviationPct, (*before).deviationPct));
+    bool regressed = change > tolerance;
+    regressions += regressed ? 1 : 0;
+    fprintf(stderr, "%-20s %12.1f ns  baseline %12.1f ns  %+7.1f%%%s\n", results[i].name, results[i].medianNs,
+            (*before).medianNs, change, regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+/**
+ * This is the main function of the benchmark runner
+ *
+ * "./bench_runner [--out results.json] [--baseline earlier.json] [--filter name]" runs every benchmark whose
+ * name contains the filter, writes the results as JSON (to stdout without --out) and, with a baseline,
+ * exits with a non-zero status when any benchmark regressed.
+ *
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ *
+ * @return 0 when nothing regressed
+ */
+int main (int argc, char* argv[])
+{
+  const char *outPath = NULL, *baselinePath = NULL, *filter = NULL;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "--out") == 0)
+    {
+      outPath = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "--baseline") == 0)
+    {
+      baselinePath = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "--filter") == 0)
+    {
+      filter = argv[i + 1];
+    }
+  }
+
+  memInit();
+  loadTriggerScripts(TRIGGER_SCRIPT_PATH);
+  renderStatsInit(RENDER_BUDGETS_PATH);
+
+  // saving overwrites the player's save, so keep it and put it back afterwards
+  char savedGame[4096];
+  size_t savedSize = 0;
+  FILE *save = fopen(SAVE_PATH, "rb");
+  bool hadSave = save != NULL;
+  if (hadSave)
+  {
+    savedSize = fread(savedGame, 1, sizeof(savedGame), save);
+    fclose(save);
+  }
+
+  bool haveRenderer = openRenderer();
+  BenchResult results[BENCH_MAX_RESULTS];
+  int resultCount = 0;
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+  {
+    if ((filter != NULL && strstr(benchmarks[i].name, filter) == NULL) || (benchmarks[i].needsRenderer && !haveRenderer))
+    {
+      continue;
+    }
+    measure(&benchmarks[i], &results[resultCount]);
+    fprintf(stderr, "%-20s %12.1f ns/op (min %.1f, deviation %.1f%%, %d per sample)\n", results[resultCount].name,
+            results[resultCount].medianNs, results[resultCount].minNs, results[resultCount].deviationPct,
+            results[resultCount].iterations);
+    ++resultCount;
+  }
+  closeRenderer();
+
+  if (hadSave)
+  {
+    save = fopen(SAVE_PATH, "wb");
+    if (save != NULL)
+    {
+      fwrite(savedGame, 1, savedSize, save);
+      fclose(save);
+    }
+  }
+  else
+  {
+    remove(SAVE_PATH);
+    remove("save_data"); // only goes if the benchmark made it and left it empty
+  }
+
+  FILE *out = outPath != NULL ? fopen(outPath, "w") : stdout;
+  if (out == NULL)
+  {
+    fprintf(stderr, "Could not write the results to %s\n", outPath);
+    return EXIT_FAILURE;
+  }
+  writeResults(out, results, resultCount);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+
+  if (baselinePath != NULL)
+  {
+    BenchResult baseline[BENCH_MAX_RESULTS];
+    int baselineCount = readResults(baselinePath, baseline);
+    if (baselineCount < 0)
+    {
+      return EXIT_FAILURE;
+    }
+    int regressions = compareResults(results, resultCount, baseline, baselineCount);
+    fprintf(stderr, "%d of %d benchmarks regressed\n", regressions, resultCount);
+    return regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
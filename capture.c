@@ -0,0 +1,473 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "renderstats.h"
+#include "capture.h"
+
+// the worst case of the run encoding, every 128 bytes costing one control byte
+#define CAPTURE_MAX_ENCODED (CAPTURE_FRAME_BYTES + CAPTURE_FRAME_BYTES / 128 + 1)
+
+/**
+ * This function will write a number to the file as little endian bytes
+ *
+ * @param file the file
+ * @param value the number
+ * @param bytes how many bytes to write
+ *
+ * @return void
+ */
+static void writeNumber (FILE *file, Uint32 value, int bytes)
+{
+  for (int i = 0; i < bytes; ++i)
+  {
+    fputc((int) ((value >> (8 * i)) & 0xFF), file);
+  }
+}
+
+/**
+ * This function will read a little endian number from the file
+ *
+ * @param file the file
+ * @param bytes how many bytes to read
+ * @param value the number read
+ *
+ * @return bool false at the end of the file
+ */
+static bool readNumber (FILE *file, int bytes, Uint32 *value)
+{
+  *value = 0;
+  for (int i = 0; i < bytes; ++i)
+  {
+    int c = fgetc(file);
+    if (c == EOF)
+    {
+      return false;
+    }
+    *value |= (Uint32) c << (8 * i);
+  }
+  return true;
+}
+
+/**
+ * This function will compress a frame XORed against the one before it
+ *
+ * The same runs as the rewind history: a control byte below 128 is followed by that many + 1 literal bytes,
+ * a control byte of 128 or more skips that many - 127 unchanged bytes.
+ *
+ * @param out the compressed bytes, at least CAPTURE_MAX_ENCODED long
+ * @param frame the frame
+ * @param previous the frame before, or NULL for a keyframe
+ *
+ * @return int the compressed size
+ */
+static int encodeFrame (Uint8 *out, const Uint8 *frame, const Uint8 *previous)
+{
+  int size = 0;
+  int i = 0;
+  int length = CAPTURE_FRAME_BYTES;
+
+  // the XOR is worked out as the runs are found, so the frame is only read once
+#define DELTA(n) (previous != NULL ? (Uint8) (frame[n] ^ previous[n]) : frame[n])
+  while (i < length)
+  {
+    int run = 0;
+    while (i + run < length && run < 128 && DELTA(i + run) == 0)
+    {
+      ++run;
+    }
+    if (run >= 2 || (run == 1 && i + 1 == length))
+    {
+      out[size++] = (Uint8) (127 + run);
+      i += run;
+      continue;
+    }
+
+    int start = i;
+    int control = size++;
+    while (i < length && i - start < 128 && !(DELTA(i) == 0 && i + 1 < length && DELTA(i + 1) == 0))
+    {
+      out[size++] = DELTA(i);
+      ++i;
+    }
+    out[control] = (Uint8) (i - start - 1);
+  }
+#undef DELTA
+
+  return size;
+}
+
+/**
+ * This function will XOR a compressed frame onto the frame before it
+ *
+ * @param frame the frame before, zeroed for a keyframe
+ * @param in the compressed bytes
+ * @param size the compressed size
+ *
+ * @return void
+ */
+static void decodeFrame (Uint8 *frame, const Uint8 *in, int size)
+{
+  int position = 0;
+  for (int i = 0; i < size && position < CAPTURE_FRAME_BYTES;)
+  {
+    int control = in[i++];
+    if (control >= 128)
+    {
+      position += control - 127;
+      continue;
+    }
+
+    for (int n = 0; n <= control && i < size && position < CAPTURE_FRAME_BYTES; ++n)
+    {
+      frame[position++] ^= in[i++];
+    }
+  }
+}
+
+/**
+ * This thread function will compress and write queued frames until recording stops and the queue is empty
+ *
+ * @param arg the capture
+ *
+ * @return void
+ */
+static void* captureEncoder (void *arg)
+{
+  Capture *capture = arg;
+
+  pthread_mutex_lock(&(*capture).lock);
+  while (true)
+  {
+    while (!(*capture).stopping && (*capture).queueCount == 0)
+    {
+      pthread_cond_wait(&(*capture).ready, &(*capture).lock);
+    }
+    if ((*capture).queueCount == 0)
+    {
+      break;
+    }
+
+    int buffer = (*capture).queue[(*capture).queueHead];
+    Uint32 time = (*capture).queueTime[(*capture).queueHead];
+    (*capture).queueHead = ((*capture).queueHead + 1) % CAPTURE_BUFFERS;
+    --(*capture).queueCount;
+    pthread_mutex_unlock(&(*capture).lock);
+
+    // the buffer belongs to this thread until it is put back on the free list
+    const Uint8 *frame = (*capture).storage + (size_t) buffer * CAPTURE_FRAME_BYTES;
+    bool keyframe = (*capture).framesWritten % CAPTURE_KEYFRAME_INTERVAL == 0;
+    int size = encodeFrame((*capture).encoded, frame, keyframe ? NULL : (*capture).previous);
+    memcpy((*capture).previous, frame, CAPTURE_FRAME_BYTES);
+
+    writeNumber((*capture).file, time, 4);
+    writeNumber((*capture).file, keyframe ? 1 : 0, 1);
+    writeNumber((*capture).file, (Uint32) size, 4);
+    fwrite((*capture).encoded, 1, (size_t) size, (*capture).file);
+
+    pthread_mutex_lock(&(*capture).lock);
+    (*capture).freeList[(*capture).freeCount++] = buffer;
+    ++(*capture).framesWritten;
+    (*capture).bytesWritten += 9 + (Uint64) size;
+  }
+  pthread_mutex_unlock(&(*capture).lock);
+
+  return NULL;
+}
+
+/**
+ * This function will open the recording and start the encoder, all of the memory it needs is taken here
+ *
+ * @param capture the capture, zeroed or stopped
+ * @param renderer the renderer the game draws with
+ * @param path the file to record to
+ *
+ * @return bool whether recording started
+ */
+bool captureStart (Capture *capture, SDL_Renderer *renderer, const char *path)
+{
+  bool wanted = (*capture).wanted;
+  memset(capture, 0, sizeof(*capture));
+  (*capture).wanted = wanted;
+  snprintf((*capture).path, sizeof((*capture).path), "%s", path);
+
+  // drawing into a 160x144 target gives the logical frame, reading the window would give it scaled up
+  if (!SDL_RenderTargetSupported(renderer))
+  {
+    fprintf(stderr, "Capture needs a renderer that can draw to textures\n");
+    return false;
+  }
+  (*capture).target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                        X_RESOLUTION, Y_RESOLUTION);
+  (*capture).storage = memAlloc(MEM_RENDER, (size_t) CAPTURE_BUFFERS * CAPTURE_FRAME_BYTES);
+  (*capture).previous = memCalloc(MEM_RENDER, 1, CAPTURE_FRAME_BYTES);
+  (*capture).encoded = memAlloc(MEM_RENDER, CAPTURE_MAX_ENCODED);
+  (*capture).file = fopen(path, "wb");
+  if ((*capture).target == NULL || (*capture).storage == NULL || (*capture).previous == NULL
+      || (*capture).encoded == NULL || (*capture).file == NULL)
+  {
+    fprintf(stderr, "Could not start recording to %s\n", path);
+    captureStop(capture);
+    return false;
+  }
+
+  fwrite(CAPTURE_MAGIC, 1, 8, (*capture).file);
+  writeNumber((*capture).file, X_RESOLUTION, 2);
+  writeNumber((*capture).file, Y_RESOLUTION, 2);
+  writeNumber((*capture).file, SDL_PIXELFORMAT_ARGB8888, 4);
+
+  for (int i = 0; i < CAPTURE_BUFFERS; ++i)
+  {
+    (*capture).freeList[i] = i;
+  }
+  (*capture).freeCount = CAPTURE_BUFFERS;
+
+  pthread_mutex_init(&(*capture).lock, NULL);
+  pthread_cond_init(&(*capture).ready, NULL);
+  if (pthread_create(&(*capture).encoder, NULL, captureEncoder, capture) != 0)
+  {
+    fprintf(stderr, "Capture encoder thread could not be started\n");
+    pthread_cond_destroy(&(*capture).ready);
+    pthread_mutex_destroy(&(*capture).lock);
+    captureStop(capture);
+    return false;
+  }
+
+  (*capture).active = true;
+  printf("Recording to %s\n", path);
+  return true;
+}
+
+/**
+ * This function will point the frame's drawing at the capture target while recording
+ *
+ * @param capture the capture
+ * @param renderer the renderer
+ *
+ * @return void
+ */
+void captureBeginFrame (Capture *capture, SDL_Renderer *renderer)
+{
+  if ((*capture).active)
+  {
+    renderSetTarget(renderer, (*capture).target);
+  }
+}
+
+/**
+ * This function will read the finished frame into a free buffer for the encoder, then put it on the window
+ *
+ * Nothing here waits on the encoder, when every buffer is still queued the frame is dropped and counted.
+ *
+ * @param capture the capture
+ * @param renderer the renderer
+ * @param time the frame's time in milliseconds
+ *
+ * @return void
+ */
+void captureEndFrame (Capture *capture, SDL_Renderer *renderer, Uint32 time)
+{
+  if (!(*capture).active)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&(*capture).lock);
+  int buffer = (*capture).freeCount > 0 ? (*capture).freeList[--(*capture).freeCount] : -1;
+  pthread_mutex_unlock(&(*capture).lock);
+
+  if (buffer >= 0)
+  {
+    Uint64 start = SDL_GetPerformanceCounter();
+    SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888,
+                         (*capture).storage + (size_t) buffer * CAPTURE_FRAME_BYTES, X_RESOLUTION * 4);
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    (*capture).readbackMs += ms;
+    (*capture).readbackMsMax = max((*capture).readbackMsMax, ms);
+
+    pthread_mutex_lock(&(*capture).lock);
+    int slot = ((*capture).queueHead + (*capture).queueCount) % CAPTURE_BUFFERS;
+    (*capture).queue[slot] = buffer;
+    (*capture).queueTime[slot] = time;
+    ++(*capture).queueCount;
+    ++(*capture).framesCaptured;
+    pthread_cond_signal(&(*capture).ready);
+    pthread_mutex_unlock(&(*capture).lock);
+  }
+  else
+  {
+    ++(*capture).framesDropped;
+  }
+
+  renderSetTarget(renderer, NULL);
+  renderCopy(renderer, (*capture).target, NULL, NULL);
+}
+
+/**
+ * This function will print how much has been recorded
+ *
+ * @param capture the capture
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void capturePrintReport (Capture *capture, FILE *out)
+{
+  if (!(*capture).active || (*capture).framesCaptured == 0)
+  {
+    return;
+  }
+
+  // the encoder is still counting what it has written
+  pthread_mutex_lock(&(*capture).lock);
+
+  fprintf(out, "CAPTURE: %d frames, %d dropped, %.3f ms readback (max %.3f), %.1f KB written (%.1fx smaller than raw)\n",
+          (*capture).framesCaptured, (*capture).framesDropped, (*capture).readbackMs / (*capture).framesCaptured,
+          (*capture).readbackMsMax, (*capture).bytesWritten / 1024.0,
+          (*capture).bytesWritten > 0 ? (double) (*capture).framesWritten * CAPTURE_FRAME_BYTES / (*capture).bytesWritten : 0.0);
+  pthread_mutex_unlock(&(*capture).lock);
+}
+
+/**
+ * This function will let the encoder finish the queued frames, then close the file and free the buffers
+ *
+ * @param capture the capture
+ *
+ * @return void
+ */
+void captureStop (Capture *capture)
+{
+  if ((*capture).active)
+  {
+    pthread_mutex_lock(&(*capture).lock);
+    (*capture).stopping = true;
+    pthread_cond_signal(&(*capture).ready);
+    pthread_mutex_unlock(&(*capture).lock);
+    pthread_join((*capture).encoder, NULL);
+    capturePrintReport(capture, stdout);
+    pthread_cond_destroy(&(*capture).ready);
+    pthread_mutex_destroy(&(*capture).lock);
+
+    printf("Recording saved to %s\n", (*capture).path);
+    (*capture).active = false;
+  }
+
+  if ((*capture).file != NULL)
+  {
+    fclose((*capture).file);
+    (*capture).file = NULL;
+  }
+  if ((*capture).target != NULL)
+  {
+    SDL_DestroyTexture((*capture).target);
+    (*capture).target = NULL;
+  }
+  memFree(MEM_RENDER, (*capture).storage);
+  memFree(MEM_RENDER, (*capture).previous);
+  memFree(MEM_RENDER, (*capture).encoded);
+  (*capture).storage = (*capture).previous = (*capture).encoded = NULL;
+}
+
+/**
+ * This function will turn a recording into raw 24 bit RGB video at a steady frame rate
+ *
+ * Frames are only recorded when the game draws, so each one is repeated until the next one's time comes.
+ * The output can be encoded with, for example:
+ * ffmpeg -f rawvideo -pixel_format rgb24 -video_size 160x144 -framerate 60 -i out.rgb out.mp4
+ *
+ * @param inPath the recording
+ * @param outPath the raw video to write
+ *
+ * @return bool whether the whole recording was converted
+ */
+bool captureConvert (const char *inPath, const char *outPath)
+{
+  FILE *in = fopen(inPath, "rb");
+  FILE *out = fopen(outPath, "wb");
+  Uint8 *frame = memCalloc(MEM_GENERAL, 1, CAPTURE_FRAME_BYTES);
+  Uint8 *encoded = memAlloc(MEM_GENERAL, CAPTURE_MAX_ENCODED);
+  Uint8 *rgb = memAlloc(MEM_GENERAL, X_RESOLUTION * Y_RESOLUTION * 3);
+  bool ok = in != NULL && out != NULL && frame != NULL && encoded != NULL && rgb != NULL;
+
+  char magic[8];
+  Uint32 width = 0, height = 0, format = 0;
+  if (ok && (fread(magic, 1, 8, in) != 8 || memcmp(magic, CAPTURE_MAGIC, 8) != 0 || !readNumber(in, 2, &width)
+             || !readNumber(in, 2, &height) || !readNumber(in, 4, &format)
+             || width != X_RESOLUTION || height != Y_RESOLUTION || format != SDL_PIXELFORMAT_ARGB8888))
+  {
+    fprintf(stderr, "%s is not a recording of this game\n", inPath);
+    ok = false;
+  }
+
+  int framesRead = 0, framesOut = 0;
+  Uint32 firstTime = 0, time, keyframe, size;
+  bool havePending = false;
+  while (ok && readNumber(in, 4, &time))
+  {
+    if (!readNumber(in, 1, &keyframe) || !readNumber(in, 4, &size) || size > CAPTURE_MAX_ENCODED
+        || fread(encoded, 1, size, in) != size)
+    {
+      fprintf(stderr, "%s is cut short after %d frames\n", inPath, framesRead);
+      break;
+    }
+    if (framesRead == 0)
+    {
+      firstTime = time;
+    }
+
+    // the frame before this one is shown until this one's time
+    Uint32 until = (time - firstTime) * CAPTURE_CONVERT_FPS / 1000;
+    while (havePending && (Uint32) framesOut < until)
+    {
+      fwrite(rgb, 1, X_RESOLUTION * Y_RESOLUTION * 3, out);
+      ++framesOut;
+    }
+
+    if (keyframe)
+    {
+      memset(frame, 0, CAPTURE_FRAME_BYTES);
+    }
+    decodeFrame(frame, encoded, (int) size);
+    for (int i = 0; i < X_RESOLUTION * Y_RESOLUTION; ++i)
+    {
+      Uint32 pixel;
+      memcpy(&pixel, frame + i * 4, 4);
+      rgb[i * 3] = (Uint8) (pixel >> 16);
+      rgb[i * 3 + 1] = (Uint8) (pixel >> 8);
+      rgb[i * 3 + 2] = (Uint8) pixel;
+    }
+    havePending = true;
+    ++framesRead;
+  }
+
+  // the last frame is shown once
+  if (havePending)
+  {
+    fwrite(rgb, 1, X_RESOLUTION * Y_RESOLUTION * 3, out);
+    ++framesOut;
+  }
+
+  if (ok)
+  {
+    printf("CONVERT: %d recorded frames to %d frames at %d fps in %s\n", framesRead, framesOut, CAPTURE_CONVERT_FPS, outPath);
+  }
+  else if (in == NULL || out == NULL)
+  {
+    fprintf(stderr, "Could not open %s or %s\n", inPath, outPath);
+  }
+
+  if (in != NULL)
+  {
+    fclose(in);
+  }
+  if (out != NULL)
+  {
+    fclose(out);
+  }
+  memFree(MEM_GENERAL, frame);
+  memFree(MEM_GENERAL, encoded);
+  memFree(MEM_GENERAL, rgb);
+  return ok;
+}
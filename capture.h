@@ -0,0 +1,53 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <SDL.h>
+#include "game.h"
+
+#define CAPTURE_BUFFERS 8 // frames that can wait for the encoder before new ones are dropped
+#define CAPTURE_KEYFRAME_INTERVAL 60 // frames between frames stored without a delta
+#define CAPTURE_CONVERT_FPS 60 // frame rate of the converted video
+#define CAPTURE_FRAME_BYTES (X_RESOLUTION * Y_RESOLUTION * 4)
+#define CAPTURE_MAGIC "GAMECAP1"
+
+// records the logical frame to a file, the game thread reads pixels back and an encoder thread writes them
+typedef struct
+{
+  bool wanted; // set to start or stop recording, the game loop follows it
+  bool active;
+  char path[256];
+  FILE *file;
+  SDL_Texture *target; // the frame is drawn here at 160x144, then copied to the window
+
+  // the frame buffers, handed from the free list to the queue and back
+  Uint8 *storage;
+  int freeList[CAPTURE_BUFFERS];
+  int freeCount;
+  int queue[CAPTURE_BUFFERS];
+  Uint32 queueTime[CAPTURE_BUFFERS];
+  int queueHead, queueCount;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  pthread_t encoder;
+  bool stopping;
+
+  // the encoder's own memory
+  Uint8 *previous;
+  Uint8 *encoded;
+
+  int framesCaptured, framesDropped, framesWritten;
+  Uint64 bytesWritten;
+  double readbackMs, readbackMsMax;
+} Capture;
+
+bool captureStart(Capture *capture, SDL_Renderer *renderer, const char *path);
+void captureBeginFrame(Capture *capture, SDL_Renderer *renderer);
+void captureEndFrame(Capture *capture, SDL_Renderer *renderer, Uint32 time);
+void capturePrintReport(Capture *capture, FILE *out);
+void captureStop(Capture *capture);
+bool captureConvert(const char *inPath, const char *outPath);
+
+#endif
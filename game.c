@@ -1,65 +1,66 @@
 // libraries being used for this project
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <SDL.h>
 #include <SDL_image.h> // make sure to include the SDL_image library for sprites
 #include <SDL2/SDL_mixer.h> // includes the SDL audio mixer
 #include <pthread.h>
-#include <sys/stat.h> // for mkdir
-
-// macros for commonly used values to make easier readability
-#define TILE_WIDTH 16
-#define TILE_HEIGHT 16
-#define X_OFFSET 8
-#define MAP_ROWS 9
-#define MAP_COLS 10
-#define FPS 1200
-#define X_RESOLUTION TILE_WIDTH * 10 // 160 for 16 width
-#define Y_RESOLUTION TILE_HEIGHT * 9 // 144 for 16 height
-#define MOVEMENT_DELAY 150
-#define RES_SCALE 8
-#define MENU_ITEM_COUNT 3
-#define SPRITE_FRAMES 2 // the frames per direction
-#define ANIMATION_DELAY 125 // the millisecond delay between frames
-#define FRAME_DELAY 1000 / FPS // frame delay for 60 fps and making sure CPU does not run 100%
-#define MAX_GAME_TEXTURES 1000 // maximum number of textures that can be loaded for the game
-
-// I didn't want to include math.h because I was purely dealing with integers
-// instead I decided to use these trivial macros for min and maxing
-#define min(a, b) ((a) < (b) ? (a) : (b))
-#define max(a, b) ((a) > (b) ? (a) : (b))
-
-// global variable that will allow our threads to sync properly
-int musicSelector = 0; // initial music selection
+#include "game.h"
+#include "alloc.h"
+#include "input.h"
+#include "tiles.h"
+#include "lighting.h"
+#include "sim.h"
+#include "batch.h"
+#include "net.h"
+#include "state.h"
+#include "script.h"
+#include "text.h"
+#include "renderstats.h"
+#include "worldgen.h"
+#include "capture.h"
+#include "palette.h"
+#include "renderqueue.h"
+#include "timer.h"
+#include "hotreload.h"
+#include "particles.h"
+#include "spritebatch.h"
+
+// the status main returns, set by the game thread when something goes wrong
+int exitStatus = EXIT_SUCCESS;
+
+// the connection to a server when playing online, NULL when the game runs on its own
+NetClient *netClient = NULL;
+
+// frames to draw in a headless render test, 0 when playing normally
+int renderTestFrames = 0;
+
+// the file to record to from the first frame, NULL to only record when F10 is pressed
+const char *recordPath = NULL;
+
+// the track the music thread should play, handed over under musicLock so the music thread can sleep until it changes
+static pthread_mutex_t musicLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t musicChanged = PTHREAD_COND_INITIALIZER;
+static int musicWanted = 0;
+static bool musicReload = false; // a track changed on disk and is waiting for the music thread
+
+// the music tracks, indexed by musicSelector
+static const char *musicTracks[MUSIC_TRACKS] =
+{
+  NULL,
+  "assets/audio/perllert_town_music.wav",
+  "assets/audio/perkemern_center.wav",
+  "assets/audio/village_ruins_music.wav"
+};
+
+// watches the assets while the game runs, each thread takes the changes it applies between frames
+static AssetWatcher assetWatcher;
 
 // Variables for sprite animation
-int currentFrame = 0;
-Uint32 lastAnimationFrame = 0;
 int animationRowHeight = TILE_HEIGHT; // assumes that each animation is in a different row
 
-// this will set up for our start menu
-typedef enum { MENU, GAME } GameState;
-GameState currentGameState = GAME;
-
-// This will set up our menu options
-typedef enum { SAVE, LOAD, EXIT } MenuState;
-MenuState currentMenuState = SAVE;
-
-// Variables for tracking character direction and state
-typedef enum { RIGHT, LEFT, UP, DOWN, IDLE_RIGHT, IDLE_LEFT, IDLE_UP, IDLE_DOWN } Direction;
-
-// Define map types
-typedef enum { PERLLERT_TOWN, PKRMN_CTR, VILLAGE_RUINS } MapType;
-
-// Structs for managing game data
-typedef struct 
-{
-    int x, y;
-    Direction direction;
-    SDL_Texture *sprite;
-} Player;
-
 /**
  * This function will initialize SDL and SDL_image
  * 
@@ -83,14 +84,13 @@ void initSDL ()
 }
 
 /**
- * This function will set up the window and renderer
+ * This function will set up the window
  * 
  * @param window the window that will be set up
- * @param renderer the renderer that will be set up
  * 
  * @return void
  */
-void setupWindow (SDL_Window** window, SDL_Renderer** renderer) 
+void setupWindow (SDL_Window** window) 
 {
   // resolution is scaled 8x higher than what will be rendered (1280x1152 screen for 160x144 game)
   *window = SDL_CreateWindow("Perkemerrrrrrnnnnnnn", 
@@ -107,16 +107,30 @@ void setupWindow (SDL_Window** window, SDL_Renderer** renderer)
     SDL_Quit();
     return;
   }
+}
+
+/**
+ * This function will set up the renderer, on the thread that will draw with it
+ * 
+ * @param window the window the renderer draws to
+ * @param renderer the renderer that will be set up, NULL if it could not be created
+ * 
+ * @return void
+ */
+void setupRenderer (SDL_Window* window, SDL_Renderer** renderer) 
+{
+  *renderer = window != NULL ? SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED) : NULL;
 
-  *renderer = SDL_CreateRenderer(*window, -1, SDL_RENDERER_ACCELERATED);
+  // headless video drivers have no accelerated renderer, fall back to the software one
+  if (!(*renderer) && window != NULL)
+  {
+    *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+  }
 
   // make sure renderer runs successfully
   if (!(*renderer)) 
   {
     fprintf(stderr, "Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
-    SDL_DestroyWindow(*window);
-    IMG_Quit();
-    SDL_Quit();
     return;
   }
 
@@ -129,49 +143,30 @@ void setupWindow (SDL_Window** window, SDL_Renderer** renderer)
  * 
  * @param textures the array of textures to be loaded
  * @param renderer the renderer that will be used to load the textures
+ * @param tileSet the tile set the textures are stored in as palette indices
  * 
  * @return int the number of textures loaded
  */
-int loadTextures (SDL_Texture** textures, SDL_Renderer** renderer) 
+int loadTextures (SDL_Texture** textures, SDL_Renderer** renderer, TileSet* tileSet) 
 {
   // load the textures for the game
   int i = 0;
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/grass_grey.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/wall_grey.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/enter_pkrmrn_ctr.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/grass_grey.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/wall_grey.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/enter_pkrmrn_ctr.png");
     
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/enter_perllert_town.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_tile_top_right.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_tile_top_left.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_tile_bottom_right.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_tile_bottom_left.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/enter_perllert_town.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_tile_top_right.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_tile_top_left.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_tile_bottom_right.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_tile_bottom_left.png");
     
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_wall1.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_wall2.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_wall3.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/ctr_wall4.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/village_exit.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/world/perllert1_exit.png");
-
-  return i;
-}
-
-/**
- * This function will load the textures for the menu
- * 
- * @param textures the array of textures to be loaded
- * @param renderer the renderer that will be used to load the textures
- * 
- * @return int the number of textures loaded
- */
-int loadMenuTextures (SDL_Texture** textures, SDL_Renderer** renderer) 
-{
-  // load the textures for the menu
-  int i = 0;
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/menu/menu_save.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/menu/menu_load.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/menu/menu_load_error.png");
-  textures[i++] = IMG_LoadTexture(*renderer, "assets/textures/menu/menu_exit.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_wall1.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_wall2.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_wall3.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/ctr_wall4.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/village_exit.png");
+  textures[i++] = tileSetLoadImage(tileSet, *renderer, "assets/textures/world/perllert1_exit.png");
 
   return i;
 }
@@ -192,265 +187,29 @@ void destroyTextures (SDL_Texture** textures, int textureCount)
   }
 }
 
-/**
- * This function will load the map into the game
- * 
- * @param map the map that will be loaded
- * @param mapType the type of map that will be loaded
- */
-void loadMap(int map[MAP_ROWS][MAP_COLS], MapType mapType) 
-{
-  switch (mapType) 
-  {
-    case PERLLERT_TOWN: 
-    {
-      // Map layout for Perllert Town
-      int perllert_town_map[MAP_ROWS][MAP_COLS] = 
-      {
-        {1, 1, 1, 1, 1, 1, 1, 1, 12, 1}, // 1 represents a wall, 12 represents an exit point
-        {1, 0, 0, 0, 0, 0, 0, 0, 0,  1}, // 0 represents a walkable tile
-        {1, 0, 0, 0, 0, 1, 1, 0, 0,  1}, 
-        {1, 0, 0, 0, 0, 0, 1, 0, 0,  1}, 
-        {1, 0, 0, 0, 0, 0, 1, 0, 0,  1}, 
-        {1, 0, 1, 0, 0, 0, 1, 0, 0,  1}, 
-        {1, 0, 0, 0, 0, 0, 0, 0, 0,  2}, // 2 represents an exit point
-        {1, 0, 0, 0, 0, 0, 0, 0, 0,  2}, 
-        {1, 0, 0, 1, 1, 1, 1, 1, 1,  1}, 
-      };
-      memmove(map, perllert_town_map, sizeof(perllert_town_map));
-      break;
-    }
-    case PKRMN_CTR:
-    {
-      // Map layout for Perkemern Center
-      int pkrmrn_ctr_map[MAP_ROWS][MAP_COLS] = 
-      {
-        {9, 11, 11, 11, 9, 9, 11, 11, 11, 9}, 
-        {9, 5,  4,  5,  9, 9, 4,  5,  4,  9}, 
-        {8, 10, 10, 10, 8, 8, 10, 10, 10, 8}, 
-        {4, 5,  4,  5,  4, 5, 4,  5,  4,  5}, 
-        {6, 7,  6,  7,  6, 7, 6,  7,  6,  7}, 
-        {4, 5,  4,  5,  4, 5, 4,  5,  4,  5}, 
-        {3, 7,  6,  7,  6, 7, 6,  7,  6,  7}, // 3 represents exit point
-        {3, 5,  4,  5,  4, 5, 4,  5,  4,  5}, 
-        {6, 7,  6,  7,  6, 7, 6,  7,  6,  7}, 
-      };
-      memmove(map, pkrmrn_ctr_map, sizeof(pkrmrn_ctr_map));
-      break;
-    }
-    case VILLAGE_RUINS:
-    {
-      // Map layout for Village Ruins
-      int village_ruins_map[MAP_ROWS][MAP_COLS] = 
-      {
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}, 
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, // 13 represents exit point
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
-        {1, 1, 1, 1, 1, 1, 1, 1, 13, 1}, 
-      };
-      memmove(map, village_ruins_map, sizeof(village_ruins_map));
-      break;
-    }
-  }
-}
-
-/**
- * This function will save the game state to a file
- * 
- * @param x the x position of the player
- * @param y the y position of the player
- * @param currentMap the current map that the player is on
- * @param musicSelector the current music that is playing
- * 
- * @return void
- */
-void saveGame (int x, int y, char* currentMap) 
-{
-  // Try to create a directory for the save file (if it doesn't exist)
-  // this works because mkdir doesn't do anything if the directory already exists
-  mkdir("save_data", 0777); // 0777 permissions mean everyone can read/write/execute
-
-  // open file from the directory
-  // this will create the file if it doesn't exist
-  FILE *saveFile = fopen("save_data/save.txt", "w");
-  if (saveFile == NULL) 
-  {
-      fprintf(stderr, "Error opening or creating save file!\n");
-      return;
-  }
-
-  // save the current map
-  fprintf(saveFile, "map: %s\n", currentMap);
-
-  // save the music state
-  fprintf(saveFile, "music: %d\n", musicSelector);
-
-  // convert the player's position to grid coordinates and save
-  int gridX = (x - X_OFFSET) / TILE_WIDTH;
-  int gridY = y / TILE_HEIGHT;
-  fprintf(saveFile, "xpos: %d\n", gridX);
-  fprintf(saveFile, "ypos: %d\n", gridY);
-
-  fclose(saveFile);
-}
-
-/**
- * This function will load the game state from a file
- * 
- * @param loadError the load error variable to determine whether we are in the load error state or not
- * @param player the player struct, intended for the main character
- * @param map the map that will be loaded in association with the current map name
- * @param chooseMap the variable to determine which map to next load
- * 
- * @return void
- */
-void loadGame(bool *loadError, Player *player, int map[MAP_ROWS][MAP_COLS], int *chooseMap)   
-{
-  // load the game
-  FILE* saveFile = fopen("save_data/save.txt", "r");
-  char line[100]; // Array to hold each line of the file
-
-  // Check if the file exists
-  if (saveFile == NULL) 
-  {
-    *loadError = true;
-    return;
-  }
-
-  // Read the file line by line
-  while (fgets(line, sizeof(line), saveFile) != NULL) 
-  {
-    // set up our checks in the save file
-    char mapPrefix[] = "map: ";
-    char musicPrefix[] = "music: ";
-    char xposPrefix[] = "xpos: ";
-    char yposPrefix[] = "ypos: ";
-
-    // check to see if the line is a map line
-    if(strncmp(mapPrefix, line, strlen(mapPrefix)) == 0)
-    {
-      // ensure that the line has a value
-      if(strlen(line) <= strlen(mapPrefix))
-      {
-        *loadError = true;
-        printf("map prefix has no value\n");
-        break;
-      }
-
-      // we will select the map based on the string after the prefix
-      char* mapChoice = line + strlen(mapPrefix);
-      
-      // now we have the map choice, we can change the map variable
-      // 18 is the number of characters in "perllert_town_map", not magic number
-      if(strncmp("perllert_town_map", mapChoice, strlen("perllert_town_map")) == 0)
-      {
-        loadMap(map, PERLLERT_TOWN);
-        *chooseMap = 1;
-      }
-      else if(strncmp("pkrmrn_ctr_map", mapChoice, strlen("pkrmrn_ctr_map")) == 0)
-      {
-        loadMap(map, PKRMN_CTR);
-        *chooseMap = 2;
-      }
-      else if(strncmp("village_ruins_map", mapChoice, strlen("village_ruins_map")) == 0)
-      {
-        loadMap(map, VILLAGE_RUINS);
-        *chooseMap = 3;
-      }
-    }
-    // check to see if the line is a music line
-    else if(strncmp(musicPrefix, line, strlen(musicPrefix)) == 0)
-    {
-      // ensure that the line has a value
-      if(strlen(line) <= strlen(musicPrefix))
-      {
-        *loadError = true;
-        printf("music prefix has no value\n");
-        break;
-      }
-
-      char musicChoice[100];
-      for (int i = (int) strlen(musicPrefix); i < (int) strlen(line) - 1; ++i)
-      {                    
-        // we will select the music based on the value after the prefix
-        musicChoice[i - strlen(musicPrefix)] = line[i];
-      }
-
-      musicSelector = atoi(musicChoice);
-    }
-    // check to see if the line is an xpos line
-    else if(strncmp(xposPrefix, line, strlen(xposPrefix)) == 0)
-    {
-      // ensure that the line has a value
-      if(strlen(line) <= strlen(xposPrefix))
-      {
-        *loadError = true;
-        printf("xpos prefix has no value\n");
-        break;
-      }
-
-      char xChoice[100];
-      for (int i = (int) strlen(xposPrefix); i < (int) strlen(line) - 1; ++i)
-      {
-        // we will select the x pos based on the value after the prefix
-        xChoice[i - strlen(xposPrefix)] = line[i];
-      }
-      // reading in xpos
-      (*player).x = atoi(xChoice) * TILE_WIDTH + X_OFFSET;
-
-    }
-    // check to see if the line is a ypos line
-    else if(strncmp(yposPrefix, line, strlen(yposPrefix)) == 0)
-    {
-      // ensure that the line has a value
-      if(strlen(line) <= strlen(yposPrefix))
-      {
-        *loadError = true;
-        printf("ypos prefix has no value\n");
-        break;
-      }
-
-      char yChoice[100];
-      for (int i = (int) strlen(yposPrefix); i < (int) strlen(line) - 1; ++i)
-      {
-        // we will select the x pos based on the value after the prefix
-        yChoice[i - strlen(yposPrefix)] = line[i];
-      }
-      // reading in ypos
-      (*player).y = atoi(yChoice) * TILE_HEIGHT;
-    }
-  }
-  // close the file for safety
-  fclose(saveFile);
-  
-}
-
 /**
  * This function will handle the events for the game, including user input and save handling
  * 
  * @param isRunning the control variable for the main loop
- * @param currentGameState the current game state
- * @param currentMenuState the current menu state
- * @param player the player struct, intended for the main character
- * @param loadError the load error variable to determine whether we are in the load error state or not
+ * @param instance the game the events are applied to
+ * @param history the rewind history and quick save slot
+ * @param toggles what the player has toggled for the render thread
  * @param event the event that will be handled
- * @param currentMapName the current map name
- * @param map the map that will be loaded in association with the current map name
- * @param chooseMap the variable to determine which map to next load
  * 
- * @return void
+ * @return int the number of events handled
  */
-void HandleEvents(int* isRunning, GameState* currentGameState, MenuState* currentMenuState, Player* player, 
-                  bool* loadError, SDL_Event* event, char* currentMapName, int map[MAP_ROWS][MAP_COLS], int* chooseMap) 
+int HandleEvents(int* isRunning, GameInstance* instance, StateHistory* history, RenderToggles* toggles, SDL_Event* event) 
 {
+  GameState *currentGameState = &(*instance).currentGameState;
+  MenuState *currentMenuState = &(*instance).currentMenuState;
+  Player *player = &(*instance).player;
+  bool *loadError = &(*instance).loadError;
+  int handled = 0;
+
   // event handling
     while (SDL_PollEvent(event)) 
     {
+      ++handled;
       switch((*event).type)
       {
         // handle quit event
@@ -472,8 +231,11 @@ void HandleEvents(int* isRunning, GameState* currentGameState, MenuState* curren
                   {
                     // handle save case
                     case SAVE:
-                      // save the game by calling our saveGame function
-                      saveGame((*player).x, (*player).y, currentMapName);
+                      // save the game by calling our saveGame function, a generated world is rebuilt from its seed instead
+                      if ((*instance).world == NULL)
+                      {
+                        saveGame((*player).x, (*player).y, mapNameOf((*instance).chooseMap), (*instance).musicSelector);
+                      }
                       break;
                     // handle exit menu case
                     case EXIT:
@@ -490,8 +252,11 @@ void HandleEvents(int* isRunning, GameState* currentGameState, MenuState* curren
                         break;
                       }
 
-                      // load the game by calling our loadGame function
-                      loadGame(loadError, player, map, chooseMap);
+                      // load the game by calling our loadGame function, a save of the hand-made maps has no place in a world
+                      if ((*instance).world == NULL)
+                      {
+                        loadGame(loadError, player, (*instance).map, &(*instance).chooseMap, &(*instance).musicSelector);
+                      }
                       
                       break;
                     default:
@@ -522,10 +287,43 @@ void HandleEvents(int* isRunning, GameState* currentGameState, MenuState* curren
                 ++(*currentMenuState);
               }
               break;
+            // handle quick save, the whole state is kept in memory
+            case SDLK_F5:
+              stateHistorySave(history, instance);
+              break;
+            // handle quick load
+            case SDLK_F9:
+              stateHistoryLoad(history, instance);
+              break;
+            // handle rewind, the game runs backwards for as long as the key is held
+            case SDLK_r:
+              (*history).rewinding = true;
+              break;
+            // handle the render statistics overlay
+            case SDLK_F3:
+              (*toggles).overlay = !(*toggles).overlay;
+              break;
+            // handle recording, the render thread starts or stops it between frames
+            case SDLK_F10:
+              (*toggles).capture = !(*toggles).capture;
+              break;
+            // handle night mode, the render thread swaps the palette
+            case SDLK_n:
+              (*toggles).night = !(*toggles).night;
+              break;
+          }
+          break;
+        // handle key release from user
+        case SDL_KEYUP:
+          if ((*event).key.keysym.sym == SDLK_r)
+          {
+            (*history).rewinding = false;
           }
           break;
       }
     }
+
+  return handled;
 }
 
 /**
@@ -581,419 +379,574 @@ void calculateSrcRect(SDL_Rect *srcRect, Direction direction, int currentFrame)
 }
 
 /**
- * This function will render the scene based on the current state
+ * This function will set up the darkness, torches and fog of war for the map that was just loaded
  * 
- * @param renderer the renderer that will be used to render the scene
- * @param currentGameState the current game state
- * @param currentMenuState the current menu state
- * @param player the player struct, intended for the main character
- * @param loadError the load error variable to determine whether we are in the load error state or not
- * @param currentMapName the current map name
- * @param map the map that will be loaded in association with the current map name
- * @param menuTextures the textures for the menu
- * @param gameTextures the textures for the game
- * @param lastMoveTime the time of the last movement
- * @param chooseMap the variable to determine which map to next load
+ * @param lighting the lighting layer
+ * @param map the map that was loaded
+ * @param chooseMap the map that was loaded (1 perllert town, 2 perkemern center, 3 village ruins)
+ * @param mapId the id of the map that was loaded, which tells world chunks that look alike apart
  * 
  * @return void
  */
-void render(SDL_Renderer** renderer, GameState* currentGameState, MenuState* currentMenuState, Player* player, 
-            bool* loadError, char** currentMapName, int map[MAP_ROWS][MAP_COLS], SDL_Texture** menuTextures, 
-            SDL_Texture** gameTextures, Uint32* lastMoveTime, int* chooseMap)
+void setupLighting(LightingLayer* lighting, int map[MAP_ROWS][MAP_COLS], int chooseMap, int mapId)
 {
-  // Render the scene based on the current state
-    switch(*currentGameState) 
+  switch (chooseMap)
+  {
+    case 3:
+      // the village ruins are dark, only what the player has seen by torchlight is remembered
+      lightingSetMap(lighting, map, mapId, 24, true);
+      lightingAddLight(lighting, 0, 0, PLAYER_TORCH_RADIUS, 255); // the player's torch, moved every frame
+      lightingAddLight(lighting, 1, 1, 3, 200);
+      lightingAddLight(lighting, 8, 1, 3, 200);
+      lightingAddLight(lighting, 1, 7, 3, 200);
+      break;
+    default:
+      // every other map is fully lit
+      lightingSetMap(lighting, map, mapId, 255, false);
+      break;
+  }
+}
+
+/**
+ * This function will draw the menu, a box of options with an arrow on the selected one
+ * 
+ * @param renderer the renderer
+ * @param text the text renderer
+ * @param selected the option the arrow is on
+ * @param loadError whether a failed load is being explained
+ * 
+ * @return void
+ */
+void renderMenu(SDL_Renderer* renderer, TextRenderer* text, MenuState selected, bool loadError)
+{
+  static const char *options[MENU_ITEM_COUNT] = {"SAVE", "LOAD", "EXIT"};
+  SDL_Color ink = {24, 24, 24, 255};
+  int lineHeight = (*text).cellHeight * 2;
+  int cursorWidth = (*text).cellWidth * 2; // the arrow and the gap after it
+  int widest = 0;
+  for (int i = 0; i < MENU_ITEM_COUNT; ++i)
+  {
+    widest = max(widest, textWidth(text, options[i]));
+  }
+
+  // the options box sits in the top right corner, 4 pixels of padding around the arrow and the widest option
+  int boxWidth = 4 + cursorWidth + widest + 4;
+  int boxHeight = 4 + (MENU_ITEM_COUNT - 1) * lineHeight + (*text).cellHeight + 4;
+  SDL_Rect border = {X_RESOLUTION - 4 - boxWidth, 4, boxWidth, boxHeight};
+  SDL_Rect inside = {border.x + 1, border.y + 1, border.w - 2, border.h - 2};
+  SDL_SetRenderDrawColor(renderer, 24, 24, 24, 255);
+  renderFillRect(renderer, &border);
+  SDL_SetRenderDrawColor(renderer, 248, 248, 248, 255);
+  renderFillRect(renderer, &inside);
+
+  for (int i = 0; i < MENU_ITEM_COUNT; ++i)
+  {
+    int y = border.y + 4 + i * lineHeight;
+    if ((int) selected == i)
     {
-      // render the menu case
-      case MENU:
-        // simply show the appropriate menu
-        switch(*currentMenuState)
+      textDrawStatic(text, ">", border.x + 4, y, 0, ink);
+    }
+    textDrawStatic(text, options[i], border.x + 4 + cursorWidth, y, 0, ink);
+  }
+
+  // a failed load is explained in a dialogue box along the bottom
+  if (loadError)
+  {
+    SDL_Rect dialogueBorder = {4, Y_RESOLUTION - 36, X_RESOLUTION - 8, 32};
+    SDL_Rect dialogueInside = {5, Y_RESOLUTION - 35, X_RESOLUTION - 10, 30};
+    SDL_SetRenderDrawColor(renderer, 24, 24, 24, 255);
+    renderFillRect(renderer, &dialogueBorder);
+    SDL_SetRenderDrawColor(renderer, 248, 248, 248, 255);
+    renderFillRect(renderer, &dialogueInside);
+    textDrawStatic(text, "No save file was found. Press enter to go back.", 9, Y_RESOLUTION - 31, X_RESOLUTION - 18, ink);
+  }
+
+  // every string above goes out in one draw, then the clear color is put back
+  textFlush(text, renderer);
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
+
+/**
+ * This function will ask the music thread for a track, waking it only when the track changes
+ *
+ * @param musicSelector the track to play (1 perllert town, 2 perkemern center, 3 village ruins, -1 to stop)
+ *
+ * @return void
+ */
+void musicRequest(int musicSelector)
+{
+  pthread_mutex_lock(&musicLock);
+  if (musicWanted != musicSelector)
+  {
+    musicWanted = musicSelector;
+    pthread_cond_signal(&musicChanged);
+  }
+  pthread_mutex_unlock(&musicLock);
+}
+
+/**
+ * This timer callback will raise a flag for the game loop to act on
+ *
+ * @param userdata the flag to raise
+ * @param deadline the time the timer was due
+ *
+ * @return void
+ */
+static void raiseFlag(void* userdata, Uint64 deadline)
+{
+  (void) deadline;
+  *(bool *) userdata = true;
+}
+
+/**
+ * This function will wake the thread that applies a changed asset, called from the asset watcher thread
+ *
+ * @param kind what changed
+ * @param userdata unused
+ *
+ * @return void
+ */
+static void assetsChanged(AssetKind kind, void* userdata)
+{
+  (void) userdata;
+  if (kind == ASSET_AUDIO)
+  {
+    pthread_mutex_lock(&musicLock);
+    musicReload = true;
+    pthread_cond_signal(&musicChanged);
+    pthread_mutex_unlock(&musicLock);
+    return;
+  }
+
+  // an idle game sleeps until an event arrives, the event makes it publish a frame the change is applied on
+  SDL_Event event = {0};
+  event.type = SDL_USEREVENT;
+  SDL_PushEvent(&event);
+}
+
+/**
+ * This function will swap in the images, font and budgets that changed on disk, between two frames
+ *
+ * the watcher thread has already decoded them, so only the uploads happen here, a few per frame at most
+ *
+ * @param renderer the renderer the textures belong to
+ * @param tileSet the tile set every image was loaded through
+ * @param gameTextures the textures for the game
+ * @param textureCount how many of them there are
+ * @param sprites the textures sprite commands draw from
+ * @param text the text renderer
+ * @param mapLayer the baked map layer, baked again when a tile changes
+ *
+ * @return void
+ */
+void reloadRenderAssets(SDL_Renderer* renderer, TileSet* tileSet, SDL_Texture** gameTextures, int textureCount,
+                        SDL_Texture** sprites, TextRenderer* text, MapLayer* mapLayer)
+{
+  AssetChange change;
+  for (int applied = 0; applied < ASSET_MAX_APPLY
+       && assetWatcherTake(&assetWatcher, ASSET_IMAGE | ASSET_FONT | ASSET_BUDGETS, &change); ++applied)
+  {
+    memBeginLoad();
+    bool reloaded = true;
+    switch (change.kind)
+    {
+      case ASSET_IMAGE:
+      {
+        SDL_Texture *replaced;
+        SDL_Texture *texture = tileSetReloadImage(tileSet, renderer, change.path, change.surface, &replaced);
+        reloaded = texture != NULL;
+
+        // a texture that had to be made again is swapped everywhere the old one was drawn from
+        bool tile = false;
+        for (int i = 0; i < textureCount && reloaded; ++i)
         {
-          case SAVE:
-            SDL_RenderCopy(*renderer, menuTextures[0], NULL, NULL);
-            break;
-          case LOAD:
-            if(*loadError) SDL_RenderCopy(*renderer, menuTextures[2], NULL, NULL);
-            else SDL_RenderCopy(*renderer, menuTextures[1], NULL, NULL);
-            break;
-          case EXIT:
-            SDL_RenderCopy(*renderer, menuTextures[3], NULL, NULL);
-            break;
-          default:
-            break;
+          if (gameTextures[i] == texture || (replaced != NULL && gameTextures[i] == replaced))
+          {
+            gameTextures[i] = texture;
+            tile = true;
+          }
         }
-        break;
-      // render the game case
-      case GAME:
-        // setup the map using the textures 
-        // this loop will render the map based on the map array
-        for (int row = 0; row < MAP_ROWS; ++row) 
+        for (int i = 0; i < SPRITE_TEXTURE_COUNT && replaced != NULL; ++i)
         {
-          for (int col = 0; col < MAP_COLS; ++col) 
+          if (sprites[i] == replaced)
           {
-            SDL_Rect srcRect = {0, 0, TILE_WIDTH, TILE_HEIGHT}; // Source rectangle for the texture
-            SDL_Rect destRect = {col * TILE_WIDTH, row * TILE_HEIGHT, TILE_WIDTH, TILE_HEIGHT}; // Destination rectangle on screen
-
-            // Render the texture based on the map value
-            SDL_RenderCopy(*renderer, gameTextures[map[row][col]], &srcRect, &destRect);    
+            sprites[i] = texture;
           }
         }
+        if (replaced != NULL)
+        {
+          SDL_DestroyTexture(replaced);
+        }
 
-        // handle user input and acceptable time window for input 
-        Uint32 currentTime = SDL_GetTicks();
-
-        // Check if enough time has passed since the last move
-        if (currentTime - (*lastMoveTime) >= MOVEMENT_DELAY) 
+        // only the baked map keeps copies of tile pixels, sprites are drawn straight from their textures
+        if (tile)
         {
-          // Handle keyboard input
-          const Uint8 *state = SDL_GetKeyboardState(NULL);
-          int moved = 0;
+          mapLayerInvalidate(mapLayer);
+        }
+        break;
+      }
+      case ASSET_FONT:
+        reloaded = textReplaceAtlas(text, renderer, change.surface);
+        break;
+      case ASSET_BUDGETS:
+        renderStatsLoadBudgets(change.path);
+        break;
+      default:
+        break;
+    }
+    SDL_FreeSurface(change.surface);
+    memEndLoad();
 
-          // track our new coordinates
-          int newX = (*player).x;
-          int newY = (*player).y;
+    if (reloaded)
+    {
+      printf("Reloaded %s\n", change.path);
+    }
+  }
+}
 
-          // track our grid position
-          int gridX = (*player).x / TILE_WIDTH;
-          int gridY = (*player).y / TILE_HEIGHT;
+/**
+ * This function will record the commands that draw the scene based on the current state
+ *
+ * @param frame the frame to record into, the render thread draws it later
+ * @param instance the game being drawn
+ * @param tileFrames the texture each tile id is drawn with this tick
+ * @param time the game clock the frame shows
+ *
+ * @return void
+ */
+void recordFrame(RenderFrame* frame, GameInstance* instance, const TileFrameTable* tileFrames, Uint32 time)
+{
+  Player *player = &(*instance).player;
+  int *chooseMap = &(*instance).chooseMap;
 
-          // track whether we need to switch maps or not
-          bool switchMap = false;
+  // the render thread only ever reads the frame, so everything it needs from the game is copied in
+  (*frame).time = time;
+  (*frame).scene = (*instance).currentGameState == MENU ? RENDER_SCENE_MENU : *chooseMap;
+  (*frame).chooseMap = *chooseMap;
+  (*frame).mapId = mapIdOf(instance);
+  memcpy((*frame).map, (*instance).map, sizeof((*frame).map));
+  memcpy((*frame).tileFrame, (*tileFrames).frame, sizeof((*frame).tileFrame));
 
-          // animation setup
-          Uint32 currentTime = SDL_GetTicks();
+  // Render the scene based on the current state
+    switch((*instance).currentGameState)
+    {
+      // render the menu case
+      case MENU:
+      {
+        // the options are drawn as text, so adding one costs no texture memory
+        RenderCommand *menu = renderPush(frame, RENDER_LAYER_UI, RENDER_CMD_MENU, 0);
+        if (menu != NULL)
+        {
+          (*menu).srcX = (Sint16) (*instance).currentMenuState;
+          (*menu).srcY = (Sint16) (*instance).loadError;
+        }
+        break;
+      }
+      // render the game case
+      case GAME:
+      {
+        // setup the map using the textures
+        renderPush(frame, RENDER_LAYER_MAP, RENDER_CMD_MAP, 0);
 
-          // determine which direction we are moving
-          if (state[SDL_SCANCODE_W]) 
-          {
-            // update animation variables
-            (*player).direction = UP;
+        SDL_Rect srcRect;
+        calculateSrcRect(&srcRect, (*player).direction, (*instance).currentFrame);
 
-            // case we are moving up
-            newY -= TILE_HEIGHT; 
-            moved = 1;
+        // Render the sprite, standing on the bottom middle of its tile, which is where the player's x already is
+        renderPushSprite(frame, SPRITE_LAYER_OBJECTS, SPRITE_PLAYER, &srcRect, (*player).x, (*player).y + TILE_HEIGHT);
 
-            // determine if we are at an exit point
-            switch (map[gridY][gridX])
-            {
-              case 12:
-                // setup changing map
-                switchMap = true;
-                *chooseMap = 3;
-
-                // setup starting coordinates
-                newX = (*player).x - X_OFFSET;
-                newY = MAP_ROWS * TILE_HEIGHT;
-                moved = 0;
-
-                // setup music
-                musicSelector = 3;
-                break;
-              default:
-                break;
-            }
-          }
-          else if (state[SDL_SCANCODE_A]) 
+        // online, everyone else the server told us about on this map is drawn standing where they are
+        if (netClient != NULL && (*netClient).latest != NULL)
+        {
+          for (int id = 0; id < NET_MAX_CLIENTS; ++id)
           {
-            // update animation variables
-            (*player).direction = LEFT;
-
-            // case we are moving left
-            newX -= TILE_WIDTH;
-            moved = 1;
-
-            // determine if we are at an exit point
-            switch (map[gridY][gridX])
+            if (id == (*netClient).id || !(*(*netClient).latest).visible[id])
             {
-              case 3:
-                // setup changing map
-                switchMap = true;
-                *chooseMap = 1;
-
-                // setup starting coordinates
-                newX = MAP_COLS * TILE_WIDTH;
-                newY = (*player).y;
-                moved = 0;
-
-                // setup music
-                musicSelector = 1;
-                break;
-              default:
-                break;
+              continue;
             }
-          }
-          else if (state[SDL_SCANCODE_S]) 
-          {
-            // update animation variables
-            (*player).direction = DOWN;
 
-            // case we are moving down
-            newY += TILE_HEIGHT;
-            moved = 1;
-
-            // determine if we are at an exit point
-            switch (map[gridY][gridX])
+            int x, y, direction, otherMap;
+            netDequantize(&(*(*netClient).latest).states[id], &x, &y, &direction, &otherMap);
+            if (otherMap != *chooseMap)
             {
-              case 13:
-                // setup changing map
-                switchMap = true;
-                *chooseMap = 1;
-
-                // setup starting coordinates
-                newX = (*player).x - X_OFFSET;
-                newY = -TILE_HEIGHT;
-                moved = 0;
-
-                // setup music
-                musicSelector = 1;
-                break;
-              default:
-                break;
+              continue;
             }
-          }
-          else if (state[SDL_SCANCODE_D]) 
-          {
-            // update animation variables
-            (*player).direction = RIGHT;
-
-            // case we are moving right
-            newX += TILE_WIDTH; 
-            moved = 1;
 
-            // determine if we are at an exit point
-            switch (map[gridY][gridX])
-            {
-              case 2:
-                // setup changing map
-                switchMap = true;
-                *chooseMap = 2;
-
-                // setup starting coordinates
-                newX = -TILE_WIDTH;
-                newY = (*player).y;
-                moved = 0;
-
-                // setup music
-                musicSelector = 2;
-                break;
-            }
+            calculateSrcRect(&srcRect, (Direction) direction, 0);
+            renderPushSprite(frame, SPRITE_LAYER_OBJECTS, SPRITE_PLAYER, &srcRect, x, y + TILE_HEIGHT);
           }
+        }
 
-          // Reset to idle state if no movement keys are pressed
-          if (!(state[SDL_SCANCODE_W] || state[SDL_SCANCODE_A] || state[SDL_SCANCODE_S] || state[SDL_SCANCODE_D]))
-          {
-              currentFrame = 0; // reset animation frame for idle
-              switch((*player).direction)
-              {
-                case UP:
-                  (*player).direction = IDLE_UP;
-                  break;
-                case LEFT:
-                  (*player).direction = IDLE_LEFT;
-                  break;
-                case DOWN:
-                  (*player).direction = IDLE_DOWN;
-                  break;
-                case RIGHT:
-                  (*player).direction = IDLE_RIGHT;
-                  break;
-                default:
-                  break;
-              }
-          }
-
-          // determine which map we are on, and change the currentMapName variable appropriately
-          switch(*chooseMap)
-          {
-            case 1:
-              *currentMapName = "perllert_town_map";
-              break;
-            case 2:
-              *currentMapName = "pkrmrn_ctr_map";
-              break;
-            case 3:
-              *currentMapName = "village_ruins_map";
-              break;
-            default:
-              break;
-          } 
+        // dust, sparkles and weather are drawn over the sprites, the render thread starts them from where the feet are
+        RenderCommand *effects = renderPush(frame, RENDER_LAYER_EFFECTS, RENDER_CMD_PARTICLES, 0);
+        if (effects != NULL)
+        {
+          (*effects).x = (Sint16) (*player).x;
+          (*effects).y = (Sint16) ((*player).y + TILE_HEIGHT - 2);
+        }
 
-          // determine if we need to switch maps
-          if(switchMap)
-          {
-            switch(*chooseMap)
-            {
-              case 1:
-                loadMap(map, PERLLERT_TOWN);
-                break;
-              case 2:
-                loadMap(map, PKRMN_CTR);
-                break;
-              case 3:
-                loadMap(map, VILLAGE_RUINS);
-                break;
-              default:
-                break;
-            }
+        // light the scene around the player's tile
+        RenderCommand *light = renderPush(frame, RENDER_LAYER_LIGHTING, RENDER_CMD_LIGHTING, 0);
+        if (light != NULL)
+        {
+          (*light).x = (Sint16) ((*player).x / TILE_WIDTH);
+          (*light).y = (Sint16) ((*player).y / TILE_HEIGHT);
+        }
+        break;
+      }
+    }
 
-            // apply our changed coordinates to the new map
-            (*player).x = newX + X_OFFSET;
-            (*player).y = newY;  
+}
 
-            // reset the switch map variable
-            switchMap = false;
-          }
-          // otherwise, we are just moving around the map
-          else if (newX >= 0 && 
-              // we do not subtract TILE_WIDTH because we already account for x position
-              newX <= (MAP_COLS * TILE_WIDTH) && //- TILE_WIDTH + TILE_WIDTH &&
-              newY >= 0 && 
-              newY <= ((MAP_ROWS * TILE_HEIGHT) - TILE_HEIGHT))
-          {
-            // determine the grid position of the new coordinates
-            int newGridX = newX / TILE_WIDTH;
-            int newGridY = newY / TILE_HEIGHT;
+/**
+ * This function will start the particles a frame calls for and move them all to the frame's time
+ *
+ * footsteps and warps are found by comparing the frame with the last one drawn, so a frame that was
+ * replaced before it was drawn loses nothing
+ *
+ * @param particles the particle system
+ * @param frame the frame being drawn
+ * @param feetX where the player's feet are on the screen
+ * @param feetY where the player's feet are on the screen
+ *
+ * @return void
+ */
+void stepParticles(ParticleSystem* particles, const RenderFrame* frame, int feetX, int feetY)
+{
+  if ((*particles).mapId != (*frame).mapId)
+  {
+    // a new map drops the old map's particles, and arriving anywhere but the first map sparkles
+    particleClear(particles);
+    if ((*particles).mapId != 0)
+    {
+      particleEmit(particles, PARTICLE_SPARKLE, (float) feetX, (float) (feetY - TILE_HEIGHT / 2), PARTICLE_SPARKLE_COUNT);
+    }
+    (*particles).mapId = (*frame).mapId;
+  }
+  else if (feetX != (*particles).emitterX || feetY != (*particles).emitterY)
+  {
+    particleEmit(particles, PARTICLE_DUST, (float) (*particles).emitterX, (float) (*particles).emitterY, PARTICLE_DUST_COUNT);
+  }
+  (*particles).emitterX = feetX;
+  (*particles).emitterY = feetY;
+
+  // the particles move by game time, so the menu and idle frames do not make them jump
+  particleSetWeather(particles, weatherForMap((*frame).chooseMap, (*frame).toggles.night));
+  float dt = (*particles).time == 0 ? 0.0f : (float) ((*frame).time - (*particles).time) / 1000.0f;
+  particleUpdate(particles, dt);
+  (*particles).time = (*frame).time;
+}
 
-            // determine if the new position is a wall or not
-            switch(map[newGridY][newGridX])
-            {
-              case 0:
-              case 2:
-              case 3:
-              case 4:
-              case 5:
-              case 6:
-              case 7:
-              case 12:
-              case 13:
-                // ensure the character is within map bounds
-                (*player).x = newX;
-                (*player).y = newY;
-                break;
-              default: // default is that the texture is a wall
-                break;
-            }
-          }
+/**
+ * This function will draw a recorded frame, in layer and then texture order, with sprites in front of the ones above them
+ *
+ * @param renderer the renderer that will be used to render the scene
+ * @param frame the frame to draw
+ * @param sprites the textures sprite commands draw from
+ * @param text the text renderer the menu is drawn with
+ * @param gameTextures the textures for the game
+ * @param mapLayer the baked map layer
+ * @param tileFrames the texture each tile id is drawn with, taken from the frame
+ * @param lighting the darkness and fog of war drawn over the scene
+ * @param particles the dust, sparkles and weather
+ * @param spriteBatch the batch the sprites are sorted and drawn with
+ *
+ * @return void
+ */
+void replayFrame(SDL_Renderer* renderer, RenderFrame* frame, SDL_Texture** sprites, TextRenderer* text,
+                 SDL_Texture** gameTextures, MapLayer* mapLayer, TileFrameTable* tileFrames, LightingLayer* lighting,
+                 ParticleSystem* particles, SpriteBatch* spriteBatch)
+{
+  memcpy((*tileFrames).frame, (*frame).tileFrame, sizeof((*tileFrames).frame));
+  renderFrameSort(frame);
 
-          // determine if we have moved or not
-          if (moved != 0)
-          {
-            // Update the last move time if we have moved for the delay
-            *lastMoveTime = currentTime;
-          }
+  for (int i = 0; i < (*frame).count; ++i)
+  {
+    const RenderCommand *command = &(*frame).commands[i];
+    switch ((*command).type)
+    {
+      case RENDER_CMD_MAP:
+        // only cells whose tile or animation frame changed are baked again, then the layer is drawn in one copy
+        mapLayerUpdate(mapLayer, renderer, (*frame).map, tileFrames, gameTextures);
+        mapLayerDraw(mapLayer, renderer, (*frame).map, tileFrames, gameTextures);
+        break;
+      case RENDER_CMD_SPRITE:
+      {
+        // sprites are only collected here, the batch draws them once the last one is reached
+        SDL_Rect srcRect = {(*command).srcX, (*command).srcY, (*command).w, (*command).h};
+        spriteBatchAdd(spriteBatch, (SpriteLayer) (((*command).key >> 16) & 0xFF), (*command).texture, &srcRect,
+                       (*command).x, (*command).y);
+        if (i + 1 == (*frame).count || (*frame).commands[i + 1].type != RENDER_CMD_SPRITE)
+        {
+          spriteBatchDraw(spriteBatch, renderer, sprites);
         }
-
-        // Finalize changes to frame 
-        if ((*player).direction != IDLE_RIGHT && (*player).direction != IDLE_LEFT && 
-            (*player).direction != IDLE_UP && (*player).direction != IDLE_DOWN) 
+        break;
+      }
+      case RENDER_CMD_LIGHTING:
+        // only the tiles around lights that moved or a new map are recomputed
+        if ((*lighting).mapId != (*frame).mapId)
         {
-          // Update the frame if the character is not idle
-          if (currentTime - lastAnimationFrame >= ANIMATION_DELAY) 
-          {
-            currentFrame = (currentFrame + 1) % SPRITE_FRAMES;
-            lastAnimationFrame = currentTime;
-          }
-        } 
-        else 
+          setupLighting(lighting, (*frame).map, (*frame).chooseMap, (*frame).mapId);
+        }
+        if ((*lighting).enabled)
         {
-          // Reset to the first frame when idle
-          currentFrame = 0;
+          lightingMoveLight(lighting, PLAYER_LIGHT, (*command).x, (*command).y);
+          lightingUpdate(lighting);
+          lightingDraw(lighting, renderer);
         }
-        
-        SDL_Rect srcRect;
-        calculateSrcRect(&srcRect, (*player).direction, currentFrame);
-
-        // Render the sprite
-        SDL_Rect destRect = {(*player).x - X_OFFSET, // for whatever reason, the sprite has an off by 8 issue, so I just fix it here
-                             (*player).y, 
-                             TILE_WIDTH, 
-                             TILE_HEIGHT};
-        SDL_RenderCopy(*renderer, (*player).sprite, &srcRect, &destRect);
+        break;
+      case RENDER_CMD_MENU:
+        renderMenu(renderer, text, (MenuState) (*command).srcX, (*command).srcY != 0);
+        break;
+      case RENDER_CMD_PARTICLES:
+        stepParticles(particles, frame, (*command).x, (*command).y);
+        particleDraw(particles, renderer);
         break;
     }
-
+  }
 }
 
 /**
- * This thread function will run the game
- * 
+ * This thread function will draw the frames the game records, it owns the renderer and every texture
+ *
+ * @param arg the render thread's window, pipeline and tile frame table
+ *
  * @return void
  */
-void* game () 
+void* renderThread (void* arg)
 {
-  // Initialize SDL
-  initSDL();
+  RenderThread *thread = arg;
+  RenderPipeline *pipeline = (*thread).pipeline;
 
-  // declare the window and renderer
-  SDL_Window *window;
-  SDL_Renderer *renderer;
-  SDL_Event event;
-  
-  // set up the window and renderer
-  setupWindow(&window, &renderer);
+  // the renderer is made on this thread, so it is only ever used from here
+  SDL_Renderer *renderer = NULL;
+  setupRenderer((*thread).window, &renderer);
+  if (renderer == NULL)
+  {
+    exitStatus = EXIT_FAILURE;
+    atomic_store(&(*pipeline).stopped, true);
+    return NULL;
+  }
 
-  int isRunning = true; // control variable for the main loop
-  Player mainCharacter = {(X_RESOLUTION - TILE_WIDTH) / 2, // default x position
-                          (Y_RESOLUTION - TILE_HEIGHT) / 2, // default y position
-                          IDLE_DOWN, // default direction
-                          IMG_LoadTexture(renderer, "assets/textures/characters/mc.png")}; // default texture
+  // every image is kept as palette indices, so the palette can be swapped without loading anything
+  TileSet tileSet;
+  tileSetInit(&tileSet);
+  SDL_Texture *playerSprite = tileSetLoadImage(&tileSet, renderer, "assets/textures/characters/mc.png"); // default texture
+  SDL_Texture *sprites[SPRITE_TEXTURE_COUNT] = {playerSprite};
 
-  // Initialize the framerate, load the textures, and set up the maps
-  Uint32 frameStart; // Time at the start of the frame
-  Uint32 lastMoveTime = 0; // Time of the last movement
+  // set up the text renderer the menu is drawn with, one glyph atlas for every string
+  TextRenderer text;
+  textInit(&text, renderer, FONT_PATH);
 
-  // Load the menu textures
-  SDL_Texture *menuTextures[MAX_GAME_TEXTURES];
-  int menuTextureCount = loadMenuTextures(menuTextures, &renderer);
-  
   // Load ALL the scene textures
   SDL_Texture *gameTextures[MAX_GAME_TEXTURES];
-  int textureCount = loadTextures(gameTextures, &renderer);
+  int textureCount = loadTextures(gameTextures, &renderer, &tileSet);
 
-  // set up the map variable and its naming convention
-  int map[MAP_ROWS][MAP_COLS];
-  char* currentMapName = "perllert_town_map";
+  // load the animated tiles, their frames are added after the static textures
+  // the game thread advances its own copy of the table, each frame brings the frame every tile is on
+  TileFrameTable tileFrames;
+  tileFrameTableInit(&tileFrames);
+  textureCount = loadTileAnimations(&tileFrames, ANIMATED_TILES_PATH, &renderer, gameTextures, textureCount, &tileSet);
+  (*thread).tileFrames = tileFrames;
+  tileSetPrintReport(&tileSet, stdout);
 
-  // set up the load error variable for save handling
-  bool loadError = false;
+  // set up the layer the map is baked into
+  MapLayer mapLayer;
+  mapLayerInit(&mapLayer, renderer);
 
-  // Copy the map from the array to the map variable, initialize settings
-  loadMap(map, PERLLERT_TOWN);
-  musicSelector = 1; // start with perllert town music
-  int chooseMap = 1; // determine which map to load, start with perllert town map
+  // set up the darkness and fog of war layer, each map configures it when it is first drawn
+  LightingLayer lighting;
+  lightingInit(&lighting, renderer);
+
+  // set up the dust, sparkles and weather, they live only on this thread
+  ParticleSystem particles;
+  particleSystemInit(&particles);
+
+  // set up the batch every sprite is sorted and drawn with
+  // the frame's scratch memory, the sprite batch sorts and builds its vertices in it
+  FrameArena frameArena;
+  frameArenaInit(&frameArena, FRAME_ARENA_SIZE, MEM_RENDER);
+  SpriteBatch spriteBatch;
+  spriteBatchInit(&spriteBatch, &frameArena);
+
+  // count what every frame draws against the budget of the map it shows
+  renderStatsInit(RENDER_BUDGETS_PATH);
+  bool overlay = false;
+
+  // record the logical frame when asked to, the encoding happens on its own thread
+  Capture capture = {0};
+
+  // the latency of the presses the frames show
+  InputLatency inputLatency = {0};
 
-  
   // PURELY FOR TRACKING ACTUAL FPS
   int frameCount = 0;
   float fps = 0;
   Uint32 startTicks = SDL_GetTicks();
-  
 
-  // setup the game loop and main logic 
-  while (isRunning) 
+  // everything is loaded, the game can start recording frames
+  atomic_store(&(*pipeline).loaded, true);
+
+  while (!atomic_load(&(*pipeline).stopping))
   {
-    // initialize the loop, determine which screen to render 
-    frameStart = SDL_GetTicks();
-    
-    // handle events
-    // this will handle the user input and determine which screen (game or menu) to render
-    HandleEvents(&isRunning, &currentGameState, &currentMenuState, &mainCharacter, 
-                 &loadError, &event, currentMapName, map, &chooseMap);
-        
-    // Clear the renderer
-    SDL_RenderClear(renderer);
+    RenderFrame *frame = renderPipelineAcquire(pipeline, IDLE_MAX_WAIT);
+    if (frame != NULL)
+    {
+      // start or stop recording between frames, like loading, so its buffers are not counted against a frame
+      if ((*frame).toggles.capture != capture.wanted)
+      {
+        capture.wanted = (*frame).toggles.capture;
+        if (capture.wanted)
+        {
+          char path[64];
+          snprintf(path, sizeof(path), "capture_%u.cap", (unsigned) SDL_GetTicks());
+          captureStart(&capture, renderer, recordPath != NULL ? recordPath : path);
+          recordPath = NULL;
+        }
+        else
+        {
+          captureStop(&capture);
+        }
+      }
+      if ((*frame).toggles.overlay != overlay)
+      {
+        overlay = (*frame).toggles.overlay;
+        renderStatsToggleOverlay();
+      }
 
-    
-    // render the scene
-    render(&renderer, &currentGameState, &currentMenuState, &mainCharacter, 
-           &loadError, &currentMapName, map, menuTextures, gameTextures, &lastMoveTime, &chooseMap);
+      // swap in assets that changed on disk, between frames like loading
+      reloadRenderAssets(renderer, &tileSet, gameTextures, textureCount, sprites, &text, &mapLayer);
 
-    // present the renderer
-    SDL_RenderPresent(renderer);
+      // swap the palette when the map or night mode asks for another one, the baked map is drawn again with it
+      // the swap uploads every indexed image, so it is counted against the frame that first shows it
+      renderStatsBeginFrame((*frame).scene);
+      PaletteMode palette = paletteForMap((*frame).chooseMap, (*frame).toggles.night);
+      if (palette != tileSet.mode)
+      {
+        tileSetApply(&tileSet, palette);
+        mapLayerInvalidate(&mapLayer);
+      }
+
+      // Clear the renderer, and recycle the scratch memory from two frames ago
+      frameArenaSwap(&frameArena);
+      captureBeginFrame(&capture, renderer);
+      renderClear(renderer);
+
+      // render the scene, a recording takes it before the overlay is drawn over it
+      replayFrame(renderer, frame, sprites, &text, gameTextures, &mapLayer, &tileFrames, &lighting, &particles,
+                  &spriteBatch);
+      captureEndFrame(&capture, renderer, (*frame).time);
+      renderStatsDrawOverlay(renderer, &text);
+
+      // present the renderer
+      renderPresent(renderer);
+      renderStatsEndFrame();
+      inputLatency.pendingPress = (*frame).pendingPress;
+      inputLatency.dropped += (*frame).inputDropped;
+      inputPresented(&inputLatency);
+      frameCount++;
+    }
 
-    
     // PURELY FOR TRACKING ACTUAL FPS
-    frameCount++;
     if (SDL_GetTicks() - startTicks >= 1000) { // Every second
         fps = frameCount / ((SDL_GetTicks() - startTicks) / 1000.0f);
         frameCount = 0;
@@ -1001,39 +954,313 @@ void* game ()
 
         // Display or use the FPS value
         printf("FPS: %.2f\n", fps);
+        inputPrintLatency(&inputLatency, stdout);
+        renderPipelinePrintReport(pipeline, stdout);
+        renderStatsPrintReport(stdout);
+        capturePrintReport(&capture, stdout);
+        particlePrintReport(&particles, stdout);
+        spriteBatchPrintReport(&spriteBatch, stdout);
     }
-    
+  }
+
+  // write out what the draw path cost, a render test fails when any map went over its budget
+  renderStatsPrintReport(stdout);
+  renderStatsExport(RENDER_STATS_PATH);
+  if (renderTestFrames > 0 && !renderStatsWithinBudget())
+  {
+    exitStatus = EXIT_FAILURE;
+  }
+
+  // Cleanup
+  captureStop(&capture);
+  mapLayerDestroy(&mapLayer);
+  lightingDestroy(&lighting);
+  particleSystemDestroy(&particles);
+  spriteBatchDestroy(&spriteBatch);
+  frameArenaDestroy(&frameArena, MEM_RENDER);
+  SDL_DestroyTexture(sprites[SPRITE_PLAYER]);
+  textDestroy(&text);
+  destroyTextures(gameTextures, textureCount);
+  tileSetDestroy(&tileSet);
+  SDL_DestroyRenderer(renderer);
+  atomic_store(&(*pipeline).stopped, true);
+  return NULL;
+}
+
+/**
+ * This thread function will run the game
+ *
+ * the game records each frame as commands while the render thread draws the one before it
+ *
+ * @param arg the game instance to run
+ *
+ * @return void
+ */
+void* game (void* arg)
+{
+  GameInstance *instance = arg;
+
+  // Initialize SDL
+  initSDL();
+
+  // declare the window
+  SDL_Window *window;
+  SDL_Event event;
+
+  // set up the window, the render thread makes the renderer for it
+  setupWindow(&window);
+
+  int isRunning = true; // control variable for the main loop
+
+  // Initialize the framerate
+  Uint32 frameStart; // Time at the start of the frame
+
+  // start the render thread and wait for it to load the textures, so loading is not counted against a frame
+  RenderPipeline pipeline;
+  renderPipelineInit(&pipeline);
+  RenderThread thread = {0};
+  thread.window = window;
+  thread.pipeline = &pipeline;
+  tileFrameTableInit(&thread.tileFrames);
+  pthread_create(&pipeline.thread, NULL, renderThread, &thread);
+  while (!atomic_load(&pipeline.loaded) && !atomic_load(&pipeline.stopped))
+  {
+    SDL_Delay(1);
+  }
+  TileFrameTable tileFrames = thread.tileFrames;
 
+  // after this point the loop should stay off the heap
+  int framesRun = 0;
+
+  // start collecting timestamped key events for the simulation
+  InputQueue inputQueue;
+  InputState inputState = {0};
+  InputLatency inputLatency = {0};
+  inputInit(&inputQueue);
+
+  // record the game every tick for rewind and quick saves
+  StateHistory history;
+  stateHistoryInit(&history);
+
+  // the loop's timers, a report once a second and the cooldown between rewind steps
+  TimerWheel timers;
+  timerWheelInit(&timers, GAME_TIMER_CAPACITY, timerNow());
+  bool reportDue = false;
+  timerSchedule(&timers, 1000, 1000, raiseFlag, &reportDue);
+  TimerId rewindCooldown = TIMER_NONE;
+
+  // trigger scripts that changed on disk, swapped in between ticks so no game is stepping on them
+  static ScriptLibrary reloadedTriggers;
+
+  // a render test plays with a bot on a clock that moves the player every frame
+  InputState botState = {0};
+  Uint32 botRng = 1;
+
+  // what the player has toggled for the render thread, recording starts at once when asked to
+  RenderToggles toggles = {false, recordPath != NULL, false};
+
+  // the frame on screen stays up until something it shows changes
+  Uint64 shownHash = 0;
+  RenderToggles shownToggles = toggles;
+  bool idle = false;
+  Uint32 effectsUntil = 0; // when the dust and sparkles of the last step or warp have settled
+
+
+  // setup the game loop and main logic
+  while (isRunning && !atomic_load(&pipeline.stopped))
+  {
+    // initialize the loop, determine which screen to render
+    frameStart = SDL_GetTicks();
+
+    // start this frame's memory tracking
+    memBeginFrame();
+    timerWheelAdvance(&timers, timerNow());
+
+    // handle events
+    // this will handle the user input and determine which screen (game or menu) to render
+    GameState tickState = (*instance).currentGameState;
+    int events = HandleEvents(&isRunning, instance, &history, &toggles, &event);
+
+    if (assetWatcherTakeScripts(&assetWatcher, &reloadedTriggers))
+    {
+      replaceTriggerScripts(&reloadedTriggers);
+      printf("Reloaded %s\n", TRIGGER_SCRIPT_PATH);
+    }
+
+    // pumping events above filled the input queue, hand this tick's key changes to the simulation
+    inputDrain(&inputQueue, &inputState, &inputLatency);
+    if (tickState != GAME)
+    {
+      // keys pressed while the menu was open moved through it, closing it must not turn them into steps
+      memset(inputState.tapped, 0, sizeof(inputState.tapped));
+    }
+
+    // advance the game and every animated tile once for this tick
+    if (netClient != NULL)
+    {
+      // online the server moves the player, we send the keys and show what comes back
+      InputState noInput = {0};
+      netClientSendInput(netClient, (*instance).currentGameState == GAME ? &inputState : &noInput, SDL_GetTicks());
+      netClientPoll(netClient);
+      netClientApply(netClient, instance, SDL_GetTicks());
+    }
+    else if (history.rewinding && (*instance).currentGameState == GAME)
+    {
+      // step back through the history at the pace it was recorded, the first step comes at once
+      if (timerCooldownReady(&timers, &rewindCooldown, STATE_RECORD_MS))
+      {
+        stateHistoryRewind(&history, instance);
+      }
+    }
+    else if (renderTestFrames > 0)
+    {
+      // every hundred frames the menu is opened for ten, so it is measured too
+      Uint32 now = (Uint32) framesRun * MOVEMENT_DELAY;
+      (*instance).currentGameState = framesRun % 100 >= 90 ? MENU : GAME;
+      botInput(&botState, &botRng);
+      updateGame(instance, &botState, &inputLatency, now);
+    }
+    else
+    {
+      updateGame(instance, &inputState, &inputLatency, SDL_GetTicks());
+      stateHistoryRecord(&history, instance, SDL_GetTicks());
+    }
+    musicRequest((*instance).musicSelector);
+
+    // the world streams around the chunk the player is on, whether they walked there, rewound or quick loaded
+    WorldStreamer *world = (*instance).world;
+    if (world != NULL && ((*instance).chunkX != (*world).focusX || (*instance).chunkY != (*world).focusY))
+    {
+      worldStreamerFocus(world, (*instance).chunkX, (*instance).chunkY);
+    }
+    bool tilesChanged = tileFrameTableAdvance(&tileFrames, renderTestFrames > 0 ? (Uint32) framesRun * MOVEMENT_DELAY : SDL_GetTicks());
+
+    // the game is idle when it is settled in the menu or standing still offline, and nothing it shows has changed
+    // animated tiles are hidden behind the menu, so only their frames on the map count
+    Direction direction = (*instance).player.direction;
+    bool settled = (*instance).currentGameState == MENU
+                   || ((direction == IDLE_UP || direction == IDLE_DOWN || direction == IDLE_LEFT || direction == IDLE_RIGHT)
+                       && !inputAnyDown(&inputState) && !tilesChanged);
+    Uint64 sceneHash = gameInstanceHash(instance);
+    bool togglesChanged = memcmp(&toggles, &shownToggles, sizeof(toggles)) != 0;
+    bool unchanged = settled && events == 0 && sceneHash == shownHash && !togglesChanged && framesRun > 0
+                     && netClient == NULL && !history.rewinding && renderTestFrames == 0;
+
+    // the particles move on the render thread, weather never stops and dust from the last step is still settling,
+    // so the map is not idle while either is on screen
+    if (sceneHash != shownHash)
+    {
+      effectsUntil = SDL_GetTicks() + PARTICLE_SETTLE_MS;
+    }
+    bool effects = (*instance).currentGameState == GAME
+                   && (weatherForMap((*instance).chooseMap, toggles.night) != WEATHER_NONE
+                       || (Sint32) (effectsUntil - SDL_GetTicks()) > 0);
+    idle = unchanged && !effects;
+    shownHash = sceneHash;
+    shownToggles = toggles;
+
+    if (!idle)
+    {
+      // record this frame while the render thread draws the last one, then hand it over
+      RenderFrame *frame = renderPipelineBegin(&pipeline);
+      recordFrame(frame, instance, &tileFrames, renderTestFrames > 0 ? (Uint32) framesRun * MOVEMENT_DELAY : SDL_GetTicks());
+      (*frame).sequence = (Uint32) framesRun;
+      (*frame).toggles = toggles;
+      (*frame).pendingPress = inputLatency.pendingPress;
+      (*frame).inputDropped = inputLatency.dropped;
+      inputLatency.pendingPress = 0;
+      inputLatency.dropped = 0;
+      renderPipelinePublish(&pipeline);
+    }
+
+
+    // once a second, the render thread reports what it drew
+    if (reportDue)
+    {
+      reportDue = false;
+      memPrintReport(stdout);
+      stateHistoryPrintReport(&history, stdout);
+      timerWheelPrintReport(&timers, stdout);
+      assetWatcherPrintReport(&assetWatcher, stdout);
+    }
+
+    // close this frame's memory tracking, once loading has settled nothing should reach the heap
+    if (!memEndFrame())
+    {
+#ifdef MEM_STRICT
+      // strict builds are used for testing, so treat a steady-state allocation as a failure
+      exitStatus = EXIT_FAILURE;
+      isRunning = 0;
+#endif
+    }
+    if (++framesRun == STEADY_STATE_WARMUP)
+    {
+      memSetSteadyState(true);
+    }
+
+
+    // a render test runs as fast as it can and stops after its frames, every one of them is drawn and measured
+    if (renderTestFrames > 0)
+    {
+      renderPipelineWait(&pipeline);
+      if (framesRun >= renderTestFrames)
+      {
+        isRunning = 0;
+      }
+      continue;
+    }
+
+    // when idle, sleep until input arrives, an animated tile is due for its next frame or a timer is due
+    // when only particles move, sleep no longer than a frame, so they are drawn at a steady rate
+    // the event is left in the queue for the next frame to handle
+    if (unchanged)
+    {
+      Uint32 wait = (*instance).currentGameState == GAME ? tileFrameTableNextChange(&tileFrames, SDL_GetTicks()) : IDLE_MAX_WAIT;
+      Uint64 now = timerNow();
+      Uint64 deadline = timerWheelNextDeadline(&timers);
+      wait = (Uint32) min((Uint64) wait, deadline > now ? deadline - now : 0);
+      SDL_WaitEventTimeout(NULL, (int) min(wait, (Uint32) (idle ? IDLE_MAX_WAIT : EFFECT_FRAME_DELAY)));
+      continue;
+    }
 
     // Framerate control
     int frameTime = SDL_GetTicks() - frameStart;
-    if (FRAME_DELAY > frameTime) 
+    if (FRAME_DELAY > frameTime)
     {
       SDL_Delay(FRAME_DELAY - frameTime);
     }
   }
 
-  // Cleanup 
-  SDL_DestroyTexture(mainCharacter.sprite);
-  destroyTextures(menuTextures, menuTextureCount);
-  destroyTextures(gameTextures, textureCount);
+  // let the render thread finish the frame it is on, it writes out the render statistics as it stops
+  memSetSteadyState(false);
+  renderPipelineStop(&pipeline);
+  renderPipelineDestroy(&pipeline);
+
+  // Cleanup
+  inputShutdown(&inputQueue);
+  stateHistoryDestroy(&history);
+  timerWheelDestroy(&timers);
 
-  SDL_DestroyRenderer(renderer); 
   SDL_DestroyWindow(window);
-  IMG_Quit(); 
-  
+  IMG_Quit();
+
   // set the music selector to -1 to signal the music thread to close
-  musicSelector = -1;
+  (*instance).musicSelector = -1;
+  musicRequest(-1);
   return NULL;
 }
 
 /**
  * This thread function will run the music
  * 
+ * @param arg unused, the game thread hands over each track with musicRequest
+ * 
  * @return void
  */
-void* music() 
+void* music(void* arg) 
 {
+  (void) arg;
+
   // Initialize SDL
   SDL_Init(SDL_INIT_AUDIO);
 
@@ -1041,9 +1268,11 @@ void* music()
   Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048);
 
   // Load music tracks
-  Mix_Music *perllert_town_music = Mix_LoadMUS("assets/audio/perllert_town_music.wav");
-  Mix_Music *perkemern_center = Mix_LoadMUS("assets/audio/perkemern_center.wav");
-  Mix_Music *village_ruins_music = Mix_LoadMUS("assets/audio/village_ruins_music.wav");
+  Mix_Music *tracks[MUSIC_TRACKS] = {NULL};
+  for (int i = 1; i < MUSIC_TRACKS; ++i)
+  {
+    tracks[i] = Mix_LoadMUS(musicTracks[i]);
+  }
   
   bool running = true; // control variable for the main loop
 
@@ -1053,6 +1282,52 @@ void* music()
     // check for events or conditions that might change musicSelector
     static int currentPlaying = 0; // Keep track of what is currently playing
 
+    // sleep until the game asks for a different track or a track changes on disk
+    pthread_mutex_lock(&musicLock);
+    while (musicWanted == currentPlaying && !musicReload)
+    {
+      pthread_cond_wait(&musicChanged, &musicLock);
+    }
+    int musicSelector = musicWanted;
+    bool reload = musicReload;
+    musicReload = false;
+    pthread_mutex_unlock(&musicLock);
+
+    // decode changed tracks here, off the game and render threads, the one playing starts again from the new file
+    AssetChange change;
+    while (reload && assetWatcherTake(&assetWatcher, ASSET_AUDIO, &change))
+    {
+      for (int i = 1; i < MUSIC_TRACKS; ++i)
+      {
+        if (strcmp(change.path, musicTracks[i]) != 0)
+        {
+          continue;
+        }
+
+        memBeginLoad();
+        Mix_Music *loaded = Mix_LoadMUS(change.path);
+        if (loaded == NULL)
+        {
+          fprintf(stderr, "Music %s could not be reloaded! SDL_mixer Error: %s\n", change.path, Mix_GetError());
+        }
+        else
+        {
+          if (i == currentPlaying)
+          {
+            Mix_HaltMusic();
+          }
+          Mix_FreeMusic(tracks[i]);
+          tracks[i] = loaded;
+          if (i == currentPlaying)
+          {
+            Mix_PlayMusic(loaded, -1);
+          }
+          printf("Reloaded %s\n", change.path);
+        }
+        memEndLoad();
+      }
+    }
+
     // see if there's been a change in music selection
     if (currentPlaying != musicSelector) 
     {
@@ -1075,48 +1350,153 @@ void* music()
           break;
         // perllert town music
         case 1:
-          Mix_PlayMusic(perllert_town_music, -1);
+          Mix_PlayMusic(tracks[1], -1);
           break;
         // perkemern center music
         case 2:
-          Mix_PlayMusic(perkemern_center, -1);
+          Mix_PlayMusic(tracks[2], -1);
           break;
         // village ruins music
         case 3:
-          Mix_PlayMusic(village_ruins_music, -1);
+          Mix_PlayMusic(tracks[3], -1);
           break;
       }
 
       // update the currentPlaying variable to match the musicSelector
       currentPlaying = musicSelector;
     }
-
-    SDL_Delay(100); // Delay to prevent this loop from running too fast
   }
 
   // Cleanup
-  Mix_FreeMusic(perllert_town_music);
-  Mix_FreeMusic(perkemern_center);
-  Mix_FreeMusic(village_ruins_music);
+  for (int i = 1; i < MUSIC_TRACKS; ++i)
+  {
+    Mix_FreeMusic(tracks[i]);
+  }
   Mix_CloseAudio();
 
   return NULL;
 }
 
+// the benchmark runner links this file for the functions above and brings its own main
+#ifndef BENCH_BUILD
 /**
  * This is the main function that will run the game by creating two threads
  * 
+ * Running "./game --batch <instances> <steps> [threads]" instead steps many headless games in parallel.
+ * "./game --server [port]" runs a headless server, "./game --connect [port]" plays on it and
+ * "./game --server-bench <clients> [ticks]" measures the server against bot clients over loopback and
+ * "./game --script-bench <actors> [ticks]" measures the script VM,
+ * "./game --world-bench <seed> <size> [threads]" measures procedural world generation,
+ * "./game --world <seed> [ruins]" plays a generated world instead of the hand-made maps and
+ * "./game --render-test <frames>" draws frames headlessly and fails when a map goes over its render budget.
+ * Adding "--record <file>" to a game or a render test records it, "./game --capture-convert <file> <out.rgb>"
+ * turns a recording into raw video.
+ * 
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * 
  * @return 0
  */
-int main () //(int argc, char* argv[])
+int main (int argc, char* argv[])
 {
+  // memory tracking has to hook SDL before either thread initializes it
+  memInit();
+
+  // compile the map triggers before any game can step onto one
+  loadTriggerScripts(TRIGGER_SCRIPT_PATH);
+
+  // the batch runner never opens a window or plays music
+  if (argc >= 4 && strcmp(argv[1], "--batch") == 0)
+  {
+    int threadCount = argc >= 5 ? atoi(argv[4]) : 0;
+    return runBatch(atoi(argv[2]), atoi(argv[3]), threadCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // neither does the server
+  if (argc >= 2 && strcmp(argv[1], "--server") == 0)
+  {
+    return runServer(argc >= 3 ? atoi(argv[2]) : NET_DEFAULT_PORT);
+  }
+  if (argc >= 3 && strcmp(argv[1], "--script-bench") == 0)
+  {
+    return runScriptBenchmark(atoi(argv[2]), argc >= 4 ? atoi(argv[3]) : 1000);
+  }
+  if (argc >= 4 && strcmp(argv[1], "--world-bench") == 0)
+  {
+    return runWorldBenchmark(strtoull(argv[2], NULL, 10), atoi(argv[3]), argc >= 5 ? atoi(argv[4]) : 0);
+  }
+  // a generated world is played like the hand-made maps, its chunks streamed in around the player
+  static WorldStreamer world;
+  bool inWorld = argc >= 3 && strcmp(argv[1], "--world") == 0;
+  if (inWorld)
+  {
+    WorldStyle style = argc >= 4 && strcmp(argv[3], "ruins") == 0 ? WORLD_RUINS : WORLD_OVERWORLD;
+    if (!worldStreamerInit(&world, strtoull(argv[2], NULL, 10), style, 0))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  if (argc >= 3 && strcmp(argv[1], "--server-bench") == 0)
+  {
+    return runServerBenchmark(atoi(argv[2]), argc >= 4 ? atoi(argv[3]) : 1000);
+  }
+
+  if (argc >= 4 && strcmp(argv[1], "--capture-convert") == 0)
+  {
+    return captureConvert(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // any game can be recorded from its first frame
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (strcmp(argv[i], "--record") == 0)
+    {
+      recordPath = argv[i + 1];
+    }
+  }
+
+  // a render test is an ordinary game on the dummy video and audio drivers, played by a bot
+  if (argc >= 3 && strcmp(argv[1], "--render-test") == 0)
+  {
+    renderTestFrames = max(atoi(argv[2]), 1);
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+  }
+
+  // a client is an ordinary game whose player is moved by the server
+  static NetClient connection;
+  if (argc >= 2 && strcmp(argv[1], "--connect") == 0)
+  {
+    if (!netClientOpen(&connection, argc >= 3 ? atoi(argv[2]) : NET_DEFAULT_PORT))
+    {
+      return EXIT_FAILURE;
+    }
+    netClient = &connection;
+  }
+
+  // while playing, a file saved under the asset tree is swapped in without restarting
+  if (renderTestFrames == 0)
+  {
+    assetWatcherStart(&assetWatcher, ASSET_ROOT, assetsChanged, NULL);
+  }
+
+  // the one game this process runs, shared by the game and music threads
+  static GameInstance instance;
+  gameInstanceInit(&instance);
+  if (inWorld && !gameInstanceEnterWorld(&instance, &world))
+  {
+    fprintf(stderr, "The first chunk of the world could not be generated!\n");
+    worldStreamerDestroy(&world);
+    return EXIT_FAILURE;
+  }
+
   // create two threads to run in parallel
   pthread_t threads[2];
 
   // game thread for handling the game and user input
-  int ret = pthread_create(&threads[0], NULL, game, NULL);
+  int ret = pthread_create(&threads[0], NULL, game, &instance);
   // music thread for handling the music
-  int ret1 = pthread_create(&threads[1], NULL, music, NULL);
+  int ret1 = pthread_create(&threads[1], NULL, music, &instance);
 
   // error check for failed thread launch
   if (ret != 0 || ret1 != 0) 
@@ -1128,10 +1508,21 @@ int main () //(int argc, char* argv[])
   // join the threads to prevent the program from closing before the threads are done
   pthread_join(threads[0], NULL);
   pthread_join(threads[1], NULL);
+  assetWatcherStop(&assetWatcher);
+  if (inWorld)
+  {
+    worldStreamerDestroy(&world);
+  }
+
+  if (netClient != NULL)
+  {
+    netClientClose(netClient);
+  }
   
   // SDL_Quit is called here to prevent a forced shutdown of the other thread
   // that could potentially cause concurrency issues if we quit before thread closing
   SDL_Quit();
 
-  return 0;
+  return exitStatus;
 }
+#endif
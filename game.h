@@ -0,0 +1,35 @@
+#ifndef GAME_H
+#define GAME_H
+
+// macros for commonly used values to make easier readability
+#define TILE_WIDTH 16
+#define TILE_HEIGHT 16
+#define X_OFFSET 8
+#define MAP_ROWS 9
+#define MAP_COLS 10
+#define FPS 1200
+#define X_RESOLUTION TILE_WIDTH * 10 // 160 for 16 width
+#define Y_RESOLUTION TILE_HEIGHT * 9 // 144 for 16 height
+#define MOVEMENT_DELAY 150
+#define RES_SCALE 8
+#define MENU_ITEM_COUNT 3
+#define SPRITE_FRAMES 2 // the frames per direction
+#define ANIMATION_DELAY 125 // the millisecond delay between frames
+#define FRAME_DELAY 1000 / FPS // frame delay for 60 fps and making sure CPU does not run 100%
+#define MAX_GAME_TEXTURES 1000 // maximum number of textures that can be loaded for the game
+#define PLAYER_TORCH_RADIUS 4 // tiles the player's torch reaches on dark maps
+#define IDLE_MAX_WAIT 500 // longest the loop sleeps waiting for input when nothing on screen changes
+#define FRAME_ARENA_SIZE (512 * 1024) // scratch bytes the render thread has each frame, enough to sort and draw a full sprite batch
+#define EFFECT_FRAME_DELAY 16 // longest the loop sleeps between frames when only particles move, about 60 fps
+#define SPRITE_PLAYER 0 // the textures sprite render commands draw from
+#define SPRITE_TEXTURE_COUNT 1
+#define MUSIC_TRACKS 4 // musicSelector 0 is silence, then a track for each map
+#define GAME_TIMER_CAPACITY 1024 // timers the game loop can have running at once
+#define STEADY_STATE_WARMUP 120 // frames after startup before the loop must stop touching the heap
+
+// I didn't want to include math.h because I was purely dealing with integers
+// instead I decided to use these trivial macros for min and maxing
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+#endif
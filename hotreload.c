@@ -0,0 +1,496 @@
+// inotify and directory walking need the default feature set on top of strict C11
+#define _DEFAULT_SOURCE
+
+// libraries being used for this file
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#endif
+#include "alloc.h"
+#include "palette.h"
+#include "renderstats.h"
+#include "text.h"
+#include "tiles.h"
+#include "hotreload.h"
+
+/**
+ * This function will take the oldest change of the kinds a thread applies
+ *
+ * @param watcher the asset watcher
+ * @param kinds the AssetKind bits the caller applies
+ * @param change the change taken, its surface belongs to the caller afterwards
+ *
+ * @return bool false when no change of those kinds is waiting
+ */
+bool assetWatcherTake (AssetWatcher *watcher, int kinds, AssetChange *change)
+{
+  if (!(*watcher).active)
+  {
+    return false;
+  }
+
+  bool taken = false;
+  pthread_mutex_lock(&(*watcher).lock);
+  for (int i = 0; i < (*watcher).queueCount && !taken; ++i)
+  {
+    if ((*watcher).queue[i].kind & kinds)
+    {
+      *change = (*watcher).queue[i];
+      memmove(&(*watcher).queue[i], &(*watcher).queue[i + 1], ((*watcher).queueCount - i - 1) * sizeof(AssetChange));
+      --(*watcher).queueCount;
+      taken = true;
+    }
+  }
+  pthread_mutex_unlock(&(*watcher).lock);
+  return taken;
+}
+
+/**
+ * This function will take the trigger scripts once a change to them has compiled
+ *
+ * @param watcher the asset watcher
+ * @param library where to copy the scripts to
+ *
+ * @return bool false when there are no new scripts
+ */
+bool assetWatcherTakeScripts (AssetWatcher *watcher, ScriptLibrary *library)
+{
+  if (!(*watcher).active || !atomic_load(&(*watcher).scriptsReady))
+  {
+    return false;
+  }
+
+  pthread_mutex_lock(&(*watcher).lock);
+  *library = *(*watcher).compiled;
+  atomic_store(&(*watcher).scriptsReady, false);
+  pthread_mutex_unlock(&(*watcher).lock);
+  return true;
+}
+
+/**
+ * This function will print how many files were reloaded since the last report and start a new one
+ *
+ * @param watcher the asset watcher
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void assetWatcherPrintReport (AssetWatcher *watcher, FILE *out)
+{
+  if (!(*watcher).active)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&(*watcher).lock);
+  int changes = (*watcher).changes;
+  int dropped = (*watcher).dropped;
+  int waiting = (*watcher).queueCount;
+  int watchCount = (*watcher).watchCount;
+  (*watcher).changes = 0;
+  (*watcher).dropped = 0;
+  pthread_mutex_unlock(&(*watcher).lock);
+  fprintf(out, "ASSETS: %d files changed, %d waiting to be applied, %d dropped, %d directories watched\n",
+          changes, waiting, dropped, watchCount);
+}
+
+#ifdef __linux__
+/**
+ * This function will check a path's extension
+ *
+ * @param path the path
+ * @param extension the extension, with its dot
+ *
+ * @return bool whether the path ends with it
+ */
+static bool hasExtension (const char *path, const char *extension)
+{
+  size_t length = strlen(path);
+  size_t extensionLength = strlen(extension);
+  return length >= extensionLength && strcmp(path + length - extensionLength, extension) == 0;
+}
+
+/**
+ * This function will watch a directory and every directory under it
+ *
+ * @param watcher the asset watcher
+ * @param directory the directory to watch
+ *
+ * @return void
+ */
+static void watchTree (AssetWatcher *watcher, const char *directory)
+{
+  if ((*watcher).watchCount == ASSET_MAX_WATCHES)
+  {
+    fprintf(stderr, "Too many asset directories to watch, %s is not watched\n", directory);
+    return;
+  }
+
+  int watch = inotify_add_watch((*watcher).fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+  if (watch < 0)
+  {
+    return;
+  }
+  for (int i = 0; i < (*watcher).watchCount; ++i)
+  {
+    if ((*watcher).watches[i] == watch)
+    {
+      return;
+    }
+  }
+  (*watcher).watches[(*watcher).watchCount] = watch;
+  snprintf((*watcher).directories[(*watcher).watchCount], ASSET_PATH_LENGTH, "%s", directory);
+  pthread_mutex_lock(&(*watcher).lock);
+  ++(*watcher).watchCount;
+  pthread_mutex_unlock(&(*watcher).lock);
+
+  DIR *dir = opendir(directory);
+  if (dir == NULL)
+  {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    char path[ASSET_PATH_LENGTH];
+    struct stat info;
+    if (strcmp((*entry).d_name, ".") == 0 || strcmp((*entry).d_name, "..") == 0
+        || snprintf(path, sizeof(path), "%s/%s", directory, (*entry).d_name) >= (int) sizeof(path))
+    {
+      continue;
+    }
+    if (stat(path, &info) == 0 && S_ISDIR(info.st_mode))
+    {
+      watchTree(watcher, path);
+    }
+  }
+  closedir(dir);
+}
+
+/**
+ * This function will queue a change for the thread that applies it, replacing one to the same file still waiting
+ *
+ * @param watcher the asset watcher
+ * @param change the change, the queue takes its surface
+ *
+ * @return void
+ */
+static void queueChange (AssetWatcher *watcher, const AssetChange *change)
+{
+  pthread_mutex_lock(&(*watcher).lock);
+  int i = 0;
+  while (i < (*watcher).queueCount && strcmp((*watcher).queue[i].path, (*change).path) != 0)
+  {
+    ++i;
+  }
+  if (i < (*watcher).queueCount)
+  {
+    SDL_FreeSurface((*watcher).queue[i].surface);
+    (*watcher).queue[i] = *change;
+  }
+  else if ((*watcher).queueCount < ASSET_QUEUE_SIZE)
+  {
+    (*watcher).queue[(*watcher).queueCount++] = *change;
+  }
+  else
+  {
+    SDL_FreeSurface((*change).surface);
+    ++(*watcher).dropped;
+  }
+  ++(*watcher).changes;
+  pthread_mutex_unlock(&(*watcher).lock);
+}
+
+/**
+ * This function will compile the changed trigger file, the scripts running now are kept if it does not compile
+ *
+ * @param watcher the asset watcher
+ * @param path the trigger file
+ *
+ * @return bool whether new scripts are ready
+ */
+static bool compileScripts (AssetWatcher *watcher, const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    return false;
+  }
+  size_t read = fread((*watcher).source, 1, ASSET_MAX_SOURCE, file);
+  fclose(file);
+  if (read == ASSET_MAX_SOURCE)
+  {
+    fprintf(stderr, "%s is too large to reload, it has to be under %d bytes\n", path, ASSET_MAX_SOURCE);
+    return false;
+  }
+  (*watcher).source[read] = '\0';
+
+  if (!scriptCompile((*watcher).compiling, (*watcher).source, path))
+  {
+    return false;
+  }
+
+  pthread_mutex_lock(&(*watcher).lock);
+  *(*watcher).compiled = *(*watcher).compiling;
+  atomic_store(&(*watcher).scriptsReady, true);
+  ++(*watcher).changes;
+  pthread_mutex_unlock(&(*watcher).lock);
+  return true;
+}
+
+/**
+ * This function will get a changed file ready to be applied, decoding or compiling it on the watcher thread
+ *
+ * @param watcher the asset watcher
+ * @param path the file that changed
+ *
+ * @return void
+ */
+static void assetChanged (AssetWatcher *watcher, const char *path)
+{
+  AssetChange change = {0};
+  snprintf(change.path, sizeof(change.path), "%s", path);
+
+  if (strcmp(path, TRIGGER_SCRIPT_PATH) == 0)
+  {
+    memBeginLoad();
+    bool compiled = compileScripts(watcher, path);
+    memEndLoad();
+    if (compiled)
+    {
+      (*watcher).notify(ASSET_SCRIPT, (*watcher).userdata);
+    }
+    return;
+  }
+
+  if (strcmp(path, RENDER_BUDGETS_PATH) == 0)
+  {
+    change.kind = ASSET_BUDGETS;
+  }
+  else if (strcmp(path, FONT_PATH) == 0)
+  {
+    change.kind = ASSET_FONT;
+  }
+  else if (hasExtension(path, ".png"))
+  {
+    change.kind = ASSET_IMAGE;
+  }
+  else if (hasExtension(path, ".wav") || hasExtension(path, ".ogg") || hasExtension(path, ".mp3"))
+  {
+    change.kind = ASSET_AUDIO;
+  }
+  else
+  {
+    if (strcmp(path, ANIMATED_TILES_PATH) == 0)
+    {
+      fprintf(stderr, "%s is only read at startup, restart to see the change\n", path);
+    }
+    return;
+  }
+
+  // images are decoded here, so the render thread only has to upload them
+  if (change.kind == ASSET_IMAGE || change.kind == ASSET_FONT)
+  {
+    memBeginLoad();
+    change.surface = tileSetDecode(path);
+    memEndLoad();
+    if (change.surface == NULL)
+    {
+      return;
+    }
+  }
+
+  queueChange(watcher, &change);
+  (*watcher).notify(change.kind, (*watcher).userdata);
+}
+
+/**
+ * This thread function will wait for files under the asset root to change
+ *
+ * only finished writes and files moved into place count, so a file is never read while it is half written
+ *
+ * @param arg the asset watcher
+ *
+ * @return void
+ */
+static void* watchAssets (void *arg)
+{
+  AssetWatcher *watcher = arg;
+  _Alignas(struct inotify_event) char buffer[4096];
+
+  while (!atomic_load(&(*watcher).stopping))
+  {
+    struct pollfd ready = {(*watcher).fd, POLLIN, 0};
+    if (poll(&ready, 1, ASSET_POLL_MS) <= 0)
+    {
+      continue;
+    }
+
+    ssize_t length = read((*watcher).fd, buffer, sizeof(buffer));
+    const char *at = buffer;
+    while (length > 0 && at < buffer + length)
+    {
+      const struct inotify_event *event = (const struct inotify_event *) at;
+      at += sizeof(struct inotify_event) + (*event).len;
+      if ((*event).mask & IN_Q_OVERFLOW)
+      {
+        fprintf(stderr, "Asset watcher missed changes, save the file again to reload it\n");
+        continue;
+      }
+
+      int w = 0;
+      while (w < (*watcher).watchCount && (*watcher).watches[w] != (*event).wd)
+      {
+        ++w;
+      }
+      char path[ASSET_PATH_LENGTH];
+      if (w == (*watcher).watchCount || (*event).len == 0
+          || snprintf(path, sizeof(path), "%s/%s", (*watcher).directories[w], (*event).name) >= (int) sizeof(path))
+      {
+        continue;
+      }
+
+      if ((*event).mask & IN_ISDIR)
+      {
+        // a new directory is watched as well, along with anything already inside it
+        if ((*event).mask & (IN_CREATE | IN_MOVED_TO))
+        {
+          watchTree(watcher, path);
+        }
+      }
+      else if ((*event).mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+      {
+        assetChanged(watcher, path);
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * This function will close the watcher's inotify instance and free what it allocated, leaving it inactive
+ *
+ * @param watcher the asset watcher, its thread not running
+ *
+ * @return void
+ */
+static void releaseWatcher (AssetWatcher *watcher)
+{
+  close((*watcher).fd);
+  memFree(MEM_GENERAL, (*watcher).compiling);
+  memFree(MEM_GENERAL, (*watcher).compiled);
+  memFree(MEM_GENERAL, (*watcher).source);
+  pthread_mutex_destroy(&(*watcher).lock);
+  memset(watcher, 0, sizeof(*watcher));
+}
+
+/**
+ * This function will start watching the asset tree on a thread of its own
+ *
+ * @param watcher the asset watcher to start
+ * @param root the directory every asset is under
+ * @param notify called from the watcher thread once a change is ready to be applied
+ * @param userdata handed to notify
+ *
+ * @return bool false if the tree cannot be watched, assets are then only loaded at startup
+ */
+bool assetWatcherStart (AssetWatcher *watcher, const char *root, AssetNotify notify, void *userdata)
+{
+  memset(watcher, 0, sizeof(*watcher));
+  (*watcher).fd = inotify_init1(IN_CLOEXEC);
+  if ((*watcher).fd < 0)
+  {
+    fprintf(stderr, "Asset watcher could not be started! Error: %s\n", strerror(errno));
+    return false;
+  }
+
+  pthread_mutex_init(&(*watcher).lock, NULL);
+  (*watcher).compiling = memAlloc(MEM_GENERAL, sizeof(ScriptLibrary));
+  (*watcher).compiled = memAlloc(MEM_GENERAL, sizeof(ScriptLibrary));
+  (*watcher).source = memAlloc(MEM_GENERAL, ASSET_MAX_SOURCE + 1);
+  watchTree(watcher, root);
+  if ((*watcher).compiling == NULL || (*watcher).compiled == NULL || (*watcher).source == NULL
+      || (*watcher).watchCount == 0)
+  {
+    fprintf(stderr, "Asset directory %s could not be watched, assets are only loaded at startup\n", root);
+    releaseWatcher(watcher);
+    return false;
+  }
+
+  (*watcher).notify = notify;
+  (*watcher).userdata = userdata;
+  atomic_init(&(*watcher).scriptsReady, false);
+  atomic_init(&(*watcher).stopping, false);
+  int error = pthread_create(&(*watcher).thread, NULL, watchAssets, watcher);
+  if (error != 0)
+  {
+    fprintf(stderr, "Asset watcher thread could not be started, assets are only loaded at startup! Error: %s\n",
+            strerror(error));
+    releaseWatcher(watcher);
+    return false;
+  }
+  (*watcher).active = true;
+  return true;
+}
+
+/**
+ * This function will stop the watcher thread and free every change that was never applied
+ *
+ * @param watcher the asset watcher to stop
+ *
+ * @return void
+ */
+void assetWatcherStop (AssetWatcher *watcher)
+{
+  if (!(*watcher).active)
+  {
+    return;
+  }
+
+  atomic_store(&(*watcher).stopping, true);
+  pthread_join((*watcher).thread, NULL);
+  close((*watcher).fd);
+  for (int i = 0; i < (*watcher).queueCount; ++i)
+  {
+    SDL_FreeSurface((*watcher).queue[i].surface);
+  }
+  releaseWatcher(watcher);
+}
+#else
+/**
+ * This function will report that assets cannot be watched without inotify
+ *
+ * @param watcher the asset watcher, left inactive
+ * @param root the directory every asset is under
+ * @param notify unused
+ * @param userdata unused
+ *
+ * @return bool false, assets are only loaded at startup
+ */
+bool assetWatcherStart (AssetWatcher *watcher, const char *root, AssetNotify notify, void *userdata)
+{
+  (void) notify;
+  (void) userdata;
+  memset(watcher, 0, sizeof(*watcher));
+  fprintf(stderr, "Asset hot reloading needs inotify, %s is only loaded at startup\n", root);
+  return false;
+}
+
+/**
+ * This function will do nothing, a watcher is never started without inotify
+ *
+ * @param watcher the asset watcher
+ *
+ * @return void
+ */
+void assetWatcherStop (AssetWatcher *watcher)
+{
+  (void) watcher;
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <SDL.h>
+#include "game.h"
+#include "script.h"
+
+#define ASSET_ROOT "assets"
+#define ASSET_MAX_WATCHES 64 // directories under the root that can be watched
+#define ASSET_PATH_LENGTH 256
+#define ASSET_QUEUE_SIZE 32 // changes waiting to be applied, a change to a file already waiting replaces it
+#define ASSET_MAX_SOURCE (64 * 1024) // largest trigger file that is reloaded
+#define ASSET_POLL_MS 100 // how often the watcher checks whether it should stop
+#define ASSET_MAX_APPLY 4 // changes the render thread uploads between two frames, so many saves at once never stall one
+
+// what changed, as bits so each thread can take only the kinds it applies
+typedef enum
+{
+  ASSET_IMAGE = 1,   // a tile or sprite image, decoded before it is queued
+  ASSET_FONT = 2,    // the font atlas, decoded before it is queued
+  ASSET_BUDGETS = 4, // the render budgets
+  ASSET_SCRIPT = 8,  // the trigger scripts, compiled before they are handed over
+  ASSET_AUDIO = 16   // a music track, the music thread decodes it itself
+} AssetKind;
+
+// one file that changed, with its pixels when it is an image
+typedef struct
+{
+  AssetKind kind;
+  char path[ASSET_PATH_LENGTH]; // as the game loads it, starting with the root
+  SDL_Surface *surface; // ARGB pixels of an image or the font, the taker frees it
+} AssetChange;
+
+// called from the watcher thread whenever a change is ready, so the thread that applies it can wake up
+typedef void (*AssetNotify)(AssetKind kind, void *userdata);
+
+// watches the asset tree with inotify, decoding what changed on its own thread so the game only swaps it in
+typedef struct
+{
+  bool active; // set once the watcher is running, nothing can be taken from one that is not
+  int fd;
+  int watches[ASSET_MAX_WATCHES];
+  char directories[ASSET_MAX_WATCHES][ASSET_PATH_LENGTH];
+  int watchCount;
+
+  // the changes waiting for the threads that apply them
+  AssetChange queue[ASSET_QUEUE_SIZE];
+  int queueCount;
+  pthread_mutex_t lock;
+
+  // the trigger scripts are compiled into the first library and copied to the second once they compile
+  ScriptLibrary *compiling;
+  ScriptLibrary *compiled;
+  char *source;
+  atomic_bool scriptsReady;
+
+  AssetNotify notify;
+  void *userdata;
+  pthread_t thread;
+  atomic_bool stopping;
+  int changes, dropped; // files changed and changes lost to a full queue, since the last report
+} AssetWatcher;
+
+bool assetWatcherStart(AssetWatcher *watcher, const char *root, AssetNotify notify, void *userdata);
+bool assetWatcherTake(AssetWatcher *watcher, int kinds, AssetChange *change);
+bool assetWatcherTakeScripts(AssetWatcher *watcher, ScriptLibrary *library);
+void assetWatcherPrintReport(AssetWatcher *watcher, FILE *out);
+void assetWatcherStop(AssetWatcher *watcher);
+
+#endif
@@ -0,0 +1,252 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <string.h>
+#include "game.h"
+#include "input.h"
+
+/**
+ * This function will map a scancode to the movement direction it controls
+ *
+ * @param scancode the scancode to look up
+ *
+ * @return int the direction, or -1 if the key does not move the player
+ */
+static int directionOf (SDL_Scancode scancode)
+{
+  switch (scancode)
+  {
+    case SDL_SCANCODE_W:
+      return INPUT_UP;
+    case SDL_SCANCODE_A:
+      return INPUT_LEFT;
+    case SDL_SCANCODE_S:
+      return INPUT_DOWN;
+    case SDL_SCANCODE_D:
+      return INPUT_RIGHT;
+    default:
+      return -1;
+  }
+}
+
+/**
+ * This event watch will stamp key changes the moment SDL queues them and push them onto the ring
+ *
+ * @param userdata the input queue
+ * @param event the event SDL is queueing
+ *
+ * @return int always 1, the event is still delivered to SDL_PollEvent as usual
+ */
+static int watchInput (void *userdata, SDL_Event *event)
+{
+  if ((event->type == SDL_KEYDOWN || event->type == SDL_KEYUP) && !event->key.repeat)
+  {
+    InputEvent input = {SDL_GetPerformanceCounter(), event->key.keysym.scancode, event->type == SDL_KEYDOWN};
+    inputQueuePush((InputQueue *) userdata, &input);
+  }
+  return 1;
+}
+
+/**
+ * This function will set up the input queue and start collecting key events into it
+ *
+ * @param queue the queue to fill
+ *
+ * @return void
+ */
+void inputInit (InputQueue *queue)
+{
+  memset(queue->events, 0, sizeof(queue->events));
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+  atomic_init(&queue->dropped, 0);
+
+  // the watch runs on whichever thread pumps SDL events, so nothing is missed between ticks
+  SDL_AddEventWatch(watchInput, queue);
+}
+
+/**
+ * This function will stop collecting key events
+ *
+ * @param queue the queue that was being filled
+ *
+ * @return void
+ */
+void inputShutdown (InputQueue *queue)
+{
+  SDL_DelEventWatch(watchInput, queue);
+}
+
+/**
+ * This function will push an event onto the ring, only ever called from the producer side
+ *
+ * @param queue the queue to push onto
+ * @param event the event to push
+ *
+ * @return bool false if the ring was full and the event was dropped
+ */
+bool inputQueuePush (InputQueue *queue, const InputEvent *event)
+{
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+  if (head - tail >= INPUT_QUEUE_SIZE)
+  {
+    atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+    return false;
+  }
+
+  queue->events[head & (INPUT_QUEUE_SIZE - 1)] = *event;
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  return true;
+}
+
+/**
+ * This function will pop the oldest event off the ring, only ever called from the consumer side
+ *
+ * @param queue the queue to pop from
+ * @param event where the event is copied to
+ *
+ * @return bool false if the ring was empty
+ */
+bool inputQueuePop (InputQueue *queue, InputEvent *event)
+{
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+  if (tail == head)
+  {
+    return false;
+  }
+
+  *event = queue->events[tail & (INPUT_QUEUE_SIZE - 1)];
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+/**
+ * This function will apply every queued event to the input state, once per simulation tick
+ *
+ * @param queue the queue to drain
+ * @param state the input state the simulation reads
+ * @param latency the latency tracker, which also counts dropped events
+ *
+ * @return void
+ */
+void inputDrain (InputQueue *queue, InputState *state, InputLatency *latency)
+{
+  InputEvent event;
+  while (inputQueuePop(queue, &event))
+  {
+    int direction = directionOf(event.scancode);
+    if (direction < 0)
+    {
+      continue;
+    }
+
+    state->held[direction] = event.pressed;
+
+    // a press is latched until a move uses it, so a quick tap between ticks still counts
+    if (event.pressed && !state->tapped[direction])
+    {
+      state->tapped[direction] = true;
+      state->pressTime[direction] = event.timestamp;
+    }
+  }
+
+  latency->dropped += atomic_exchange_explicit(&queue->dropped, 0, memory_order_relaxed);
+}
+
+/**
+ * This function will determine whether a direction should be treated as pressed this tick
+ *
+ * @param state the input state
+ * @param direction the direction to check
+ *
+ * @return bool whether the key is held or was tapped since the last move
+ */
+bool inputIsDown (const InputState *state, InputDirection direction)
+{
+  return state->held[direction] || state->tapped[direction];
+}
+
+/**
+ * This function will determine whether any movement key is pressed this tick
+ *
+ * @param state the input state
+ *
+ * @return bool whether any direction is down
+ */
+bool inputAnyDown (const InputState *state)
+{
+  for (int i = 0; i < INPUT_DIRECTION_COUNT; ++i)
+  {
+    if (inputIsDown(state, i))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * This function will mark a direction's press as used by a move and start timing its latency
+ *
+ * @param state the input state
+ * @param direction the direction that was acted on
+ * @param latency the latency tracker, or NULL when nothing is being presented
+ *
+ * @return void
+ */
+void inputConsume (InputState *state, InputDirection direction, InputLatency *latency)
+{
+  if (latency != NULL && state->tapped[direction] && latency->pendingPress == 0)
+  {
+    latency->pendingPress = state->pressTime[direction];
+  }
+
+  // every latched press is used up once the player moves
+  memset(state->tapped, 0, sizeof(state->tapped));
+}
+
+/**
+ * This function will finish timing a press once the frame showing it has been presented
+ *
+ * @param latency the latency tracker
+ *
+ * @return void
+ */
+void inputPresented (InputLatency *latency)
+{
+  if (latency->pendingPress == 0)
+  {
+    return;
+  }
+
+  double ms = (double) (SDL_GetPerformanceCounter() - latency->pendingPress) * 1000.0 / SDL_GetPerformanceFrequency();
+  latency->totalMs += ms;
+  latency->maxMs = max(latency->maxMs, ms);
+  ++latency->samples;
+  latency->pendingPress = 0;
+}
+
+/**
+ * This function will print the latency gathered since the last report and start a new one
+ *
+ * @param latency the latency tracker
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void inputPrintLatency (InputLatency *latency, FILE *out)
+{
+  if (latency->samples > 0)
+  {
+    fprintf(out, "INPUT: %d presses, avg %.2f ms, max %.2f ms to present, %d dropped\n",
+            latency->samples, latency->totalMs / latency->samples, latency->maxMs, latency->dropped);
+  }
+
+  latency->samples = 0;
+  latency->totalMs = 0;
+  latency->maxMs = 0;
+  latency->dropped = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <SDL.h>
+
+#define INPUT_QUEUE_SIZE 256 // must be a power of two so indices can wrap with a mask
+
+// the movement directions the simulation reads, in the order they are checked
+typedef enum { INPUT_UP, INPUT_LEFT, INPUT_DOWN, INPUT_RIGHT, INPUT_DIRECTION_COUNT } InputDirection;
+
+// one key change with the high-resolution time it was seen
+typedef struct
+{
+  Uint64 timestamp; // SDL performance counter ticks
+  SDL_Scancode scancode;
+  bool pressed;
+} InputEvent;
+
+// a single-producer single-consumer ring, the event watch pushes and the simulation pops
+typedef struct
+{
+  InputEvent events[INPUT_QUEUE_SIZE];
+  atomic_uint head; // next slot the producer writes
+  atomic_uint tail; // next slot the consumer reads
+  atomic_int dropped; // events lost because the ring was full
+} InputQueue;
+
+// what the simulation knows about the movement keys at the start of a tick
+typedef struct
+{
+  bool held[INPUT_DIRECTION_COUNT];
+  bool tapped[INPUT_DIRECTION_COUNT]; // pressed since the last move, even if released again already
+  Uint64 pressTime[INPUT_DIRECTION_COUNT]; // when the press behind tapped happened
+} InputState;
+
+// input-to-present latency, measured from a key press to the frame that shows its move
+typedef struct
+{
+  Uint64 pendingPress; // timestamp of a consumed press whose frame has not been presented yet
+  int samples;
+  double totalMs;
+  double maxMs;
+  int dropped;
+} InputLatency;
+
+void inputInit(InputQueue *queue);
+void inputShutdown(InputQueue *queue);
+bool inputQueuePush(InputQueue *queue, const InputEvent *event);
+bool inputQueuePop(InputQueue *queue, InputEvent *event);
+void inputDrain(InputQueue *queue, InputState *state, InputLatency *latency);
+bool inputIsDown(const InputState *state, InputDirection direction);
+bool inputAnyDown(const InputState *state);
+void inputConsume(InputState *state, InputDirection direction, InputLatency *latency);
+void inputPresented(InputLatency *latency);
+void inputPrintLatency(InputLatency *latency, FILE *out);
+
+#endif
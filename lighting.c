@@ -0,0 +1,404 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "tiles.h"
+#include "lighting.h"
+#include "renderstats.h"
+
+/**
+ * This function will take the brighter of two rows of light, 16 tiles at a time
+ *
+ * @param dst the row being accumulated into
+ * @param src the row of light being added
+ * @param count the number of tiles, a multiple of 16
+ *
+ * @return void
+ */
+static void maxRow (Uint8 *dst, const Uint8 *src, int count)
+{
+#ifdef __SSE2__
+  for (int i = 0; i < count; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *) (dst + i));
+    __m128i b = _mm_loadu_si128((const __m128i *) (src + i));
+    _mm_storeu_si128((__m128i *) (dst + i), _mm_max_epu8(a, b));
+  }
+#else
+  for (int i = 0; i < count; ++i)
+  {
+    dst[i] = max(dst[i], src[i]);
+  }
+#endif
+}
+
+/**
+ * This function will turn a row of light into the darkness drawn over it, and reveal lit fog
+ *
+ * shade = 255 - min(max(light, ambient), explored), so unexplored tiles stay black
+ *
+ * @param shade the row of darkness to write
+ * @param light the row of light
+ * @param explored the row of explored flags, updated in place when fog is on
+ * @param ambient the light level every tile has at least
+ * @param fog whether lit tiles should be marked as explored
+ * @param count the number of tiles, a multiple of 16
+ *
+ * @return void
+ */
+static void shadeRow (Uint8 *shade, const Uint8 *light, Uint8 *explored, Uint8 ambient, bool fog, int count)
+{
+#ifdef __SSE2__
+  const __m128i ambientVec = _mm_set1_epi8((char) ambient);
+  const __m128i thresholdVec = _mm_set1_epi8((char) (EXPLORE_THRESHOLD - 1));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi8((char) 0xFF);
+  for (int i = 0; i < count; i += 16)
+  {
+    __m128i lit = _mm_max_epu8(_mm_loadu_si128((const __m128i *) (light + i)), ambientVec);
+    __m128i seen = _mm_loadu_si128((const __m128i *) (explored + i));
+    if (fog)
+    {
+      // a tile is seen once its light is at or above the threshold
+      __m128i bright = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(lit, thresholdVec), zero), ones);
+      seen = _mm_or_si128(seen, bright);
+      _mm_storeu_si128((__m128i *) (explored + i), seen);
+    }
+    _mm_storeu_si128((__m128i *) (shade + i), _mm_xor_si128(_mm_min_epu8(lit, seen), ones));
+  }
+#else
+  for (int i = 0; i < count; ++i)
+  {
+    Uint8 lit = max(light[i], ambient);
+    if (fog && lit >= EXPLORE_THRESHOLD)
+    {
+      explored[i] = 255;
+    }
+    shade[i] = 255 - min(lit, explored[i]);
+  }
+#endif
+}
+
+/**
+ * This function will grow the dirty rows to cover a rectangle of tiles, rows are recomputed whole
+ *
+ * @param layer the lighting layer
+ * @param x0 the left column
+ * @param y0 the top row
+ * @param x1 the right column, inclusive
+ * @param y1 the bottom row, inclusive
+ *
+ * @return void
+ */
+static void markDirty (LightingLayer *layer, int x0, int y0, int x1, int y1)
+{
+  x0 = max(x0, 0);
+  y0 = max(y0, 0);
+  x1 = min(x1, MAP_COLS - 1);
+  y1 = min(y1, MAP_ROWS - 1);
+  if (x0 > x1 || y0 > y1)
+  {
+    return;
+  }
+
+  if (!layer->dirty)
+  {
+    layer->dirtyY0 = y0;
+    layer->dirtyY1 = y1;
+    layer->dirty = true;
+    return;
+  }
+
+  layer->dirtyY0 = min(layer->dirtyY0, y0);
+  layer->dirtyY1 = max(layer->dirtyY1, y1);
+}
+
+/**
+ * This function will flood one light through the walkable tiles around it
+ *
+ * Walls are lit but stop the light from travelling further, the flood never leaves the light's radius.
+ *
+ * @param layer the lighting layer, for the opaque tiles
+ * @param source the light to flood
+ * @param out the grid the light is written to, only cells within the radius are touched
+ *
+ * @return void
+ */
+static void floodLight (LightingLayer *layer, const LightSource *source, Uint8 out[MAP_ROWS][LIGHT_STRIDE])
+{
+  static const int stepX[4] = {1, -1, 0, 0};
+  static const int stepY[4] = {0, 0, 1, -1};
+  int queueX[MAP_ROWS * MAP_COLS];
+  int queueY[MAP_ROWS * MAP_COLS];
+  int queueDistance[MAP_ROWS * MAP_COLS]; // steps from the light along the walkable path
+  int head = 0;
+  int tail = 0;
+
+  if (source->x < 0 || source->x >= MAP_COLS || source->y < 0 || source->y >= MAP_ROWS)
+  {
+    return;
+  }
+
+  out[source->y][source->x] = source->intensity;
+  queueX[tail] = source->x;
+  queueY[tail] = source->y;
+  queueDistance[tail++] = 0;
+
+  // a breadth-first flood, so each tile is reached first along its shortest walkable path
+  // a tile radius steps away is lit but not expanded, however slowly the light fades
+  while (head < tail)
+  {
+    int x = queueX[head];
+    int y = queueY[head];
+    int distance = queueDistance[head++];
+    int level = out[y][x];
+    int next = level - max(source->intensity / source->radius, 1);
+
+    if (distance == source->radius || next <= 0 || (layer->opaque[y][x] && (x != source->x || y != source->y)))
+    {
+      continue;
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+      int nx = x + stepX[i];
+      int ny = y + stepY[i];
+      if (nx < 0 || nx >= MAP_COLS || ny < 0 || ny >= MAP_ROWS || out[ny][nx] != 0)
+      {
+        continue;
+      }
+
+      out[ny][nx] = next;
+      queueX[tail] = nx;
+      queueY[tail] = ny;
+      queueDistance[tail++] = distance + 1;
+    }
+  }
+}
+
+/**
+ * This function will create the texture the darkness is drawn from
+ *
+ * @param layer the lighting layer to set up
+ * @param renderer the renderer the layer belongs to
+ *
+ * @return bool whether the texture could be created
+ */
+bool lightingInit (LightingLayer *layer, SDL_Renderer *renderer)
+{
+  memset(layer, 0, sizeof(*layer));
+  layer->mapId = -1;
+
+  layer->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                     MAP_COLS, MAP_ROWS);
+  if (layer->texture == NULL)
+  {
+    fprintf(stderr, "Lighting texture could not be created! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  // linear filtering turns one texel per tile into smooth light falloff
+  SDL_SetTextureBlendMode(layer->texture, SDL_BLENDMODE_BLEND);
+  SDL_SetTextureScaleMode(layer->texture, SDL_ScaleModeLinear);
+  return true;
+}
+
+/**
+ * This function will set up lighting for a newly loaded map, removing every light
+ *
+ * @param layer the lighting layer
+ * @param map the map that was loaded, its collision data decides which tiles block light
+ * @param mapId the map being lit, so callers can tell when the map has changed
+ * @param ambient the light level every tile has at least, 255 for a fully lit map
+ * @param fog whether tiles start hidden until they have been lit
+ *
+ * @return void
+ */
+void lightingSetMap (LightingLayer *layer, int map[MAP_ROWS][MAP_COLS], int mapId, Uint8 ambient, bool fog)
+{
+  layer->mapId = mapId;
+  layer->enabled = ambient < 255 || fog;
+  layer->ambient = ambient;
+  layer->fog = fog;
+  layer->lightCount = 0;
+
+  memset(layer->opaque, 0, sizeof(layer->opaque));
+  memset(layer->light, 0, sizeof(layer->light));
+  memset(layer->explored, fog ? 0 : 255, sizeof(layer->explored));
+
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    for (int col = 0; col < MAP_COLS; ++col)
+    {
+      layer->opaque[row][col] = tileIsWalkable(map[row][col]) ? 0 : 255;
+    }
+  }
+
+  layer->dirty = false;
+  markDirty(layer, 0, 0, MAP_COLS - 1, MAP_ROWS - 1);
+}
+
+/**
+ * This function will add a light to the current map
+ *
+ * @param layer the lighting layer
+ * @param x the grid column of the light
+ * @param y the grid row of the light
+ * @param radius the number of tiles the light reaches
+ * @param intensity the brightness at the light itself
+ *
+ * @return int the index of the light, or -1 if there is no room
+ */
+int lightingAddLight (LightingLayer *layer, int x, int y, int radius, Uint8 intensity)
+{
+  if (layer->lightCount == MAX_LIGHTS)
+  {
+    return -1;
+  }
+
+  LightSource *source = &layer->lights[layer->lightCount];
+  source->x = x;
+  source->y = y;
+  source->radius = max(radius, 1);
+  source->intensity = intensity;
+  source->active = true;
+
+  markDirty(layer, x - source->radius, y - source->radius, x + source->radius, y + source->radius);
+  return layer->lightCount++;
+}
+
+/**
+ * This function will move a light, only the tiles it left and the tiles it reaches are recomputed
+ *
+ * @param layer the lighting layer
+ * @param index the light to move
+ * @param x the new grid column
+ * @param y the new grid row
+ *
+ * @return void
+ */
+void lightingMoveLight (LightingLayer *layer, int index, int x, int y)
+{
+  LightSource *source = &layer->lights[index];
+  if (source->x == x && source->y == y)
+  {
+    return;
+  }
+
+  int r = source->radius;
+  markDirty(layer, source->x - r, source->y - r, source->x + r, source->y + r);
+  source->x = x;
+  source->y = y;
+  markDirty(layer, x - r, y - r, x + r, y + r);
+}
+
+/**
+ * This function will recompute the light and darkness inside the dirty region
+ *
+ * @param layer the lighting layer
+ *
+ * @return bool whether anything was recomputed
+ */
+bool lightingUpdate (LightingLayer *layer)
+{
+  if (!layer->enabled || !layer->dirty)
+  {
+    return false;
+  }
+
+  int y0 = layer->dirtyY0;
+  int y1 = layer->dirtyY1;
+
+  // rows are recomputed whole, 16 tiles at a time, but only the dirty rows
+  for (int row = y0; row <= y1; ++row)
+  {
+    memset(layer->light[row], 0, LIGHT_STRIDE);
+  }
+
+  // every light that reaches into the dirty rows is flooded again, even one outside the dirty columns,
+  // since the whole rows were cleared and it lit tiles in them too
+  static Uint8 contribution[MAP_ROWS][LIGHT_STRIDE];
+  for (int i = 0; i < layer->lightCount; ++i)
+  {
+    const LightSource *source = &layer->lights[i];
+    int top = max(source->y - source->radius, y0);
+    int bottom = min(source->y + source->radius, y1);
+    if (!source->active || top > bottom)
+    {
+      continue;
+    }
+
+    // the flood can reach rows outside the dirty region, so clear every row it might write to,
+    // which is every row within the radius, since it never takes more than radius steps
+    for (int row = max(source->y - source->radius, 0); row <= min(source->y + source->radius, MAP_ROWS - 1); ++row)
+    {
+      memset(contribution[row], 0, LIGHT_STRIDE);
+    }
+
+    floodLight(layer, source, contribution);
+    for (int row = top; row <= bottom; ++row)
+    {
+      maxRow(layer->light[row], contribution[row], LIGHT_STRIDE);
+    }
+  }
+
+  for (int row = y0; row <= y1; ++row)
+  {
+    shadeRow(layer->shade[row], layer->light[row], layer->explored[row], layer->ambient, layer->fog, LIGHT_STRIDE);
+  }
+
+  layer->dirty = false;
+  layer->textureDirty = true;
+  return true;
+}
+
+/**
+ * This function will draw the darkness over everything rendered so far
+ *
+ * @param layer the lighting layer
+ * @param renderer the renderer to draw with
+ *
+ * @return void
+ */
+void lightingDraw (LightingLayer *layer, SDL_Renderer *renderer)
+{
+  if (!layer->enabled || layer->texture == NULL)
+  {
+    return;
+  }
+
+  // only upload the darkness when it has changed
+  if (layer->textureDirty)
+  {
+    Uint32 pixels[MAP_ROWS * MAP_COLS];
+    for (int row = 0; row < MAP_ROWS; ++row)
+    {
+      for (int col = 0; col < MAP_COLS; ++col)
+      {
+        pixels[row * MAP_COLS + col] = (Uint32) layer->shade[row][col] << 24; // black, with the shade as alpha
+      }
+    }
+    renderUpdateTexture(layer->texture, NULL, pixels, MAP_COLS * sizeof(Uint32));
+    layer->textureDirty = false;
+  }
+
+  renderCopy(renderer, layer->texture, NULL, NULL);
+}
+
+/**
+ * This function will free the lighting texture
+ *
+ * @param layer the lighting layer
+ *
+ * @return void
+ */
+void lightingDestroy (LightingLayer *layer)
+{
+  if (layer->texture != NULL)
+  {
+    SDL_DestroyTexture(layer->texture);
+    layer->texture = NULL;
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "game.h"
+
+#define MAX_LIGHTS 512
+#define LIGHT_STRIDE ((MAP_COLS + 15) & ~15) // rows are padded to whole 16-byte vectors
+#define EXPLORE_THRESHOLD 48 // light level at which a fogged tile counts as seen
+#define PLAYER_LIGHT 0 // the player's torch is always the first light
+
+// a light on the tile grid, the light falls off linearly with the walking distance from it
+typedef struct
+{
+  int x, y; // grid position
+  int radius; // tiles the light reaches
+  Uint8 intensity;
+  bool active;
+} LightSource;
+
+// darkness, lights and fog of war for the current map, kept per tile
+typedef struct
+{
+  int mapId; // the map the layer was set up for
+  bool enabled; // false on fully lit maps, so nothing is computed or drawn
+  bool fog;
+  Uint8 ambient;
+  Uint8 opaque[MAP_ROWS][LIGHT_STRIDE]; // 255 where collision data says the tile blocks light
+  Uint8 light[MAP_ROWS][LIGHT_STRIDE];
+  Uint8 explored[MAP_ROWS][LIGHT_STRIDE]; // 255 once a tile has been seen
+  Uint8 shade[MAP_ROWS][LIGHT_STRIDE]; // darkness drawn over each tile
+  LightSource lights[MAX_LIGHTS];
+  int lightCount;
+  bool dirty;
+  int dirtyY0, dirtyY1; // inclusive rows that need recomputing, whole rows are recomputed
+  bool textureDirty;
+  SDL_Texture *texture; // one texel per tile, stretched over the map with linear filtering
+} LightingLayer;
+
+bool lightingInit(LightingLayer *layer, SDL_Renderer *renderer);
+void lightingSetMap(LightingLayer *layer, int map[MAP_ROWS][MAP_COLS], int mapId, Uint8 ambient, bool fog);
+int lightingAddLight(LightingLayer *layer, int x, int y, int radius, Uint8 intensity);
+void lightingMoveLight(LightingLayer *layer, int index, int x, int y);
+bool lightingUpdate(LightingLayer *layer);
+void lightingDraw(LightingLayer *layer, SDL_Renderer *renderer);
+void lightingDestroy(LightingLayer *layer);
+
+#endif
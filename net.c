@@ -0,0 +1,935 @@
+// POSIX sockets need the default feature set on top of strict C11
+#define _DEFAULT_SOURCE
+
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "alloc.h"
+#include "batch.h"
+#include "net.h"
+
+// the first byte of every packet
+enum { NET_HELLO = 1, NET_WELCOME, NET_REJECT, NET_INPUT, NET_SNAPSHOT };
+
+// which fields of an entity follow its id in a snapshot
+#define NET_FIELD_POSITION 1
+#define NET_FIELD_STATE 2
+#define NET_FIELD_REMOVED 4
+
+#define NET_SNAPSHOT_HEADER 11 // type, sequence, base sequence and entry count
+
+// set by the interrupt handler so a running server can print its totals on the way out
+static volatile sig_atomic_t serverStopping = 0;
+
+/**
+ * This function will write a 32 bit value in little endian order
+ *
+ * @param out where the four bytes go
+ * @param value the value to write
+ *
+ * @return void
+ */
+static void writeU32 (Uint8 *out, Uint32 value)
+{
+  out[0] = (Uint8) value;
+  out[1] = (Uint8) (value >> 8);
+  out[2] = (Uint8) (value >> 16);
+  out[3] = (Uint8) (value >> 24);
+}
+
+/**
+ * This function will read a 32 bit value in little endian order
+ *
+ * @param in the four bytes to read
+ *
+ * @return Uint32 the value
+ */
+static Uint32 readU32 (const Uint8 *in)
+{
+  return (Uint32) in[0] | (Uint32) in[1] << 8 | (Uint32) in[2] << 16 | (Uint32) in[3] << 24;
+}
+
+/**
+ * This function will open a non-blocking UDP socket bound to the loopback address
+ *
+ * @param port the port to bind, 0 lets the system pick one
+ *
+ * @return int the socket, or -1 if it could not be opened
+ */
+static int openSocket (int port)
+{
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Socket could not be created! %s\n", strerror(errno));
+    return -1;
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons((Uint16) port);
+
+  if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0)
+  {
+    fprintf(stderr, "Socket could not be bound to port %d! %s\n", port, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * This function will squeeze a player into the two bytes sent over the wire
+ *
+ * Players only ever stand on whole tiles, so the grid position loses nothing.
+ *
+ * @param game the game whose player is quantized
+ * @param state the quantized player
+ *
+ * @return void
+ */
+void netQuantize (const GameInstance *game, NetEntityState *state)
+{
+  // the player can stand one tile outside the grid right after a map switch, hence the + 1
+  int column = ((*game).player.x - X_OFFSET) / TILE_WIDTH + 1;
+  int row = (*game).player.y / TILE_HEIGHT + 1;
+
+  (*state).position = (Uint8) (max(0, min(column, 15)) | max(0, min(row, 15)) << 4);
+  (*state).state = (Uint8) (((int) (*game).player.direction & 7) | ((*game).chooseMap & 3) << 3);
+}
+
+/**
+ * This function will expand a quantized player back into pixel coordinates
+ *
+ * @param state the quantized player
+ * @param x the player's x position
+ * @param y the player's y position
+ * @param direction the player's direction
+ * @param chooseMap the map the player is on
+ *
+ * @return void
+ */
+void netDequantize (const NetEntityState *state, int *x, int *y, int *direction, int *chooseMap)
+{
+  *x = (((*state).position & 15) - 1) * TILE_WIDTH + X_OFFSET;
+  *y = (((*state).position >> 4) - 1) * TILE_HEIGHT;
+  *direction = (*state).state & 7;
+  *chooseMap = ((*state).state >> 3) & 3;
+}
+
+/**
+ * This function will decide whether a viewer should hear about an entity
+ *
+ * Only entities on the same map within a few chunks of the viewer are sent.
+ *
+ * @param viewer the viewer's quantized state
+ * @param entity the entity's quantized state
+ *
+ * @return bool whether the entity is of interest
+ */
+static bool isOfInterest (const NetEntityState *viewer, const NetEntityState *entity)
+{
+  if (((*viewer).state >> 3) != ((*entity).state >> 3))
+  {
+    return false;
+  }
+
+  int dx = ((*viewer).position & 15) / NET_CHUNK_SIZE - ((*entity).position & 15) / NET_CHUNK_SIZE;
+  int dy = ((*viewer).position >> 4) / NET_CHUNK_SIZE - ((*entity).position >> 4) / NET_CHUNK_SIZE;
+  return abs(dx) <= NET_INTEREST_RADIUS && abs(dy) <= NET_INTEREST_RADIUS;
+}
+
+/**
+ * This function will write a snapshot as the changes from a base the client already has
+ *
+ * @param out the packet to write into, at least NET_MAX_PACKET bytes
+ * @param snapshot the snapshot to send
+ * @param base the newest snapshot the client acknowledged, or NULL to send everything
+ * @param fullBytes incremented by the size the snapshot would have without delta compression
+ *
+ * @return int the packet size
+ */
+static int encodeSnapshot (Uint8 *out, const NetSnapshot *snapshot, const NetSnapshot *base, Uint64 *fullBytes)
+{
+  int size = NET_SNAPSHOT_HEADER;
+  int entries = 0;
+  int visibleCount = 0;
+
+  for (int id = 0; id < NET_MAX_CLIENTS; ++id)
+  {
+    bool wasVisible = base != NULL && (*base).visible[id];
+    int fields = 0;
+
+    if ((*snapshot).visible[id])
+    {
+      ++visibleCount;
+
+      // fields the client does not have yet are sent, everything else it can copy from the base
+      if (!wasVisible || (*base).states[id].position != (*snapshot).states[id].position)
+      {
+        fields |= NET_FIELD_POSITION;
+      }
+      if (!wasVisible || (*base).states[id].state != (*snapshot).states[id].state)
+      {
+        fields |= NET_FIELD_STATE;
+      }
+    }
+    else if (wasVisible)
+    {
+      fields = NET_FIELD_REMOVED;
+    }
+
+    if (fields == 0)
+    {
+      continue;
+    }
+
+    out[size++] = (Uint8) id;
+    out[size++] = (Uint8) fields;
+    if (fields & NET_FIELD_POSITION)
+    {
+      out[size++] = (*snapshot).states[id].position;
+    }
+    if (fields & NET_FIELD_STATE)
+    {
+      out[size++] = (*snapshot).states[id].state;
+    }
+    ++entries;
+  }
+
+  out[0] = NET_SNAPSHOT;
+  writeU32(out + 1, (*snapshot).sequence);
+  writeU32(out + 5, base != NULL ? (*base).sequence : 0);
+  out[9] = (Uint8) entries;
+  out[10] = (Uint8) (entries >> 8);
+
+  *fullBytes += NET_SNAPSHOT_HEADER + visibleCount * 4;
+  return size;
+}
+
+/**
+ * This function will open an authoritative server on the loopback address
+ *
+ * @param server the server to set up
+ * @param port the port to listen on, 0 lets the system pick one
+ *
+ * @return bool whether the server is listening
+ */
+bool netServerOpen (NetServer *server, int port)
+{
+  memset(server, 0, sizeof(*server));
+
+  (*server).clients = memCalloc(MEM_GENERAL, NET_MAX_CLIENTS, sizeof(NetServerClient));
+  if ((*server).clients == NULL)
+  {
+    fprintf(stderr, "Server clients could not be allocated!\n");
+    return false;
+  }
+
+  (*server).socket = openSocket(port);
+  if ((*server).socket < 0)
+  {
+    memFree(MEM_GENERAL, (*server).clients);
+    (*server).clients = NULL;
+    return false;
+  }
+
+  // a full server receives one input from every client per tick, give the kernel room to queue them
+  int bufferSize = 1 << 20;
+  setsockopt((*server).socket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+  setsockopt((*server).socket, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+  getsockname((*server).socket, (struct sockaddr *) &address, &length);
+  (*server).port = ntohs(address.sin_port);
+  return true;
+}
+
+/**
+ * This function will find the client that sent a packet, connecting it if it says hello
+ *
+ * @param server the server
+ * @param address where the packet came from
+ * @param hello whether the packet asks to connect
+ *
+ * @return int the client's entity id, or -1 if it is not connected
+ */
+static int findClient (NetServer *server, const struct sockaddr_in *address, bool hello)
+{
+  int freeSlot = -1;
+
+  for (int id = 0; id < NET_MAX_CLIENTS; ++id)
+  {
+    NetServerClient *client = &(*server).clients[id];
+    if (!(*client).active)
+    {
+      if (freeSlot < 0)
+      {
+        freeSlot = id;
+      }
+      continue;
+    }
+    if ((*client).address.sin_port == (*address).sin_port &&
+        (*client).address.sin_addr.s_addr == (*address).sin_addr.s_addr)
+    {
+      return id;
+    }
+  }
+
+  if (!hello || freeSlot < 0)
+  {
+    return -1;
+  }
+
+  // every client starts a fresh game in Perllert Town
+  NetServerClient *client = &(*server).clients[freeSlot];
+  memset(client, 0, sizeof(*client));
+  (*client).active = true;
+  (*client).address = *address;
+  gameInstanceInit(&(*client).game);
+  ++(*server).clientCount;
+  return freeSlot;
+}
+
+/**
+ * This function will read every packet waiting on the server socket, connecting clients and taking their inputs
+ *
+ * @param server the server
+ *
+ * @return void
+ */
+void netServerReceive (NetServer *server)
+{
+  Uint8 packet[NET_MAX_PACKET];
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+  ssize_t size;
+
+  while ((size = recvfrom((*server).socket, packet, sizeof(packet), 0, (struct sockaddr *) &address, &length)) > 0)
+  {
+    length = sizeof(address);
+    int id = findClient(server, &address, packet[0] == NET_HELLO);
+    if (id >= 0)
+    {
+      (*server).clients[id].lastHeard = (*server).clock;
+    }
+
+    switch (packet[0])
+    {
+      case NET_HELLO:
+      {
+        // a lost welcome is answered again when the client repeats its hello
+        Uint8 reply[2] = {id >= 0 ? NET_WELCOME : NET_REJECT, (Uint8) max(id, 0)};
+        sendto((*server).socket, reply, sizeof(reply), 0, (struct sockaddr *) &address, sizeof(address));
+        break;
+      }
+      case NET_INPUT:
+      {
+        if (id < 0 || size < 6)
+        {
+          break;
+        }
+
+        NetServerClient *client = &(*server).clients[id];
+        Uint32 ack = readU32(packet + 1);
+        if (ack > (*client).acked && ack <= (*server).sequence)
+        {
+          (*client).acked = ack;
+        }
+
+        // a key that went down since the last input counts as a tap, so short presses still move
+        for (int i = 0; i < INPUT_DIRECTION_COUNT; ++i)
+        {
+          bool down = (packet[5] >> i) & 1;
+          if (down && !(*client).input.held[i])
+          {
+            (*client).input.tapped[i] = true;
+          }
+          (*client).input.held[i] = down;
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+/**
+ * This function will run one server tick: take inputs, step every game and send each client its snapshot
+ *
+ * @param server the server
+ *
+ * @return void
+ */
+void netServerTick (NetServer *server)
+{
+  Uint64 start = SDL_GetPerformanceCounter();
+
+  netServerReceive(server);
+
+  (*server).clock += NET_TICK_MS;
+  Uint32 sequence = ++(*server).sequence;
+
+  // step every game and quantize its player once, each client's view is picked out of these
+  static NetEntityState states[NET_MAX_CLIENTS];
+  for (int id = 0; id < NET_MAX_CLIENTS; ++id)
+  {
+    NetServerClient *client = &(*server).clients[id];
+    if ((*client).active && (*server).clock - (*client).lastHeard > NET_TIMEOUT_MS)
+    {
+      // the client went away without a word, free its slot
+      (*client).active = false;
+      --(*server).clientCount;
+    }
+    if ((*client).active)
+    {
+      updateGame(&(*client).game, &(*client).input, NULL, (*server).clock);
+      netQuantize(&(*client).game, &states[id]);
+    }
+  }
+
+  Uint8 packet[NET_MAX_PACKET];
+  for (int id = 0; id < NET_MAX_CLIENTS; ++id)
+  {
+    NetServerClient *client = &(*server).clients[id];
+    if (!(*client).active)
+    {
+      continue;
+    }
+
+    NetSnapshot *snapshot = &(*client).history[sequence % NET_HISTORY];
+    (*snapshot).sequence = sequence;
+    for (int other = 0; other < NET_MAX_CLIENTS; ++other)
+    {
+      (*snapshot).visible[other] = (*server).clients[other].active && isOfInterest(&states[id], &states[other]);
+      (*snapshot).states[other] = states[other];
+    }
+
+    // delta against the newest snapshot the client acknowledged, as long as we still remember it
+    const NetSnapshot *base = NULL;
+    if ((*client).acked != 0 && sequence - (*client).acked < NET_HISTORY &&
+        (*client).history[(*client).acked % NET_HISTORY].sequence == (*client).acked)
+    {
+      base = &(*client).history[(*client).acked % NET_HISTORY];
+    }
+
+    int size = encodeSnapshot(packet, snapshot, base, &(*server).fullBytes);
+    if (sendto((*server).socket, packet, (size_t) size, 0,
+               (struct sockaddr *) &(*client).address, sizeof((*client).address)) == size)
+    {
+      (*server).bytesSent += (Uint64) size;
+      ++(*server).packetsSent;
+    }
+  }
+
+  double tickMs = (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+  (*server).tickMsTotal += tickMs;
+  (*server).tickMsMax = max((*server).tickMsMax, tickMs);
+  ++(*server).ticks;
+}
+
+/**
+ * This function will print the server's bandwidth and tick cost since the last report, then reset them
+ *
+ * @param server the server
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void netServerPrintStats (NetServer *server, FILE *out)
+{
+  if ((*server).ticks == 0)
+  {
+    return;
+  }
+
+  double perClientTick = (*server).clientCount > 0 ?
+                         (double) (*server).bytesSent / (*server).ticks / (*server).clientCount : 0.0;
+  double ratio = (*server).bytesSent > 0 ? (double) (*server).fullBytes / (*server).bytesSent : 0.0;
+
+  fprintf(out, "SERVER: %d clients, %.1f bytes/client/tick (%.1fx smaller than full snapshots), tick %.3f ms avg %.3f ms max\n",
+          (*server).clientCount, perClientTick, ratio, (*server).tickMsTotal / (*server).ticks, (*server).tickMsMax);
+
+  (*server).bytesSent = 0;
+  (*server).fullBytes = 0;
+  (*server).packetsSent = 0;
+  (*server).ticks = 0;
+  (*server).tickMsTotal = 0;
+  (*server).tickMsMax = 0;
+}
+
+/**
+ * This function will close the server and free its clients
+ *
+ * @param server the server
+ *
+ * @return void
+ */
+void netServerClose (NetServer *server)
+{
+  if ((*server).socket >= 0)
+  {
+    close((*server).socket);
+  }
+  memFree(MEM_GENERAL, (*server).clients);
+  (*server).clients = NULL;
+  (*server).socket = -1;
+}
+
+/**
+ * This function will stop the server loop when the process is interrupted
+ *
+ * @param signal the signal that arrived
+ *
+ * @return void
+ */
+static void stopServer (int signal)
+{
+  (void) signal;
+  serverStopping = 1;
+}
+
+/**
+ * This function will run a dedicated server until it is interrupted
+ *
+ * @param port the port to listen on
+ *
+ * @return int the process exit status
+ */
+int runServer (int port)
+{
+  NetServer server;
+  if (!netServerOpen(&server, port))
+  {
+    return EXIT_FAILURE;
+  }
+
+  printf("SERVER: listening on 127.0.0.1:%d\n", server.port);
+  signal(SIGINT, stopServer);
+
+  Uint32 nextTick = SDL_GetTicks();
+  while (!serverStopping)
+  {
+    netServerTick(&server);
+
+    if (server.sequence % (1000 / NET_TICK_MS) == 0)
+    {
+      netServerPrintStats(&server, stdout);
+    }
+
+    // hold a fixed tick rate, a slow tick is not made up for
+    nextTick += NET_TICK_MS;
+    Uint32 now = SDL_GetTicks();
+    if ((Sint32) (nextTick - now) > 0)
+    {
+      SDL_Delay(nextTick - now);
+    }
+    else
+    {
+      nextTick = now;
+    }
+  }
+
+  netServerPrintStats(&server, stdout);
+  netServerClose(&server);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * This function will open a connection to a server on the loopback address
+ *
+ * @param client the client to set up
+ * @param port the server's port
+ *
+ * @return bool whether the socket could be opened, the server welcomes us later
+ */
+bool netClientOpen (NetClient *client, int port)
+{
+  memset(client, 0, sizeof(*client));
+  (*client).id = -1;
+  (*client).socket = openSocket(0);
+  if ((*client).socket < 0)
+  {
+    return false;
+  }
+
+  (*client).server.sin_family = AF_INET;
+  (*client).server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  (*client).server.sin_port = htons((Uint16) port);
+  return true;
+}
+
+/**
+ * This function will send the movement keys to the server, or say hello until the server answers
+ *
+ * Keys are sent whenever they change and once a server tick otherwise, so a lost packet is soon repaired.
+ * Taps are handed to the server, the server runs the movement.
+ *
+ * @param client the client
+ * @param input the movement keys, taps are cleared once sent
+ * @param now the current time in milliseconds
+ *
+ * @return void
+ */
+void netClientSendInput (NetClient *client, InputState *input, Uint32 now)
+{
+  Uint8 keys = 0;
+  for (int i = 0; i < INPUT_DIRECTION_COUNT; ++i)
+  {
+    if ((*input).held[i] || (*input).tapped[i])
+    {
+      keys |= (Uint8) (1 << i);
+    }
+    (*input).tapped[i] = false;
+  }
+
+  if (keys == (*client).lastKeys && now - (*client).lastSend < NET_TICK_MS)
+  {
+    return;
+  }
+
+  Uint8 packet[6] = {NET_HELLO};
+  int size = 1;
+  if ((*client).id >= 0)
+  {
+    packet[0] = NET_INPUT;
+    writeU32(packet + 1, (*client).ack);
+    packet[5] = keys;
+    size = 6;
+  }
+
+  sendto((*client).socket, packet, (size_t) size, 0, (struct sockaddr *) &(*client).server, sizeof((*client).server));
+  (*client).lastKeys = keys;
+  (*client).lastSend = now;
+}
+
+/**
+ * This function will rebuild a snapshot from its base and the changes the server sent
+ *
+ * @param client the client
+ * @param packet the snapshot packet
+ * @param size the packet size
+ *
+ * @return bool whether the snapshot is newer than anything we had and could be decoded
+ */
+static bool decodeSnapshot (NetClient *client, const Uint8 *packet, int size)
+{
+  if (size < NET_SNAPSHOT_HEADER)
+  {
+    return false;
+  }
+
+  Uint32 sequence = readU32(packet + 1);
+  Uint32 baseSequence = readU32(packet + 5);
+  int entries = packet[9] | packet[10] << 8;
+
+  // late packets are dropped, as are deltas against a base we no longer have
+  if (sequence <= (*client).ack)
+  {
+    return false;
+  }
+
+  // the snapshot is built on the side and only stored once the whole packet has been read, since its slot
+  // can be the one latest points to and is still drawn from
+  NetSnapshot snapshot;
+  if (baseSequence != 0)
+  {
+    const NetSnapshot *base = &(*client).history[baseSequence % NET_HISTORY];
+    if ((*base).sequence != baseSequence || sequence - baseSequence >= NET_HISTORY)
+    {
+      return false;
+    }
+    snapshot = *base;
+  }
+  else
+  {
+    memset(&snapshot, 0, sizeof(snapshot));
+  }
+
+  int offset = NET_SNAPSHOT_HEADER;
+  for (int i = 0; i < entries; ++i)
+  {
+    if (offset + 2 > size)
+    {
+      return false;
+    }
+
+    int id = packet[offset++];
+    int fields = packet[offset++];
+    int needed = ((fields & NET_FIELD_POSITION) ? 1 : 0) + ((fields & NET_FIELD_STATE) ? 1 : 0);
+    if (offset + needed > size)
+    {
+      return false;
+    }
+
+    if (fields & NET_FIELD_REMOVED)
+    {
+      snapshot.visible[id] = false;
+      continue;
+    }
+
+    snapshot.visible[id] = true;
+    if (fields & NET_FIELD_POSITION)
+    {
+      snapshot.states[id].position = packet[offset++];
+    }
+    if (fields & NET_FIELD_STATE)
+    {
+      snapshot.states[id].state = packet[offset++];
+    }
+  }
+
+  NetSnapshot *stored = &(*client).history[sequence % NET_HISTORY];
+  *stored = snapshot;
+  (*stored).sequence = sequence;
+  (*client).ack = sequence;
+  (*client).latest = stored;
+  return true;
+}
+
+/**
+ * This function will read everything the server sent since the last poll
+ *
+ * @param client the client
+ *
+ * @return bool whether a newer snapshot arrived
+ */
+bool netClientPoll (NetClient *client)
+{
+  Uint8 packet[NET_MAX_PACKET];
+  bool updated = false;
+  ssize_t size;
+
+  while ((size = recv((*client).socket, packet, sizeof(packet), 0)) > 0)
+  {
+    (*client).bytesReceived += (Uint64) size;
+
+    switch (packet[0])
+    {
+      case NET_WELCOME:
+        if (size >= 2 && (*client).id < 0)
+        {
+          (*client).id = packet[1];
+          (*client).lastSend = 0;
+        }
+        break;
+      case NET_REJECT:
+        fprintf(stderr, "The server is full!\n");
+        break;
+      case NET_SNAPSHOT:
+        if ((*client).id >= 0 && decodeSnapshot(client, packet, (int) size))
+        {
+          updated = true;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return updated;
+}
+
+/**
+ * This function will make a game show what the server says about its player
+ *
+ * The server runs the movement, so only the walking animation is advanced here.
+ *
+ * @param client the client
+ * @param instance the game being drawn
+ * @param currentTime the current time in milliseconds
+ *
+ * @return void
+ */
+void netClientApply (const NetClient *client, GameInstance *instance, Uint32 currentTime)
+{
+  if ((*client).latest != NULL && (*client).id >= 0 && (*(*client).latest).visible[(*client).id])
+  {
+    int x, y, direction, chooseMap;
+    netDequantize(&(*(*client).latest).states[(*client).id], &x, &y, &direction, &chooseMap);
+
+    if (chooseMap != (*instance).chooseMap)
+    {
+      // the map ids and their music line up, see updateGame
+      loadMap((*instance).map, (MapType) (chooseMap - 1));
+      (*instance).chooseMap = chooseMap;
+      (*instance).musicSelector = chooseMap;
+    }
+    (*instance).player.x = x;
+    (*instance).player.y = y;
+    (*instance).player.direction = (Direction) direction;
+  }
+
+  Direction direction = (*instance).player.direction;
+  if (direction == IDLE_RIGHT || direction == IDLE_LEFT || direction == IDLE_UP || direction == IDLE_DOWN)
+  {
+    (*instance).currentFrame = 0;
+  }
+  else if (currentTime - (*instance).lastAnimationFrame >= ANIMATION_DELAY)
+  {
+    (*instance).currentFrame = ((*instance).currentFrame + 1) % SPRITE_FRAMES;
+    (*instance).lastAnimationFrame = currentTime;
+  }
+}
+
+/**
+ * This function will close the connection
+ *
+ * @param client the client
+ *
+ * @return void
+ */
+void netClientClose (NetClient *client)
+{
+  if ((*client).socket >= 0)
+  {
+    close((*client).socket);
+  }
+  (*client).socket = -1;
+  (*client).latest = NULL;
+}
+
+/**
+ * This function will connect many bot clients to an in-process server and measure bandwidth and tick cost
+ *
+ * Everything goes through real loopback sockets, the ticks just run back to back instead of on a timer.
+ *
+ * @param clientCount the number of bot clients
+ * @param ticks the number of server ticks to run
+ *
+ * @return int the process exit status
+ */
+int runServerBenchmark (int clientCount, int ticks)
+{
+  if (clientCount <= 0 || clientCount > NET_MAX_CLIENTS || ticks <= 0)
+  {
+    fprintf(stderr, "Usage: ./game --server-bench <clients 1-%d> [ticks]\n", NET_MAX_CLIENTS);
+    return EXIT_FAILURE;
+  }
+
+  NetServer server;
+  if (!netServerOpen(&server, 0))
+  {
+    return EXIT_FAILURE;
+  }
+
+  NetClient *clients = memCalloc(MEM_GENERAL, (size_t) clientCount, sizeof(NetClient));
+  InputState *inputs = memCalloc(MEM_GENERAL, (size_t) clientCount, sizeof(InputState));
+  if (clients == NULL || inputs == NULL)
+  {
+    fprintf(stderr, "Benchmark clients could not be allocated!\n");
+    memFree(MEM_GENERAL, clients);
+    memFree(MEM_GENERAL, inputs);
+    netServerClose(&server);
+    return EXIT_FAILURE;
+  }
+
+  int opened = 0;
+  while (opened < clientCount && netClientOpen(&clients[opened], server.port))
+  {
+    ++opened;
+  }
+
+  // connect everyone, the server reads between batches of clients so its socket never overflows
+  for (int attempt = 0; attempt < 10; ++attempt)
+  {
+    for (int i = 0; i < opened; ++i)
+    {
+      if (clients[i].id < 0)
+      {
+        netClientSendInput(&clients[i], &inputs[i], (Uint32) attempt * NET_TICK_MS + NET_TICK_MS);
+        netClientPoll(&clients[i]);
+      }
+      if (i % 32 == 31)
+      {
+        netServerReceive(&server);
+      }
+    }
+    netServerReceive(&server);
+    for (int i = 0; i < opened; ++i)
+    {
+      netClientPoll(&clients[i]);
+    }
+  }
+  netServerPrintStats(&server, stdout);
+
+  int connected = 0;
+  for (int i = 0; i < opened; ++i)
+  {
+    connected += clients[i].id >= 0 ? 1 : 0;
+  }
+
+  Uint64 bytesReceived = 0;
+  long long mismatches = 0;
+  Uint32 rngs[NET_MAX_CLIENTS];
+  for (int i = 0; i < opened; ++i)
+  {
+    rngs[i] = (Uint32) (i + 1) * 2654435761u;
+  }
+  Uint64 start = SDL_GetPerformanceCounter();
+
+  for (int tick = 1; tick <= ticks; ++tick)
+  {
+    Uint32 now = (Uint32) tick * NET_TICK_MS;
+    for (int i = 0; i < opened; ++i)
+    {
+      botInput(&inputs[i], &rngs[i]);
+      netClientSendInput(&clients[i], &inputs[i], now + NET_TICK_MS);
+      if (i % 32 == 31)
+      {
+        netServerReceive(&server);
+      }
+    }
+
+    netServerTick(&server);
+
+    // every client's rebuilt view of itself has to match what the server simulated
+    for (int i = 0; i < opened; ++i)
+    {
+      Uint64 before = clients[i].bytesReceived;
+      netClientPoll(&clients[i]);
+      bytesReceived += clients[i].bytesReceived - before;
+
+      int id = clients[i].id;
+      if (id >= 0)
+      {
+        NetEntityState truth;
+        netQuantize(&server.clients[id].game, &truth);
+        const NetSnapshot *latest = clients[i].latest;
+        if (latest == NULL || !(*latest).visible[id] ||
+            (*latest).states[id].position != truth.position || (*latest).states[id].state != truth.state)
+        {
+          ++mismatches;
+        }
+      }
+    }
+  }
+
+  double seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+  printf("SERVER BENCH: %d/%d clients connected, %d ticks in %.3f s, %.1f bytes received/client/tick, %lld desynced views\n",
+         connected, clientCount, ticks, seconds, connected > 0 ? (double) bytesReceived / ticks / connected : 0.0, mismatches);
+  netServerPrintStats(&server, stdout);
+
+  for (int i = 0; i < opened; ++i)
+  {
+    netClientClose(&clients[i]);
+  }
+  memFree(MEM_GENERAL, clients);
+  memFree(MEM_GENERAL, inputs);
+  netServerClose(&server);
+
+  return connected == clientCount && mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
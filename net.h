@@ -0,0 +1,96 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdbool.h>
+#include <netinet/in.h>
+#include <SDL.h>
+#include "game.h"
+#include "input.h"
+#include "sim.h"
+
+#define NET_DEFAULT_PORT 27960
+#define NET_MAX_CLIENTS 256 // entity ids fit in one byte
+#define NET_TICK_MS 50 // the server simulates and sends snapshots 20 times a second
+#define NET_HISTORY 16 // snapshots remembered on each side as delta bases, a power of two
+#define NET_CHUNK_SIZE 4 // tiles per side of an interest chunk
+#define NET_INTEREST_RADIUS 1 // chunks around the viewer whose entities are sent
+#define NET_MAX_PACKET 1400
+#define NET_TIMEOUT_MS 5000 // a client that sends nothing for this long is dropped
+
+// an entity quantized for the wire, two bytes in total
+typedef struct
+{
+  Uint8 position; // grid column + 1 in the low nibble, grid row + 1 in the high nibble
+  Uint8 state; // direction in the low 3 bits, map in the next 2 bits
+} NetEntityState;
+
+// what one client could see on one tick
+typedef struct
+{
+  Uint32 sequence; // 0 means the slot is empty
+  bool visible[NET_MAX_CLIENTS];
+  NetEntityState states[NET_MAX_CLIENTS];
+} NetSnapshot;
+
+// the server's record of one connected client
+typedef struct
+{
+  bool active;
+  struct sockaddr_in address;
+  GameInstance game; // the authoritative game for this client's player
+  InputState input;
+  Uint32 acked; // newest snapshot the client has confirmed
+  Uint32 lastHeard; // server clock when the client's last packet arrived
+  NetSnapshot history[NET_HISTORY];
+} NetServerClient;
+
+// an authoritative server, it owns every player's simulation
+typedef struct
+{
+  int socket;
+  int port;
+  NetServerClient *clients;
+  int clientCount;
+  Uint32 sequence;
+  Uint32 clock; // simulated milliseconds
+  Uint64 bytesSent;
+  Uint64 fullBytes; // what the same snapshots would have cost without delta compression
+  Uint64 packetsSent;
+  Uint64 ticks;
+  double tickMsTotal;
+  double tickMsMax;
+} NetServer;
+
+// a client connection, the latest snapshot says where every visible player is
+typedef struct
+{
+  int socket;
+  struct sockaddr_in server;
+  int id; // our entity id, -1 until the server welcomes us
+  Uint32 ack;
+  NetSnapshot history[NET_HISTORY];
+  const NetSnapshot *latest;
+  Uint64 bytesReceived;
+  Uint8 lastKeys;
+  Uint32 lastSend;
+} NetClient;
+
+void netQuantize(const GameInstance *game, NetEntityState *state);
+void netDequantize(const NetEntityState *state, int *x, int *y, int *direction, int *chooseMap);
+
+bool netServerOpen(NetServer *server, int port);
+void netServerReceive(NetServer *server);
+void netServerTick(NetServer *server);
+void netServerPrintStats(NetServer *server, FILE *out);
+void netServerClose(NetServer *server);
+int runServer(int port);
+
+bool netClientOpen(NetClient *client, int port);
+void netClientSendInput(NetClient *client, InputState *input, Uint32 now);
+bool netClientPoll(NetClient *client);
+void netClientApply(const NetClient *client, GameInstance *instance, Uint32 currentTime);
+void netClientClose(NetClient *client);
+
+int runServerBenchmark(int clientCount, int ticks);
+
+#endif
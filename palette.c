@@ -0,0 +1,507 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <SDL_image.h>
+#include "alloc.h"
+#include "palette.h"
+#include "renderstats.h"
+
+/**
+ * This function will give how bright a color looks, used to order an image's palette
+ *
+ * @param argb the color
+ *
+ * @return Uint32 the weighted sum of its channels
+ */
+static Uint32 colorLuma (Uint32 argb)
+{
+  return ((argb >> 16) & 0xFF) * 77 + ((argb >> 8) & 0xFF) * 150 + (argb & 0xFF) * 29;
+}
+
+/**
+ * This function will order two colors for a palette, transparent first and then from lightest to darkest
+ *
+ * @param a the first color
+ * @param b the second color
+ *
+ * @return int negative, zero or positive as for qsort
+ */
+static int compareColors (const void *a, const void *b)
+{
+  Uint32 colorA = *(const Uint32 *) a;
+  Uint32 colorB = *(const Uint32 *) b;
+  bool clearA = (colorA >> 24) == 0;
+  bool clearB = (colorB >> 24) == 0;
+  if (clearA != clearB)
+  {
+    return clearA ? -1 : 1;
+  }
+
+  Uint32 lumaA = colorLuma(colorA);
+  Uint32 lumaB = colorLuma(colorB);
+  if (lumaA != lumaB)
+  {
+    return lumaA > lumaB ? -1 : 1;
+  }
+  return colorA < colorB ? -1 : (colorA > colorB ? 1 : 0);
+}
+
+/**
+ * This function will show a color the way a palette mode wants it, transparency is kept as it is
+ *
+ * @param argb the color the image was drawn with
+ * @param mode the palette to show it with
+ *
+ * @return Uint32 the color to draw
+ */
+static Uint32 filterColor (Uint32 argb, PaletteMode mode)
+{
+  Uint32 a = argb & 0xFF000000;
+  int r = (argb >> 16) & 0xFF;
+  int g = (argb >> 8) & 0xFF;
+  int b = argb & 0xFF;
+  int luma = (int) (colorLuma(argb) >> 8);
+
+  switch (mode)
+  {
+    case PALETTE_NIGHT:
+      // darker, with the blue kept the longest
+      r = r * 3 / 8;
+      g = g * 7 / 16;
+      b = b * 5 / 8 + 24;
+      break;
+    case PALETTE_RUINS:
+      // mostly faded to a warm grey
+      r = (luma * 3 + r) / 4 + 12;
+      g = (luma * 3 + g) / 4 + 4;
+      b = (luma * 3 + b) / 4;
+      break;
+    default:
+      break;
+  }
+
+  r = min(max(r, 0), 255);
+  g = min(max(g, 0), 255);
+  b = min(max(b, 0), 255);
+  return a | ((Uint32) r << 16) | ((Uint32) g << 8) | (Uint32) b;
+}
+
+/**
+ * This function will fill the table that turns one byte of packed indices into the pixels it holds
+ *
+ * @param lookup the table, entry v holds the 4 (2bpp) or 2 (4bpp) pixels of byte v
+ * @param palette the colors to expand into, all PALETTE_MAX_COLORS entries are read
+ * @param bpp the bits per pixel of the indices
+ *
+ * @return void
+ */
+static void buildLookup (Uint32 lookup[256][4], const Uint32 *palette, int bpp)
+{
+  int perByte = 8 / bpp;
+  int mask = (1 << bpp) - 1;
+  for (int value = 0; value < 256; ++value)
+  {
+    for (int k = 0; k < perByte; ++k)
+    {
+      lookup[value][k] = palette[(value >> (k * bpp)) & mask];
+    }
+  }
+}
+
+/**
+ * This function will expand one row of packed indices into ARGB pixels
+ *
+ * every byte is a single table lookup, written as one 16-byte store (2bpp) or one 8-byte store (4bpp)
+ *
+ * @param dst the row of pixels to write
+ * @param src the row of packed indices, the first pixel in the lowest bits
+ * @param width the pixels in the row
+ * @param bpp the bits per pixel of the indices
+ * @param lookup the table built for the image's palette
+ *
+ * @return void
+ */
+static void expandRow (Uint32 *dst, const Uint8 *src, int width, int bpp, const Uint32 lookup[256][4])
+{
+  int perByte = 8 / bpp;
+  int whole = width / perByte;
+#ifdef __SSE2__
+  if (bpp == 2)
+  {
+    for (int i = 0; i < whole; ++i)
+    {
+      _mm_storeu_si128((__m128i *) (dst + i * 4), _mm_loadu_si128((const __m128i *) lookup[src[i]]));
+    }
+  }
+  else
+  {
+    for (int i = 0; i < whole; ++i)
+    {
+      _mm_storel_epi64((__m128i *) (dst + i * 2), _mm_loadl_epi64((const __m128i *) lookup[src[i]]));
+    }
+  }
+#else
+  for (int i = 0; i < whole; ++i)
+  {
+    memcpy(dst + i * perByte, lookup[src[i]], perByte * sizeof(Uint32));
+  }
+#endif
+
+  // the last pixels of a row that does not fill its final byte
+  for (int x = whole * perByte; x < width; ++x)
+  {
+    dst[x] = lookup[src[x / perByte]][x % perByte];
+  }
+}
+
+/**
+ * This function will expand an image through a palette mode and upload it to its texture
+ *
+ * @param set the tile set holding the image's indices
+ * @param image the image to expand
+ * @param mode the palette to show it with
+ *
+ * @return void
+ */
+static void expandImage (TileSet *set, const IndexedImage *image, PaletteMode mode)
+{
+  Uint32 palette[PALETTE_MAX_COLORS] = {0};
+  static Uint32 lookup[256][4]; // only the render thread expands images
+  for (int i = 0; i < (*image).colorCount; ++i)
+  {
+    palette[i] = filterColor((*image).colors[i], mode);
+  }
+  buildLookup(lookup, palette, (*image).bpp);
+
+  const Uint8 *rows = (*set).indices + (*image).offset;
+  for (int y = 0; y < (*image).height; ++y)
+  {
+    expandRow((*set).scratch + (size_t) y * (*image).width, rows + (size_t) y * (*image).pitch,
+              (*image).width, (*image).bpp, lookup);
+  }
+  renderUpdateTexture((*image).texture, NULL, (*set).scratch, (*image).width * (int) sizeof(Uint32));
+}
+
+/**
+ * This function will set up an empty tile set
+ *
+ * @param set the tile set to set up
+ *
+ * @return bool true if its memory could be allocated
+ */
+bool tileSetInit (TileSet *set)
+{
+  memset(set, 0, sizeof(*set));
+  (*set).images = memCalloc(MEM_RENDER, TILESET_MAX_IMAGES, sizeof(IndexedImage));
+  (*set).indices = memAlloc(MEM_RENDER, TILESET_INDEX_BYTES);
+  (*set).scratch = memAlloc(MEM_RENDER, TILESET_MAX_PIXELS * sizeof(Uint32));
+  if ((*set).images == NULL || (*set).indices == NULL || (*set).scratch == NULL)
+  {
+    fprintf(stderr, "Tile set could not be allocated\n");
+    tileSetDestroy(set);
+    return false;
+  }
+  (*set).mode = PALETTE_DAY;
+  return true;
+}
+
+/**
+ * This function will decode an image file into ARGB pixels, it touches no renderer so any thread can call it
+ *
+ * @param path the image file
+ *
+ * @return SDL_Surface* the pixels, NULL if the image could not be loaded
+ */
+SDL_Surface* tileSetDecode (const char *path)
+{
+  SDL_Surface *loaded = IMG_Load(path);
+  if (loaded == NULL)
+  {
+    fprintf(stderr, "Image %s could not be loaded! SDL_image Error: %s\n", path, IMG_GetError());
+    return NULL;
+  }
+
+  SDL_Surface *surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+  SDL_FreeSurface(loaded);
+  if (surface == NULL)
+  {
+    fprintf(stderr, "Image %s could not be converted! SDL_Error: %s\n", path, SDL_GetError());
+  }
+  return surface;
+}
+
+/**
+ * This function will store an image's pixels as packed palette indices and give it a texture
+ *
+ * images with 4 colors or fewer take 2 bits per pixel, up to 16 take 4, anything else is kept as it was loaded
+ * an image stored before keeps its texture when it is indexed at the same size, and its indices when they fit
+ *
+ * @param set the tile set the indices are kept in
+ * @param renderer the renderer the texture is created for
+ * @param surface the decoded pixels
+ * @param image the image to fill in, left as it was if no texture could be made
+ * @param indexable false when the image cannot be tracked, so it is kept as it was loaded
+ *
+ * @return SDL_Texture* the image's texture, shown with the tile set's current palette, NULL if it could not be made
+ */
+static SDL_Texture* storeImage (TileSet *set, SDL_Renderer *renderer, SDL_Surface *surface, IndexedImage *image,
+                                bool indexable)
+{
+  // collect the image's colors, every fully transparent pixel counts as the same color
+  int width = (*surface).w;
+  int height = (*surface).h;
+  int stride = (*surface).pitch / (int) sizeof(Uint32);
+  IndexedImage stored = {0};
+  bool indexed = indexable && width * height <= TILESET_MAX_PIXELS;
+  SDL_LockSurface(surface);
+  const Uint32 *pixels = (*surface).pixels;
+  for (int y = 0; y < height && indexed; ++y)
+  {
+    for (int x = 0; x < width && indexed; ++x)
+    {
+      Uint32 color = pixels[y * stride + x];
+      color = (color >> 24) == 0 ? 0 : color;
+      int i = 0;
+      while (i < stored.colorCount && stored.colors[i] != color)
+      {
+        ++i;
+      }
+      if (i == stored.colorCount)
+      {
+        if (stored.colorCount == PALETTE_MAX_COLORS)
+        {
+          indexed = false;
+          break;
+        }
+        stored.colors[stored.colorCount++] = color;
+      }
+    }
+  }
+
+  // a reloaded image writes over its old indices when the new ones fit, otherwise they go after the rest
+  stored.bpp = stored.colorCount <= 4 ? 2 : 4;
+  stored.pitch = (width * stored.bpp + 7) / 8;
+  size_t bytes = (size_t) stored.pitch * height;
+  bool appended = (*image).bpp == 0 || bytes > (size_t) (*image).pitch * (*image).height;
+  stored.offset = appended ? (*set).indexBytes : (*image).offset;
+  indexed = indexed && stored.offset + bytes <= TILESET_INDEX_BYTES;
+
+  SDL_Texture *texture = NULL;
+  if (indexed)
+  {
+    bool sameSize = (*image).bpp != 0 && (*image).width == width && (*image).height == height;
+    texture = sameSize ? (*image).texture
+                       : SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, width, height);
+  }
+  if (texture != NULL)
+  {
+    // pack every pixel's place in the sorted palette
+    qsort(stored.colors, stored.colorCount, sizeof(Uint32), compareColors);
+    Uint8 *rows = (*set).indices + stored.offset;
+    memset(rows, 0, bytes);
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        Uint32 color = pixels[y * stride + x];
+        color = (color >> 24) == 0 ? 0 : color;
+        int i = 0;
+        while (stored.colors[i] != color)
+        {
+          ++i;
+        }
+        int bit = x * stored.bpp;
+        rows[(size_t) y * stored.pitch + bit / 8] |= (Uint8) (i << (bit % 8));
+      }
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+  }
+  SDL_UnlockSurface(surface);
+
+  if (texture == NULL)
+  {
+    // too many colors, too big, or the texture could not be made, so keep the image as it was loaded
+    texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (texture == NULL)
+    {
+      fprintf(stderr, "Texture could not be created! SDL_Error: %s\n", SDL_GetError());
+      return NULL;
+    }
+    memset(&stored, 0, sizeof(stored));
+  }
+
+  // only indexed images count towards what indexing saved
+  if ((*image).bpp != 0)
+  {
+    (*set).rgbaBytes -= (size_t) (*image).width * (*image).height * sizeof(Uint32);
+  }
+  if (stored.bpp != 0)
+  {
+    (*set).rgbaBytes += (size_t) width * height * sizeof(Uint32);
+    (*set).indexBytes += appended ? bytes : 0;
+  }
+
+  stored.texture = texture;
+  stored.width = width;
+  stored.height = height;
+  memcpy(stored.path, (*image).path, sizeof(stored.path));
+  *image = stored;
+  if ((*image).bpp != 0)
+  {
+    expandImage(set, image, (*set).mode);
+  }
+  return texture;
+}
+
+/**
+ * This function will load an image, keeping it as packed palette indices when it has 16 colors or fewer
+ *
+ * @param set the tile set to add the image to
+ * @param renderer the renderer the texture is created for
+ * @param path the image file
+ *
+ * @return SDL_Texture* the image's texture, shown with the tile set's current palette, NULL if it could not be loaded
+ */
+SDL_Texture* tileSetLoadImage (TileSet *set, SDL_Renderer *renderer, const char *path)
+{
+  SDL_Surface *surface = tileSetDecode(path);
+  if (surface == NULL)
+  {
+    return NULL;
+  }
+
+  // every image is remembered by its path so it can be reloaded, even the ones kept as they were loaded
+  bool tracked = (*set).images != NULL && (*set).imageCount < TILESET_MAX_IMAGES;
+  IndexedImage image = {0};
+  snprintf(image.path, sizeof(image.path), "%s", path);
+  SDL_Texture *texture = storeImage(set, renderer, surface, &image, tracked);
+  SDL_FreeSurface(surface);
+  if (texture != NULL && tracked)
+  {
+    (*set).images[(*set).imageCount++] = image;
+  }
+  return texture;
+}
+
+/**
+ * This function will replace a loaded image with new pixels for the same path
+ *
+ * the texture is updated in place when the image is indexed at the same size as before, otherwise a new one is made
+ * and the old one handed back, so the caller can point everything that drew it at the new one and then destroy it
+ *
+ * @param set the tile set the image was loaded through
+ * @param renderer the renderer the textures belong to
+ * @param path the image file that changed
+ * @param surface its decoded pixels
+ * @param replaced set to the texture the image no longer uses, NULL when it kept its texture
+ *
+ * @return SDL_Texture* the image's texture, NULL if the path was never loaded or the texture could not be made
+ */
+SDL_Texture* tileSetReloadImage (TileSet *set, SDL_Renderer *renderer, const char *path, SDL_Surface *surface,
+                                 SDL_Texture **replaced)
+{
+  *replaced = NULL;
+  for (int i = 0; i < (*set).imageCount; ++i)
+  {
+    IndexedImage *image = &(*set).images[i];
+    if (strcmp((*image).path, path) == 0)
+    {
+      SDL_Texture *old = (*image).texture;
+      SDL_Texture *texture = storeImage(set, renderer, surface, image, true);
+      if (texture != NULL && texture != old)
+      {
+        *replaced = old;
+      }
+      return texture;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * This function will show every indexed image with another palette
+ *
+ * only the textures change, so the same texture pointers keep working everywhere they are used
+ *
+ * @param set the tile set to change
+ * @param mode the palette to show the images with
+ *
+ * @return void
+ */
+void tileSetApply (TileSet *set, PaletteMode mode)
+{
+  if ((*set).mode == mode)
+  {
+    return;
+  }
+
+  (*set).mode = mode;
+  for (int i = 0; i < (*set).imageCount; ++i)
+  {
+    if ((*set).images[i].bpp != 0)
+    {
+      expandImage(set, &(*set).images[i], mode);
+      ++(*set).expansions;
+    }
+  }
+}
+
+/**
+ * This function will choose the palette a map is shown with
+ *
+ * @param chooseMap the map being shown (1 perllert town, 2 perkemern center, 3 village ruins)
+ * @param night whether night mode is on, which every map follows
+ *
+ * @return PaletteMode the palette to apply
+ */
+PaletteMode paletteForMap (int chooseMap, bool night)
+{
+  if (night)
+  {
+    return PALETTE_NIGHT;
+  }
+  return chooseMap == 3 ? PALETTE_RUINS : PALETTE_DAY;
+}
+
+/**
+ * This function will write how much memory indexing the images saved
+ *
+ * @param set the tile set to report on
+ * @param out the stream to write to
+ *
+ * @return void
+ */
+void tileSetPrintReport (const TileSet *set, FILE *out)
+{
+  int indexed = 0;
+  for (int i = 0; i < (*set).imageCount; ++i)
+  {
+    indexed += (*set).images[i].bpp != 0;
+  }
+  fprintf(out, "TILES: %d indexed images, %zu bytes of indices for %zu bytes of RGBA (%.1fx smaller), %d expansions\n",
+          indexed, (*set).indexBytes, (*set).rgbaBytes,
+          (*set).indexBytes > 0 ? (double) (*set).rgbaBytes / (double) (*set).indexBytes : 0.0,
+          (*set).expansions);
+}
+
+/**
+ * This function will free the tile set's memory, the textures belong to whoever loaded them
+ *
+ * @param set the tile set to free
+ *
+ * @return void
+ */
+void tileSetDestroy (TileSet *set)
+{
+  memFree(MEM_RENDER, (*set).images);
+  memFree(MEM_RENDER, (*set).indices);
+  memFree(MEM_RENDER, (*set).scratch);
+  (*set).images = NULL;
+  (*set).indices = NULL;
+  (*set).scratch = NULL;
+  (*set).imageCount = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL.h>
+#include "game.h"
+
+#define PALETTE_MAX_COLORS 16 // an image with more colors than this is kept as it was loaded
+#define TILESET_MAX_IMAGES MAX_GAME_TEXTURES
+#define TILESET_INDEX_BYTES (256 * 1024) // packed indices for every image, 1M pixels at 2 bits each
+#define TILESET_MAX_PIXELS (256 * 256) // largest image that is stored indexed
+#define TILESET_PATH_LENGTH 128
+
+// the palettes every indexed image can be shown with, swapping between them costs one expansion
+typedef enum
+{
+  PALETTE_DAY,   // the colors the images were drawn with
+  PALETTE_NIGHT,
+  PALETTE_RUINS,
+  PALETTE_COUNT
+} PaletteMode;
+
+// an image stored as 2 or 4 bits per pixel, expanded into its texture whenever the palette changes
+typedef struct
+{
+  SDL_Texture *texture;
+  int width, height;
+  int bpp; // 2 or 4, 0 when the image is kept as it was loaded
+  int pitch; // bytes per row of packed indices
+  size_t offset; // where the rows start in the tile set's index data
+  int colorCount;
+  Uint32 colors[PALETTE_MAX_COLORS]; // the image's own colors as ARGB, transparent then lightest first
+  char path[TILESET_PATH_LENGTH]; // the file it was loaded from, so it can be reloaded when the file changes
+} IndexedImage;
+
+// every image loaded through it, the indices are kept and the RGBA pixels only live in the textures
+// images with too many colors are remembered too, with a bpp of 0, so every image can be reloaded
+typedef struct
+{
+  IndexedImage *images;
+  int imageCount;
+  Uint8 *indices;
+  size_t indexBytes;
+  Uint32 *scratch; // the expanded pixels of one image on their way to its texture
+  PaletteMode mode;
+  size_t rgbaBytes; // what the indexed images would take as RGBA
+  int expansions; // images expanded by palette swaps
+} TileSet;
+
+bool tileSetInit(TileSet *set);
+SDL_Surface* tileSetDecode(const char *path);
+SDL_Texture* tileSetLoadImage(TileSet *set, SDL_Renderer *renderer, const char *path);
+SDL_Texture* tileSetReloadImage(TileSet *set, SDL_Renderer *renderer, const char *path, SDL_Surface *surface,
+                                SDL_Texture **replaced);
+void tileSetApply(TileSet *set, PaletteMode mode);
+PaletteMode paletteForMap(int chooseMap, bool night);
+void tileSetPrintReport(const TileSet *set, FILE *out);
+void tileSetDestroy(TileSet *set);
+
+#endif
@@ -0,0 +1,412 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "alloc.h"
+#include "renderstats.h"
+#include "particles.h"
+
+// how one kind of particle starts out and looks, its velocity and life are picked between the bounds
+typedef struct
+{
+  SDL_Color color;
+  Uint8 w, h;
+  float vxMin, vxMax;
+  float vyMin, vyMax;
+  float lifeMin, lifeMax;
+  float gravity;
+} ParticleStyle;
+
+static const ParticleStyle styles[PARTICLE_EFFECT_COUNT] =
+{
+  {{196, 180, 148, 255}, 1, 1, -14.0f, 14.0f, -16.0f, -4.0f, 0.25f, 0.5f, 60.0f},   // dust
+  {{255, 240, 150, 255}, 1, 1, -40.0f, 40.0f, -50.0f, 20.0f, 0.4f, 0.9f, 30.0f},    // sparkle
+  {{150, 170, 235, 255}, 1, 3, -14.0f, -10.0f, 150.0f, 190.0f, 2.0f, 2.0f, 0.0f},   // rain
+  {{240, 244, 255, 255}, 1, 1, -8.0f, 8.0f, 10.0f, 22.0f, 10.0f, 14.0f, 0.0f}       // snow
+};
+
+// weather particles started each second, along the top of the screen
+static const float weatherRates[] = {0.0f, 1200.0f, 250.0f};
+static const ParticleEffect weatherEffects[] = {PARTICLE_EFFECT_COUNT, PARTICLE_RAIN, PARTICLE_SNOW};
+
+/**
+ * This function will pick a number between two bounds
+ *
+ * @param system the particle system, whose generator is advanced
+ * @param low the lowest number
+ * @param high the highest number
+ *
+ * @return float the number
+ */
+static float randomBetween (ParticleSystem *system, float low, float high)
+{
+  // xorshift, the top 24 bits make the fraction
+  Uint32 x = (*system).rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  (*system).rng = x;
+  return low + (high - low) * (float) (x >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * This function will set up an empty particle system with room for PARTICLE_CAPACITY particles
+ *
+ * @param system the particle system
+ *
+ * @return bool true if its memory could be allocated
+ */
+bool particleSystemInit (ParticleSystem *system)
+{
+  memset(system, 0, sizeof(*system));
+  float **fields[] = {&(*system).x, &(*system).y, &(*system).vx, &(*system).vy,
+                      &(*system).ay, &(*system).life, &(*system).fade};
+  bool allocated = true;
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
+  {
+    *fields[i] = memCalloc(MEM_RENDER, PARTICLE_CAPACITY, sizeof(float));
+    allocated = allocated && *fields[i] != NULL;
+  }
+  (*system).effect = memCalloc(MEM_RENDER, PARTICLE_CAPACITY, sizeof(Uint8));
+  (*system).vertices = memCalloc(MEM_RENDER, (size_t) PARTICLE_CAPACITY * 4, sizeof(SDL_Vertex));
+  (*system).indices = memAlloc(MEM_RENDER, (size_t) PARTICLE_CAPACITY * 6 * sizeof(int));
+  if (!allocated || (*system).effect == NULL || (*system).vertices == NULL || (*system).indices == NULL)
+  {
+    fprintf(stderr, "Particle system could not be allocated!\n");
+    particleSystemDestroy(system);
+    return false;
+  }
+
+  // every particle is a quad of two triangles
+  for (int i = 0; i < PARTICLE_CAPACITY; ++i)
+  {
+    int *quad = &(*system).indices[i * 6];
+    quad[0] = i * 4;
+    quad[1] = i * 4 + 1;
+    quad[2] = i * 4 + 2;
+    quad[3] = i * 4 + 2;
+    quad[4] = i * 4 + 1;
+    quad[5] = i * 4 + 3;
+  }
+  (*system).rng = 2463534242u;
+  return true;
+}
+
+/**
+ * This function will start particles at a point, nothing is emitted at a point off the screen
+ *
+ * @param system the particle system
+ * @param effect what kind of particles
+ * @param x where they start, in screen pixels
+ * @param y where they start, in screen pixels
+ * @param count how many
+ *
+ * @return void
+ */
+void particleEmit (ParticleSystem *system, ParticleEffect effect, float x, float y, int count)
+{
+  if (x < -PARTICLE_CULL_MARGIN || x > X_RESOLUTION + PARTICLE_CULL_MARGIN
+      || y < -PARTICLE_CULL_MARGIN || y > Y_RESOLUTION + PARTICLE_CULL_MARGIN)
+  {
+    (*system).culled += count;
+    return;
+  }
+
+  const ParticleStyle *style = &styles[effect];
+  for (int n = 0; n < count; ++n)
+  {
+    if ((*system).count == PARTICLE_CAPACITY)
+    {
+      (*system).dropped += count - n;
+      return;
+    }
+
+    int i = (*system).count++;
+    float life = randomBetween(system, (*style).lifeMin, (*style).lifeMax);
+    (*system).x[i] = x;
+    (*system).y[i] = y;
+    (*system).vx[i] = randomBetween(system, (*style).vxMin, (*style).vxMax);
+    (*system).vy[i] = randomBetween(system, (*style).vyMin, (*style).vyMax);
+    (*system).ay[i] = (*style).gravity;
+    (*system).life[i] = life;
+    (*system).fade[i] = 4.0f * 255.0f / life;
+    (*system).effect[i] = (Uint8) effect;
+    ++(*system).emitted;
+  }
+}
+
+/**
+ * This function will change the weather, the particles already falling finish on their own
+ *
+ * @param system the particle system
+ * @param weather the new weather
+ *
+ * @return void
+ */
+void particleSetWeather (ParticleSystem *system, Weather weather)
+{
+  if ((*system).weather != weather)
+  {
+    (*system).weather = weather;
+    (*system).weatherDebt = 0.0f;
+  }
+}
+
+/**
+ * This function will choose the weather a map has
+ *
+ * @param chooseMap the map being shown (1 perllert town, 2 perkemern center, 3 village ruins)
+ * @param night whether night mode is on
+ *
+ * @return Weather rain over the ruins, snow over the town at night, and nothing indoors
+ */
+Weather weatherForMap (int chooseMap, bool night)
+{
+  if (chooseMap == 3)
+  {
+    return WEATHER_RAIN;
+  }
+  return chooseMap == 1 && night ? WEATHER_SNOW : WEATHER_NONE;
+}
+
+/**
+ * This function will remove every particle
+ *
+ * @param system the particle system
+ *
+ * @return void
+ */
+void particleClear (ParticleSystem *system)
+{
+  (*system).count = 0;
+  (*system).weatherDebt = 0.0f;
+}
+
+/**
+ * This function will copy one particle over another
+ *
+ * @param system the particle system
+ * @param to the slot to write
+ * @param from the particle to copy
+ *
+ * @return void
+ */
+static void moveParticle (ParticleSystem *system, int to, int from)
+{
+  (*system).x[to] = (*system).x[from];
+  (*system).y[to] = (*system).y[from];
+  (*system).vx[to] = (*system).vx[from];
+  (*system).vy[to] = (*system).vy[from];
+  (*system).ay[to] = (*system).ay[from];
+  (*system).life[to] = (*system).life[from];
+  (*system).fade[to] = (*system).fade[from];
+  (*system).effect[to] = (*system).effect[from];
+}
+
+/**
+ * This function will move every particle, age it, and remove the ones that ran out of life or left the screen
+ *
+ * both passes run four particles at a time, the arrays are padded so the last group can run past the end
+ *
+ * @param system the particle system
+ * @param dt seconds since the last update, cut to PARTICLE_MAX_STEP
+ *
+ * @return void
+ */
+void particleUpdate (ParticleSystem *system, float dt)
+{
+  dt = dt < 0.0f ? 0.0f : (dt > PARTICLE_MAX_STEP ? PARTICLE_MAX_STEP : dt);
+
+  // the weather keeps falling in from above the screen
+  if ((*system).weather != WEATHER_NONE)
+  {
+    (*system).weatherDebt += weatherRates[(*system).weather] * dt;
+    int due = (int) (*system).weatherDebt;
+    (*system).weatherDebt -= (float) due;
+    for (int n = 0; n < due; ++n)
+    {
+      particleEmit(system, weatherEffects[(*system).weather], randomBetween(system, 0.0f, (float) X_RESOLUTION),
+                   -2.0f, 1);
+    }
+  }
+
+  float *x = (*system).x;
+  float *y = (*system).y;
+  float *vx = (*system).vx;
+  float *vy = (*system).vy;
+  float *ay = (*system).ay;
+  float *life = (*system).life;
+  int count = (*system).count;
+  const float low = -PARTICLE_CULL_MARGIN;
+  const float right = X_RESOLUTION + PARTICLE_CULL_MARGIN;
+  const float bottom = Y_RESOLUTION + PARTICLE_CULL_MARGIN;
+
+  // integrate, gravity changes the velocity before it moves the particle
+#ifdef __SSE2__
+  __m128 step = _mm_set1_ps(dt);
+  for (int i = 0; i < count; i += 4)
+  {
+    __m128 velocityY = _mm_add_ps(_mm_load_ps(&vy[i]), _mm_mul_ps(_mm_load_ps(&ay[i]), step));
+    _mm_store_ps(&vy[i], velocityY);
+    _mm_store_ps(&x[i], _mm_add_ps(_mm_load_ps(&x[i]), _mm_mul_ps(_mm_load_ps(&vx[i]), step)));
+    _mm_store_ps(&y[i], _mm_add_ps(_mm_load_ps(&y[i]), _mm_mul_ps(velocityY, step)));
+    _mm_store_ps(&life[i], _mm_sub_ps(_mm_load_ps(&life[i]), step));
+  }
+#else
+  for (int i = 0; i < count; ++i)
+  {
+    vy[i] += ay[i] * dt;
+    x[i] += vx[i] * dt;
+    y[i] += vy[i] * dt;
+    life[i] -= dt;
+  }
+#endif
+
+  // keep the particles that are alive and on the screen, packed to the front in the order they were
+  int kept = 0;
+  int i = 0;
+#ifdef __SSE2__
+  __m128 zero = _mm_setzero_ps();
+  __m128 lowBound = _mm_set1_ps(low);
+  __m128 rightBound = _mm_set1_ps(right);
+  __m128 bottomBound = _mm_set1_ps(bottom);
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 px = _mm_load_ps(&x[i]);
+    __m128 py = _mm_load_ps(&y[i]);
+    __m128 alive = _mm_and_ps(_mm_cmpgt_ps(_mm_load_ps(&life[i]), zero),
+                              _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, lowBound), _mm_cmple_ps(px, rightBound)),
+                                         _mm_and_ps(_mm_cmpge_ps(py, lowBound), _mm_cmple_ps(py, bottomBound))));
+    int mask = _mm_movemask_ps(alive);
+
+    // a whole group alive with nothing removed before it stays where it is
+    if (mask == 0xF && kept == i)
+    {
+      kept += 4;
+      continue;
+    }
+    for (int lane = 0; lane < 4; ++lane)
+    {
+      if (mask & (1 << lane))
+      {
+        moveParticle(system, kept++, i + lane);
+      }
+      else if (life[i + lane] <= 0.0f)
+      {
+        ++(*system).expired;
+      }
+      else
+      {
+        ++(*system).culled;
+      }
+    }
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    if (life[i] > 0.0f && x[i] >= low && x[i] <= right && y[i] >= low && y[i] <= bottom)
+    {
+      if (kept != i)
+      {
+        moveParticle(system, kept, i);
+      }
+      ++kept;
+    }
+    else if (life[i] <= 0.0f)
+    {
+      ++(*system).expired;
+    }
+    else
+    {
+      ++(*system).culled;
+    }
+  }
+  (*system).count = kept;
+}
+
+/**
+ * This function will draw every particle in one geometry submission
+ *
+ * @param system the particle system
+ * @param renderer the renderer to draw with
+ *
+ * @return void
+ */
+void particleDraw (ParticleSystem *system, SDL_Renderer *renderer)
+{
+  if ((*system).count == 0)
+  {
+    return;
+  }
+
+  // a particle is opaque until the last quarter of its life, then fades out
+  SDL_Vertex *vertices = (*system).vertices;
+  for (int i = 0; i < (*system).count; ++i)
+  {
+    const ParticleStyle *style = &styles[(*system).effect[i]];
+    float alpha = (*system).life[i] * (*system).fade[i];
+    SDL_Color color = (*style).color;
+    color.a = alpha >= 255.0f ? 255 : (Uint8) alpha;
+
+    float left = (*system).x[i];
+    float top = (*system).y[i];
+    SDL_Vertex *quad = &vertices[i * 4];
+    quad[0].position.x = left;
+    quad[0].position.y = top;
+    quad[1].position.x = left + (*style).w;
+    quad[1].position.y = top;
+    quad[2].position.x = left;
+    quad[2].position.y = top + (*style).h;
+    quad[3].position.x = left + (*style).w;
+    quad[3].position.y = top + (*style).h;
+    quad[0].color = color;
+    quad[1].color = color;
+    quad[2].color = color;
+    quad[3].color = color;
+  }
+
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+  renderGeometry(renderer, NULL, vertices, (*system).count * 4, (*system).indices, (*system).count * 6);
+}
+
+/**
+ * This function will print how many particles lived and died since the last report and start a new one
+ *
+ * @param system the particle system
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void particlePrintReport (ParticleSystem *system, FILE *out)
+{
+  fprintf(out, "PARTICLES: %d live, %d emitted, %d expired, %d culled off screen, %d dropped\n",
+          (*system).count, (*system).emitted, (*system).expired, (*system).culled, (*system).dropped);
+  (*system).emitted = 0;
+  (*system).expired = 0;
+  (*system).culled = 0;
+  (*system).dropped = 0;
+}
+
+/**
+ * This function will free the particle system's memory
+ *
+ * @param system the particle system
+ *
+ * @return void
+ */
+void particleSystemDestroy (ParticleSystem *system)
+{
+  memFree(MEM_RENDER, (*system).x);
+  memFree(MEM_RENDER, (*system).y);
+  memFree(MEM_RENDER, (*system).vx);
+  memFree(MEM_RENDER, (*system).vy);
+  memFree(MEM_RENDER, (*system).ay);
+  memFree(MEM_RENDER, (*system).life);
+  memFree(MEM_RENDER, (*system).fade);
+  memFree(MEM_RENDER, (*system).effect);
+  memFree(MEM_RENDER, (*system).vertices);
+  memFree(MEM_RENDER, (*system).indices);
+  memset(system, 0, sizeof(*system));
+}
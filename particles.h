@@ -0,0 +1,70 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL.h>
+#include "game.h"
+
+#define PARTICLE_CAPACITY (128 * 1024) // live particles, a multiple of 4 so the kernels can run past the last one
+#define PARTICLE_MAX_STEP 0.1f // longest step in seconds, a longer gap (the menu, a stall) is cut to this
+#define PARTICLE_CULL_MARGIN 4.0f // pixels past the screen a particle can drift before it is removed
+#define PARTICLE_DUST_COUNT 6 // kicked up by each step
+#define PARTICLE_SPARKLE_COUNT 48 // thrown out around the player on a warp
+#define PARTICLE_SETTLE_MS 1000 // longer than any dust or sparkle lives, the scene keeps being drawn this long after a step
+
+// what a particle looks like and how it moves, each has a style
+typedef enum
+{
+  PARTICLE_DUST,
+  PARTICLE_SPARKLE,
+  PARTICLE_RAIN,
+  PARTICLE_SNOW,
+  PARTICLE_EFFECT_COUNT
+} ParticleEffect;
+
+// the weather a map has, it keeps emitting along the top of the screen
+typedef enum
+{
+  WEATHER_NONE,
+  WEATHER_RAIN,
+  WEATHER_SNOW
+} Weather;
+
+// every live particle as one array per field, so the update runs four particles per instruction
+typedef struct
+{
+  float *x, *y; // pixels on the 160x144 screen
+  float *vx, *vy; // pixels per second
+  float *ay; // gravity, pixels per second squared
+  float *life; // seconds left
+  float *fade; // alpha lost per second of life, so a particle fades out over its last quarter
+  Uint8 *effect;
+  int count;
+  Weather weather;
+  float weatherDebt; // the fraction of a weather particle owed from the last update
+  Uint32 rng;
+
+  // the geometry every particle is drawn with in one submission, the indices are filled in once
+  SDL_Vertex *vertices;
+  int *indices;
+
+  // what the last frame drawn with particles showed, footsteps and warps are found by comparing against it
+  int mapId;
+  int emitterX, emitterY;
+  Uint32 time;
+
+  int emitted, expired, culled, dropped; // since the last report
+} ParticleSystem;
+
+bool particleSystemInit(ParticleSystem *system);
+void particleEmit(ParticleSystem *system, ParticleEffect effect, float x, float y, int count);
+void particleSetWeather(ParticleSystem *system, Weather weather);
+Weather weatherForMap(int chooseMap, bool night);
+void particleClear(ParticleSystem *system);
+void particleUpdate(ParticleSystem *system, float dt);
+void particleDraw(ParticleSystem *system, SDL_Renderer *renderer);
+void particlePrintReport(ParticleSystem *system, FILE *out);
+void particleSystemDestroy(ParticleSystem *system);
+
+#endif
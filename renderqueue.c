@@ -0,0 +1,248 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include "alloc.h"
+#include "renderqueue.h"
+
+/**
+ * This function will set up the frames and the semaphore the two threads hand frames over with
+ *
+ * @param pipeline the pipeline to set up
+ *
+ * @return bool true if its memory could be allocated
+ */
+bool renderPipelineInit (RenderPipeline *pipeline)
+{
+  memset(pipeline, 0, sizeof(*pipeline));
+  (*pipeline).frames = memCalloc(MEM_RENDER, RENDER_PIPELINE_FRAMES, sizeof(RenderFrame));
+  (*pipeline).posted = SDL_CreateSemaphore(0);
+  if ((*pipeline).frames == NULL || (*pipeline).posted == NULL)
+  {
+    fprintf(stderr, "Render pipeline could not be created! SDL_Error: %s\n", SDL_GetError());
+    renderPipelineDestroy(pipeline);
+    return false;
+  }
+
+  // the game starts on frame 0, frame 1 waits between the threads and the render thread holds frame 2
+  (*pipeline).back = 0;
+  atomic_init(&(*pipeline).shared, 1);
+  (*pipeline).front = 2;
+  atomic_init(&(*pipeline).loaded, false);
+  atomic_init(&(*pipeline).stopping, false);
+  atomic_init(&(*pipeline).stopped, false);
+  atomic_init(&(*pipeline).published, 0);
+  atomic_init(&(*pipeline).replaced, 0);
+  return true;
+}
+
+/**
+ * This function will empty the frame the game records into next, only called from the game thread
+ *
+ * @param pipeline the pipeline to record into
+ *
+ * @return RenderFrame* the frame to record, the render thread does not see it until it is published
+ */
+RenderFrame* renderPipelineBegin (RenderPipeline *pipeline)
+{
+  RenderFrame *frame = &(*pipeline).frames[(*pipeline).back];
+  (*frame).count = 0;
+  (*frame).dropped = 0;
+  return frame;
+}
+
+/**
+ * This function will add a command to a frame
+ *
+ * @param frame the frame being recorded
+ * @param layer the layer the command is drawn on
+ * @param type what the command draws
+ * @param texture the texture it draws from, commands sharing one are kept together within a layer
+ *
+ * @return RenderCommand* the command for the caller to fill in, NULL if the frame is full
+ */
+RenderCommand* renderPush (RenderFrame *frame, RenderLayer layer, RenderCommandType type, int texture)
+{
+  if ((*frame).count == RENDER_MAX_COMMANDS)
+  {
+    ++(*frame).dropped;
+    return NULL;
+  }
+
+  RenderCommand *command = &(*frame).commands[(*frame).count];
+  memset(command, 0, sizeof(*command));
+  (*command).key = ((Uint32) layer << 24) | ((Uint32) (texture & 0xFF) << 16) | (Uint32) (*frame).count;
+  (*command).type = (Uint8) type;
+  (*command).texture = (Uint8) texture;
+  ++(*frame).count;
+  return command;
+}
+
+/**
+ * This function will add a sprite to a frame, placed by where its feet are
+ *
+ * sprites keep the order they were recorded in until the render thread's sprite batch sorts them by
+ * layer, y and texture, so their key holds the sprite layer where other commands have their texture
+ *
+ * @param frame the frame being recorded
+ * @param layer the sprite layer it is drawn in
+ * @param texture the texture the sprite is cut from
+ * @param src the part of the texture to draw
+ * @param anchorX the middle of the sprite's bottom edge on the screen
+ * @param anchorY the sprite's bottom edge on the screen
+ *
+ * @return bool false if the frame is full
+ */
+bool renderPushSprite (RenderFrame *frame, SpriteLayer layer, int texture, const SDL_Rect *src, int anchorX, int anchorY)
+{
+  RenderCommand *command = renderPush(frame, RENDER_LAYER_SPRITES, RENDER_CMD_SPRITE, (int) layer);
+  if (command == NULL)
+  {
+    return false;
+  }
+
+  (*command).texture = (Uint8) texture;
+  (*command).srcX = (Sint16) (*src).x;
+  (*command).srcY = (Sint16) (*src).y;
+  (*command).x = (Sint16) anchorX;
+  (*command).y = (Sint16) anchorY;
+  (*command).w = (Uint8) (*src).w;
+  (*command).h = (Uint8) (*src).h;
+  return true;
+}
+
+/**
+ * This function will hand the recorded frame to the render thread and take back the one it left, without locking
+ *
+ * when the render thread has not taken the last frame yet, it is replaced and becomes the next one recorded
+ *
+ * @param pipeline the pipeline to publish on
+ *
+ * @return void
+ */
+void renderPipelinePublish (RenderPipeline *pipeline)
+{
+  int previous = atomic_exchange_explicit(&(*pipeline).shared, (*pipeline).back | RENDER_FRAME_FRESH,
+                                          memory_order_acq_rel);
+  (*pipeline).back = previous & ~RENDER_FRAME_FRESH;
+
+  atomic_fetch_add_explicit(&(*pipeline).published, 1, memory_order_relaxed);
+  if (previous & RENDER_FRAME_FRESH)
+  {
+    atomic_fetch_add_explicit(&(*pipeline).replaced, 1, memory_order_relaxed);
+  }
+  SDL_SemPost((*pipeline).posted);
+}
+
+/**
+ * This function will take the newest published frame, only called from the render thread
+ *
+ * @param pipeline the pipeline to take from
+ * @param timeout the longest to wait for a frame, in milliseconds
+ *
+ * @return RenderFrame* the frame to draw, NULL if none was published in time
+ */
+RenderFrame* renderPipelineAcquire (RenderPipeline *pipeline, Uint32 timeout)
+{
+  // every frame is posted, so a frame replaced before it was taken leaves a post with nothing behind it
+  while (!(atomic_load_explicit(&(*pipeline).shared, memory_order_acquire) & RENDER_FRAME_FRESH))
+  {
+    if (SDL_SemWaitTimeout((*pipeline).posted, timeout) != 0)
+    {
+      return NULL;
+    }
+  }
+
+  int previous = atomic_exchange_explicit(&(*pipeline).shared, (*pipeline).front, memory_order_acq_rel);
+  (*pipeline).front = previous & ~RENDER_FRAME_FRESH;
+  return &(*pipeline).frames[(*pipeline).front];
+}
+
+/**
+ * This function will wait until the render thread has taken the last frame published, so none is replaced
+ *
+ * @param pipeline the pipeline to wait on
+ *
+ * @return void
+ */
+void renderPipelineWait (RenderPipeline *pipeline)
+{
+  while ((atomic_load_explicit(&(*pipeline).shared, memory_order_acquire) & RENDER_FRAME_FRESH)
+         && !atomic_load(&(*pipeline).stopped))
+  {
+    sched_yield();
+  }
+}
+
+/**
+ * This function will put a frame's commands in the order they are drawn
+ *
+ * commands are mostly recorded in layer order already, so an insertion sort does little work
+ *
+ * @param frame the frame to sort
+ *
+ * @return void
+ */
+void renderFrameSort (RenderFrame *frame)
+{
+  RenderCommand *commands = (*frame).commands;
+  for (int i = 1; i < (*frame).count; ++i)
+  {
+    RenderCommand command = commands[i];
+    int j = i - 1;
+    while (j >= 0 && commands[j].key > command.key)
+    {
+      commands[j + 1] = commands[j];
+      --j;
+    }
+    commands[j + 1] = command;
+  }
+}
+
+/**
+ * This function will ask the render thread to finish and wait for it
+ *
+ * @param pipeline the pipeline whose thread should stop
+ *
+ * @return void
+ */
+void renderPipelineStop (RenderPipeline *pipeline)
+{
+  atomic_store(&(*pipeline).stopping, true);
+  SDL_SemPost((*pipeline).posted);
+  pthread_join((*pipeline).thread, NULL);
+}
+
+/**
+ * This function will print how many frames were handed over since the last report and start a new one
+ *
+ * @param pipeline the pipeline to report on
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void renderPipelinePrintReport (RenderPipeline *pipeline, FILE *out)
+{
+  int published = atomic_exchange(&(*pipeline).published, 0);
+  int replaced = atomic_exchange(&(*pipeline).replaced, 0);
+  fprintf(out, "PIPELINE: %d frames recorded, %d drawn, %d replaced before drawing\n",
+          published, published - replaced, replaced);
+}
+
+/**
+ * This function will free the frames and the semaphore, the render thread must have stopped
+ *
+ * @param pipeline the pipeline to free
+ *
+ * @return void
+ */
+void renderPipelineDestroy (RenderPipeline *pipeline)
+{
+  memFree(MEM_RENDER, (*pipeline).frames);
+  (*pipeline).frames = NULL;
+  if ((*pipeline).posted != NULL)
+  {
+    SDL_DestroySemaphore((*pipeline).posted);
+    (*pipeline).posted = NULL;
+  }
+}
@@ -0,0 +1,109 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <SDL.h>
+#include "game.h"
+#include "tiles.h"
+#include "spritebatch.h"
+
+#define RENDER_MAX_COMMANDS 4096 // commands one frame can hold, the rest are dropped
+#define RENDER_PIPELINE_FRAMES 3 // one being recorded, one being drawn, one waiting between them
+#define RENDER_FRAME_FRESH 4 // set on the shared frame index when the render thread has not taken it yet
+
+// what a command draws, the game records them and the render thread knows how to draw each
+typedef enum
+{
+  RENDER_CMD_MAP,      // the baked map of the frame
+  RENDER_CMD_SPRITE,   // part of a texture from src, standing with its feet at x, y
+  RENDER_CMD_LIGHTING, // the darkness, with the player's light at tile x, y
+  RENDER_CMD_MENU,     // the menu with item srcX selected, and the load error when srcY is set
+  RENDER_CMD_PARTICLES // the particles, stepped to the frame's time, with the player's feet at x, y
+} RenderCommandType;
+
+// the order commands are drawn in, before the texture and the order they were recorded
+typedef enum
+{
+  RENDER_LAYER_MAP,
+  RENDER_LAYER_SPRITES,
+  RENDER_LAYER_EFFECTS,
+  RENDER_LAYER_LIGHTING,
+  RENDER_LAYER_UI
+} RenderLayer;
+
+// what the player toggled that only changes how frames are drawn
+typedef struct
+{
+  bool overlay; // the render statistics overlay
+  bool capture; // recording
+  bool night; // the night palette
+} RenderToggles;
+
+// one thing to draw in 16 bytes, sorted by its key, a sprite's source is the same size as where it is drawn
+typedef struct
+{
+  Uint32 key; // layer, then texture (a sprite's own layer, the sprite batch orders the rest), then the order it was recorded
+  Uint8 type;
+  Uint8 texture;
+  Uint8 w, h;
+  Sint16 srcX, srcY;
+  Sint16 x, y;
+} RenderCommand;
+
+// everything the render thread needs for one frame, so it never reads the game while it changes
+typedef struct
+{
+  RenderCommand commands[RENDER_MAX_COMMANDS];
+  int count;
+  int dropped; // commands that did not fit
+  Uint32 sequence; // the tick the frame was recorded on
+  Uint32 time; // the game clock the frame shows
+  int scene; // the render statistics scene it is counted against
+  int map[MAP_ROWS][MAP_COLS];
+  int chooseMap;
+  int mapId; // changes whenever a different map is shown, each world chunk is a map of its own
+  int tileFrame[MAX_TILE_IDS]; // the texture each tile id is drawn with
+  RenderToggles toggles;
+  Uint64 pendingPress; // the key press this frame shows the result of, 0 for none
+  int inputDropped; // key events lost since the last frame
+} RenderFrame;
+
+// a lock-free triple buffer of frames, the game records while the render thread draws
+typedef struct
+{
+  RenderFrame *frames;
+  atomic_int shared; // the frame between the two threads, with RENDER_FRAME_FRESH while it is waiting
+  int back; // the frame the game records into, only the game thread touches it
+  int front; // the frame being drawn, only the render thread touches it
+  SDL_sem *posted; // posted for every frame published, so the render thread can sleep
+  atomic_bool loaded; // set by the render thread once its renderer and textures are ready
+  atomic_bool stopping; // set by the game thread when the render thread should finish
+  atomic_bool stopped; // set by the render thread when it has finished
+  atomic_int published, replaced; // frames handed over, and those replaced before being drawn
+  pthread_t thread;
+} RenderPipeline;
+
+// what the render thread is started with, it fills in the tile frame table while it loads
+typedef struct
+{
+  SDL_Window *window;
+  RenderPipeline *pipeline;
+  TileFrameTable tileFrames;
+} RenderThread;
+
+bool renderPipelineInit(RenderPipeline *pipeline);
+RenderFrame* renderPipelineBegin(RenderPipeline *pipeline);
+RenderCommand* renderPush(RenderFrame *frame, RenderLayer layer, RenderCommandType type, int texture);
+bool renderPushSprite(RenderFrame *frame, SpriteLayer layer, int texture, const SDL_Rect *src, int anchorX, int anchorY);
+void renderPipelinePublish(RenderPipeline *pipeline);
+RenderFrame* renderPipelineAcquire(RenderPipeline *pipeline, Uint32 timeout);
+void renderPipelineWait(RenderPipeline *pipeline);
+void renderFrameSort(RenderFrame *frame);
+void renderPipelineStop(RenderPipeline *pipeline);
+void renderPipelinePrintReport(RenderPipeline *pipeline, FILE *out);
+void renderPipelineDestroy(RenderPipeline *pipeline);
+
+#endif
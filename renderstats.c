@@ -0,0 +1,498 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renderstats.h"
+#include "sim.h"
+
+#define SCREEN_PIXELS ((Uint64) X_RESOLUTION * Y_RESOLUTION)
+
+// only the render thread draws, and it also loads the budgets and draws the overlay, so the counters need no lock
+static RenderFrameStats currentFrame;
+static RenderFrameStats lastFrame;
+static RenderSceneStats scenes[RENDER_SCENE_COUNT];
+static RenderBudget budgets[RENDER_SCENE_COUNT];
+static bool warned[RENDER_SCENE_COUNT];
+static int currentScene = RENDER_SCENE_MENU;
+static SDL_Texture *boundTexture = NULL;
+static int targetWidth = X_RESOLUTION, targetHeight = Y_RESOLUTION;
+static bool overlayVisible = false;
+
+// a generous default that a normal frame, or the frame a map is first baked, stays well inside
+static const RenderBudget defaultBudget = {256, 64, 6.0, 64 * 1024, 0.0};
+
+/**
+ * This function will return the name a scene is reported under
+ *
+ * @param scene the scene
+ *
+ * @return const char* the menu, or the map's name
+ */
+static const char* sceneName (int scene)
+{
+  return scene == RENDER_SCENE_MENU ? "menu" : mapNameOf(scene);
+}
+
+/**
+ * This function will find a scene from the name or number used in the budget file
+ *
+ * @param token the name or number
+ *
+ * @return int the scene, or -1 when there is no such scene
+ */
+static int sceneFromName (const char *token)
+{
+  for (int scene = 0; scene < RENDER_SCENE_COUNT; ++scene)
+  {
+    if (strcmp(token, sceneName(scene)) == 0)
+    {
+      return scene;
+    }
+  }
+
+  char *end;
+  long scene = strtol(token, &end, 10);
+  return *end == '\0' && scene >= 0 && scene < RENDER_SCENE_COUNT ? (int) scene : -1;
+}
+
+/**
+ * This function will reset the counters and read the per-scene budgets
+ *
+ * @param budgetPath the budget file
+ *
+ * @return void
+ */
+void renderStatsInit (const char *budgetPath)
+{
+  memset(&currentFrame, 0, sizeof(currentFrame));
+  memset(&lastFrame, 0, sizeof(lastFrame));
+  memset(scenes, 0, sizeof(scenes));
+  renderStatsLoadBudgets(budgetPath);
+}
+
+/**
+ * This function will read the per-scene budgets, keeping the counters, so the file can be reloaded while running
+ *
+ * Each line of the budget file is a scene (menu, a map name or its number) followed by its
+ * draw calls, texture binds, overdraw, upload bytes and present milliseconds, where 0 is no limit.
+ * The file is optional, every scene it does not mention keeps the default budget.
+ *
+ * @param budgetPath the budget file
+ *
+ * @return void
+ */
+void renderStatsLoadBudgets (const char *budgetPath)
+{
+  memset(warned, 0, sizeof(warned));
+  for (int scene = 0; scene < RENDER_SCENE_COUNT; ++scene)
+  {
+    budgets[scene] = defaultBudget;
+  }
+
+  FILE *file = fopen(budgetPath, "r");
+  if (file == NULL)
+  {
+    return;
+  }
+
+  char line[256];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    ++lineNumber;
+
+    char name[64];
+    RenderBudget budget;
+    unsigned long long uploadBytes;
+    if (line[0] == '#' || sscanf(line, "%63s", name) != 1)
+    {
+      continue;
+    }
+
+    int scene = sceneFromName(name);
+    if (scene < 0 || sscanf(line, "%*s %d %d %lf %llu %lf", &budget.drawCalls, &budget.textureBinds,
+                            &budget.overdraw, &uploadBytes, &budget.presentMs) != 5)
+    {
+      fprintf(stderr, "Invalid render budget on line %d of %s\n", lineNumber, budgetPath);
+      continue;
+    }
+    budget.uploadBytes = uploadBytes;
+    budgets[scene] = budget;
+  }
+
+  fclose(file);
+}
+
+/**
+ * This function will start counting a frame
+ *
+ * @param scene the menu, or the chooseMap number of the map being drawn
+ *
+ * @return void
+ */
+void renderStatsBeginFrame (int scene)
+{
+  memset(&currentFrame, 0, sizeof(currentFrame));
+  currentScene = scene >= 0 && scene < RENDER_SCENE_COUNT ? scene : RENDER_SCENE_MENU;
+  boundTexture = NULL;
+}
+
+/**
+ * This function will finish a frame, add it to its scene and check it against the scene's budget
+ *
+ * @return void
+ */
+void renderStatsEndFrame (void)
+{
+  RenderSceneStats *stats = &scenes[currentScene];
+  const RenderBudget *budget = &budgets[currentScene];
+  RenderFrameStats *frame = &currentFrame;
+
+  ++(*stats).frames;
+  (*stats).total.drawCalls += (*frame).drawCalls;
+  (*stats).total.textureBinds += (*frame).textureBinds;
+  (*stats).total.pixelsFilled += (*frame).pixelsFilled;
+  (*stats).total.uploadBytes += (*frame).uploadBytes;
+  (*stats).total.presentMs += (*frame).presentMs;
+  (*stats).worst.drawCalls = max((*stats).worst.drawCalls, (*frame).drawCalls);
+  (*stats).worst.textureBinds = max((*stats).worst.textureBinds, (*frame).textureBinds);
+  (*stats).worst.pixelsFilled = max((*stats).worst.pixelsFilled, (*frame).pixelsFilled);
+  (*stats).worst.uploadBytes = max((*stats).worst.uploadBytes, (*frame).uploadBytes);
+  (*stats).worst.presentMs = max((*stats).worst.presentMs, (*frame).presentMs);
+
+  double overdraw = (double) (*frame).pixelsFilled / SCREEN_PIXELS;
+  bool over = ((*budget).drawCalls > 0 && (*frame).drawCalls > (*budget).drawCalls)
+              || ((*budget).textureBinds > 0 && (*frame).textureBinds > (*budget).textureBinds)
+              || ((*budget).overdraw > 0 && overdraw > (*budget).overdraw)
+              || ((*budget).uploadBytes > 0 && (*frame).uploadBytes > (*budget).uploadBytes)
+              || ((*budget).presentMs > 0 && (*frame).presentMs > (*budget).presentMs);
+  if (over)
+  {
+    ++(*stats).framesOverBudget;
+
+    // say which scene went over once, the export has the totals
+    if (!warned[currentScene])
+    {
+      fprintf(stderr, "Render budget exceeded in %s: %d draws, %d binds, %.2fx overdraw, %llu bytes uploaded, %.2f ms present\n",
+              sceneName(currentScene), (*frame).drawCalls, (*frame).textureBinds, overdraw,
+              (unsigned long long) (*frame).uploadBytes, (*frame).presentMs);
+      warned[currentScene] = true;
+    }
+  }
+
+  lastFrame = currentFrame;
+}
+
+/**
+ * This function will return the counters of the last finished frame
+ *
+ * @return const RenderFrameStats* the last frame
+ */
+const RenderFrameStats* renderStatsLastFrame (void)
+{
+  return &lastFrame;
+}
+
+/**
+ * This function will check that no frame so far went over its scene's budget
+ *
+ * @return bool true when every frame was within budget
+ */
+bool renderStatsWithinBudget (void)
+{
+  for (int scene = 0; scene < RENDER_SCENE_COUNT; ++scene)
+  {
+    if (scenes[scene].framesOverBudget > 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * This function will show or hide the on-screen counters
+ *
+ * @return void
+ */
+void renderStatsToggleOverlay (void)
+{
+  overlayVisible = !overlayVisible;
+}
+
+/**
+ * This function will draw the last frame's counters in the top left corner when the overlay is shown
+ *
+ * The overlay's own draws are counted in the frame it is drawn in, like any other text.
+ *
+ * @param renderer the renderer
+ * @param text the text renderer
+ *
+ * @return void
+ */
+void renderStatsDrawOverlay (SDL_Renderer *renderer, TextRenderer *text)
+{
+  if (!overlayVisible)
+  {
+    return;
+  }
+
+  SDL_Color ink = {255, 255, 0, 255};
+  char line[64];
+  int y = 2;
+
+  snprintf(line, sizeof(line), "DRAWS %d BINDS %d", lastFrame.drawCalls, lastFrame.textureBinds);
+  textDraw(text, line, 2, y, 0, ink);
+  y += (*text).cellHeight + 1;
+  snprintf(line, sizeof(line), "OVERDRAW %.2f", (double) lastFrame.pixelsFilled / SCREEN_PIXELS);
+  textDraw(text, line, 2, y, 0, ink);
+  y += (*text).cellHeight + 1;
+  snprintf(line, sizeof(line), "UPLOAD %llu", (unsigned long long) lastFrame.uploadBytes);
+  textDraw(text, line, 2, y, 0, ink);
+  y += (*text).cellHeight + 1;
+  snprintf(line, sizeof(line), "PRESENT %.2f MS", lastFrame.presentMs);
+  textDraw(text, line, 2, y, 0, ink);
+
+  textFlush(text, renderer);
+}
+
+/**
+ * This function will print the average and worst frame of each scene that was drawn
+ *
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void renderStatsPrintReport (FILE *out)
+{
+  for (int scene = 0; scene < RENDER_SCENE_COUNT; ++scene)
+  {
+    const RenderSceneStats *stats = &scenes[scene];
+    if ((*stats).frames == 0)
+    {
+      continue;
+    }
+
+    fprintf(out, "RENDER %s: %d frames, %.1f draws (max %d), %.1f binds (max %d), %.2fx overdraw (max %.2fx), "
+            "%.0f bytes uploaded (max %llu), %d over budget\n",
+            sceneName(scene), (*stats).frames,
+            (double) (*stats).total.drawCalls / (*stats).frames, (*stats).worst.drawCalls,
+            (double) (*stats).total.textureBinds / (*stats).frames, (*stats).worst.textureBinds,
+            (double) (*stats).total.pixelsFilled / (*stats).frames / SCREEN_PIXELS,
+            (double) (*stats).worst.pixelsFilled / SCREEN_PIXELS,
+            (double) (*stats).total.uploadBytes / (*stats).frames, (unsigned long long) (*stats).worst.uploadBytes,
+            (*stats).framesOverBudget);
+  }
+}
+
+/**
+ * This function will write every scene's averages, worst frames and budgets as JSON
+ *
+ * @param path the file to write
+ *
+ * @return bool true when the file was written
+ */
+bool renderStatsExport (const char *path)
+{
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Could not write render stats to %s\n", path);
+    return false;
+  }
+
+  fprintf(file, "{\n  \"withinBudget\": %s,\n  \"scenes\": [", renderStatsWithinBudget() ? "true" : "false");
+  bool first = true;
+  for (int scene = 0; scene < RENDER_SCENE_COUNT; ++scene)
+  {
+    const RenderSceneStats *stats = &scenes[scene];
+    const RenderBudget *budget = &budgets[scene];
+    if ((*stats).frames == 0)
+    {
+      continue;
+    }
+
+    double frames = (*stats).frames;
+    fprintf(file, "%s\n    {\n      \"scene\": \"%s\",\n      \"frames\": %d,\n      \"framesOverBudget\": %d,\n",
+            first ? "" : ",", sceneName(scene), (*stats).frames, (*stats).framesOverBudget);
+    fprintf(file, "      \"drawCalls\": {\"avg\": %.2f, \"max\": %d, \"budget\": %d},\n",
+            (*stats).total.drawCalls / frames, (*stats).worst.drawCalls, (*budget).drawCalls);
+    fprintf(file, "      \"textureBinds\": {\"avg\": %.2f, \"max\": %d, \"budget\": %d},\n",
+            (*stats).total.textureBinds / frames, (*stats).worst.textureBinds, (*budget).textureBinds);
+    fprintf(file, "      \"overdraw\": {\"avg\": %.3f, \"max\": %.3f, \"budget\": %.3f},\n",
+            (*stats).total.pixelsFilled / frames / SCREEN_PIXELS, (double) (*stats).worst.pixelsFilled / SCREEN_PIXELS,
+            (*budget).overdraw);
+    fprintf(file, "      \"uploadBytes\": {\"avg\": %.1f, \"max\": %llu, \"budget\": %llu},\n",
+            (*stats).total.uploadBytes / frames, (unsigned long long) (*stats).worst.uploadBytes,
+            (unsigned long long) (*budget).uploadBytes);
+    fprintf(file, "      \"presentMs\": {\"avg\": %.3f, \"max\": %.3f, \"budget\": %.3f}\n    }",
+            (*stats).total.presentMs / frames, (*stats).worst.presentMs, (*budget).presentMs);
+    first = false;
+  }
+  fprintf(file, "\n  ]\n}\n");
+
+  fclose(file);
+  return true;
+}
+
+/**
+ * This function will count one draw into the current target
+ *
+ * @param texture the texture drawn with, NULL for a plain fill
+ * @param pixels the destination pixels it covers
+ *
+ * @return void
+ */
+static void countDraw (SDL_Texture *texture, Uint64 pixels)
+{
+  ++currentFrame.drawCalls;
+  currentFrame.pixelsFilled += pixels;
+  if (texture != NULL && texture != boundTexture)
+  {
+    ++currentFrame.textureBinds;
+    boundTexture = texture;
+  }
+}
+
+/**
+ * This function will return the pixels a rectangle covers, the whole target when there is none
+ *
+ * @param rect the rectangle, or NULL
+ *
+ * @return Uint64 the area
+ */
+static Uint64 rectPixels (const SDL_Rect *rect)
+{
+  return rect != NULL ? (Uint64) max(rect->w, 0) * max(rect->h, 0) : (Uint64) targetWidth * targetHeight;
+}
+
+/**
+ * This function will copy a texture and count it
+ *
+ * @param renderer the renderer
+ * @param texture the texture
+ * @param srcRect the part of the texture, NULL for all of it
+ * @param destRect where it goes, NULL for the whole target
+ *
+ * @return int what SDL_RenderCopy returned
+ */
+int renderCopy (SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Rect *srcRect, const SDL_Rect *destRect)
+{
+  countDraw(texture, rectPixels(destRect));
+  return SDL_RenderCopy(renderer, texture, srcRect, destRect);
+}
+
+/**
+ * This function will submit triangles and count them, the fill is the area of every triangle
+ *
+ * @param renderer the renderer
+ * @param texture the texture, or NULL
+ * @param vertices the vertices
+ * @param vertexCount the number of vertices
+ * @param indices the triangle indices, or NULL for consecutive vertices
+ * @param indexCount the number of indices
+ *
+ * @return int what SDL_RenderGeometry returned
+ */
+int renderGeometry (SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Vertex *vertices, int vertexCount,
+                    const int *indices, int indexCount)
+{
+  int count = indices != NULL ? indexCount : vertexCount;
+  double area = 0;
+  for (int i = 0; i + 2 < count; i += 3)
+  {
+    const SDL_FPoint *a = &vertices[indices != NULL ? indices[i] : i].position;
+    const SDL_FPoint *b = &vertices[indices != NULL ? indices[i + 1] : i + 1].position;
+    const SDL_FPoint *c = &vertices[indices != NULL ? indices[i + 2] : i + 2].position;
+    double twice = (b->x - a->x) * (c->y - a->y) - (c->x - a->x) * (b->y - a->y);
+    area += (twice < 0 ? -twice : twice) / 2;
+  }
+
+  countDraw(texture, (Uint64) area);
+  return SDL_RenderGeometry(renderer, texture, vertices, vertexCount, indices, indexCount);
+}
+
+/**
+ * This function will fill a rectangle with the draw color and count it
+ *
+ * @param renderer the renderer
+ * @param rect the rectangle, NULL for the whole target
+ *
+ * @return int what SDL_RenderFillRect returned
+ */
+int renderFillRect (SDL_Renderer *renderer, const SDL_Rect *rect)
+{
+  countDraw(NULL, rectPixels(rect));
+  return SDL_RenderFillRect(renderer, rect);
+}
+
+/**
+ * This function will clear the target and count it
+ *
+ * @param renderer the renderer
+ *
+ * @return int what SDL_RenderClear returned
+ */
+int renderClear (SDL_Renderer *renderer)
+{
+  countDraw(NULL, rectPixels(NULL));
+  return SDL_RenderClear(renderer);
+}
+
+/**
+ * This function will switch the render target, so fills of the whole target use its size
+ *
+ * @param renderer the renderer
+ * @param texture the target texture, NULL for the screen
+ *
+ * @return int what SDL_SetRenderTarget returned
+ */
+int renderSetTarget (SDL_Renderer *renderer, SDL_Texture *texture)
+{
+  targetWidth = X_RESOLUTION;
+  targetHeight = Y_RESOLUTION;
+  if (texture != NULL)
+  {
+    SDL_QueryTexture(texture, NULL, NULL, &targetWidth, &targetHeight);
+  }
+  return SDL_SetRenderTarget(renderer, texture);
+}
+
+/**
+ * This function will upload pixels to a texture and count the bytes
+ *
+ * @param texture the texture
+ * @param rect the part to update, NULL for all of it
+ * @param pixels the pixels
+ * @param pitch the bytes per row of pixels
+ *
+ * @return int what SDL_UpdateTexture returned
+ */
+int renderUpdateTexture (SDL_Texture *texture, const SDL_Rect *rect, const void *pixels, int pitch)
+{
+  int height = 0;
+  if (rect != NULL)
+  {
+    height = rect->h;
+  }
+  else
+  {
+    SDL_QueryTexture(texture, NULL, NULL, NULL, &height);
+  }
+  currentFrame.uploadBytes += (Uint64) max(height, 0) * max(pitch, 0);
+  return SDL_UpdateTexture(texture, rect, pixels, pitch);
+}
+
+/**
+ * This function will present the frame and time it
+ *
+ * @param renderer the renderer
+ *
+ * @return void
+ */
+void renderPresent (SDL_Renderer *renderer)
+{
+  Uint64 start = SDL_GetPerformanceCounter();
+  SDL_RenderPresent(renderer);
+  currentFrame.presentMs += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
@@ -0,0 +1,65 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL.h>
+#include "game.h"
+#include "text.h"
+
+#define RENDER_SCENE_COUNT 4 // the menu, then the three maps by their chooseMap number
+#define RENDER_SCENE_MENU 0
+#define RENDER_STATS_PATH "render_stats.json"
+#define RENDER_BUDGETS_PATH "assets/data/render_budgets.txt"
+
+// what the draw path did in one frame
+typedef struct
+{
+  int drawCalls; // copies, fills, clears and geometry submissions
+  int textureBinds; // draws whose texture differs from the one before
+  Uint64 pixelsFilled; // destination pixels touched, overdraw is this over the screen size
+  Uint64 uploadBytes; // bytes sent to textures
+  double presentMs; // time spent in SDL_RenderPresent
+} RenderFrameStats;
+
+// the most a scene may cost in one frame, 0 for no limit
+typedef struct
+{
+  int drawCalls;
+  int textureBinds;
+  double overdraw;
+  Uint64 uploadBytes;
+  double presentMs;
+} RenderBudget;
+
+// the frames drawn in one scene
+typedef struct
+{
+  int frames;
+  RenderFrameStats total;
+  RenderFrameStats worst;
+  int framesOverBudget;
+} RenderSceneStats;
+
+void renderStatsInit(const char *budgetPath);
+void renderStatsLoadBudgets(const char *budgetPath);
+void renderStatsBeginFrame(int scene);
+void renderStatsEndFrame(void);
+const RenderFrameStats* renderStatsLastFrame(void);
+bool renderStatsWithinBudget(void);
+void renderStatsToggleOverlay(void);
+void renderStatsDrawOverlay(SDL_Renderer *renderer, TextRenderer *text);
+void renderStatsPrintReport(FILE *out);
+bool renderStatsExport(const char *path);
+
+// the draw path goes through these so every call is counted
+int renderCopy(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Rect *srcRect, const SDL_Rect *destRect);
+int renderGeometry(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Vertex *vertices, int vertexCount,
+                   const int *indices, int indexCount);
+int renderFillRect(SDL_Renderer *renderer, const SDL_Rect *rect);
+int renderClear(SDL_Renderer *renderer);
+int renderSetTarget(SDL_Renderer *renderer, SDL_Texture *texture);
+int renderUpdateTexture(SDL_Texture *texture, const SDL_Rect *rect, const void *pixels, int pitch);
+void renderPresent(SDL_Renderer *renderer);
+
+#endif
@@ -0,0 +1,917 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "script.h"
+
+// GCC and Clang can jump straight from one instruction's handler to the next, skipping the switch
+#if defined(__GNUC__) && !defined(SCRIPT_NO_COMPUTED_GOTO)
+#define SCRIPT_COMPUTED_GOTO
+#endif
+
+// instruction fields
+#define OPCODE(i) ((i) & 0xff)
+#define ARG_A(i) (((i) >> 8) & 0xff)
+#define ARG_B(i) (((i) >> 16) & 0xff)
+#define ARG_C(i) ((i) >> 24)
+#define ARG_BX(i) ((i) >> 16)
+#define ARG_SBX(i) ((Sint32) ARG_BX(i) - 32768)
+#define ENCODE(op, a, b, c) ((Uint32) (op) | (Uint32) (a) << 8 | (Uint32) (b) << 16 | (Uint32) (c) << 24)
+#define ENCODE_BX(op, a, bx) ((Uint32) (op) | (Uint32) (a) << 8 | (Uint32) (bx) << 16)
+
+#define SCRIPT_MAX_TOKENS 8
+
+// the routine the script benchmark runs on every actor, a patrol that paces and pauses
+static const char *benchmarkSource =
+  "actor patrol\n"
+  "  set r0 r7 % 5\n"
+  "  while 1\n"
+  "    set r1 r0 % 8\n"
+  "    if r1 < 4\n"
+  "      set r2 r2 + 1\n"
+  "    else\n"
+  "      set r2 r2 - 1\n"
+  "    end\n"
+  "    set r0 r0 + 1\n"
+  "    if r1 == 7\n"
+  "      wait 3\n"
+  "    else\n"
+  "      yield\n"
+  "    end\n"
+  "  end\n"
+  "end\n";
+
+// an open if, else or while block waiting for its jumps to be filled in
+typedef struct
+{
+  enum { BLOCK_IF, BLOCK_ELSE, BLOCK_WHILE } kind;
+  int start; // the loop condition, for while
+  int jump; // the jump to patch once the block's end is known
+} ScriptBlock;
+
+// the compiler's state while it walks a source file
+typedef struct
+{
+  ScriptLibrary *library;
+  const char *sourceName;
+  int line;
+  bool inProgram;
+  ScriptBlock blocks[SCRIPT_MAX_DEPTH];
+  int depth;
+  int nextTemp;
+  bool failed;
+} ScriptCompiler;
+
+/**
+ * This function will report a compile error with its line number
+ *
+ * @param compiler the compiler
+ * @param message what went wrong
+ *
+ * @return void
+ */
+static void compileError (ScriptCompiler *compiler, const char *message)
+{
+  fprintf(stderr, "%s:%d: %s\n", (*compiler).sourceName, (*compiler).line, message);
+  (*compiler).failed = true;
+}
+
+/**
+ * This function will append an instruction to the library
+ *
+ * @param compiler the compiler
+ * @param instruction the encoded instruction
+ *
+ * @return int the instruction's index
+ */
+static int emit (ScriptCompiler *compiler, Uint32 instruction)
+{
+  ScriptLibrary *library = (*compiler).library;
+  if ((*library).codeSize == SCRIPT_MAX_CODE)
+  {
+    compileError(compiler, "script code is too long");
+    return 0;
+  }
+  (*library).code[(*library).codeSize] = instruction;
+  return (*library).codeSize++;
+}
+
+/**
+ * This function will point an already emitted jump at a target
+ *
+ * @param compiler the compiler
+ * @param jump the jump instruction
+ * @param target where it should go
+ *
+ * @return void
+ */
+static void patchJump (ScriptCompiler *compiler, int jump, int target)
+{
+  Uint32 *instruction = &(*(*compiler).library).code[jump];
+  *instruction = ENCODE_BX(OPCODE(*instruction), ARG_A(*instruction), target);
+}
+
+/**
+ * This function will find a game variable by name
+ *
+ * @param token the name
+ *
+ * @return int the variable, or -1 if there is none
+ */
+static int variableOf (const char *token)
+{
+  static const char *names[VAR_COUNT] = {"x", "y", "map", "music", "dir", "tick"};
+  for (int i = 0; i < VAR_COUNT; ++i)
+  {
+    if (strcmp(token, names[i]) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * This function will parse a user register name, r0 to r7
+ *
+ * @param token the name
+ *
+ * @return int the register, or -1 if the token is not one
+ */
+static int registerOf (const char *token)
+{
+  if (token[0] == 'r' && token[1] >= '0' && token[1] < '0' + SCRIPT_USER_REGISTERS && token[2] == '\0')
+  {
+    return token[1] - '0';
+  }
+  return -1;
+}
+
+/**
+ * This function will get an operand into a register, loading numbers and variables into a temporary
+ *
+ * @param compiler the compiler
+ * @param token the operand
+ *
+ * @return int the register holding the operand
+ */
+static int compileOperand (ScriptCompiler *compiler, const char *token)
+{
+  int reg = registerOf(token);
+  if (reg >= 0)
+  {
+    return reg;
+  }
+
+  if ((*compiler).nextTemp == SCRIPT_REGISTERS)
+  {
+    compileError(compiler, "expression is too complex");
+    return 0;
+  }
+  int temp = (*compiler).nextTemp++;
+
+  int variable = variableOf(token);
+  if (variable >= 0)
+  {
+    emit(compiler, ENCODE(OP_GETVAR, temp, variable, 0));
+    return temp;
+  }
+
+  char *end;
+  long value = strtol(token, &end, 10);
+  if (*end != '\0' || end == token)
+  {
+    compileError(compiler, "expected a number, register or variable");
+    return 0;
+  }
+
+  // small numbers fit in the instruction, the rest go to the constant table
+  if (value >= -32768 && value <= 32767)
+  {
+    emit(compiler, ENCODE_BX(OP_LOADI, temp, value + 32768));
+  }
+  else
+  {
+    ScriptLibrary *library = (*compiler).library;
+    if ((*library).constantCount == SCRIPT_MAX_CONSTANTS)
+    {
+      compileError(compiler, "too many constants");
+      return 0;
+    }
+    (*library).constants[(*library).constantCount] = (Sint32) value;
+    emit(compiler, ENCODE_BX(OP_LOADK, temp, (*library).constantCount++));
+  }
+  return temp;
+}
+
+/**
+ * This function will compile "a" or "a op b" into one register
+ *
+ * @param compiler the compiler
+ * @param tokens the expression's tokens
+ * @param count the number of tokens, 1 or 3
+ * @param target the register to write, or -1 to use any register
+ *
+ * @return int the register holding the result
+ */
+static int compileExpression (ScriptCompiler *compiler, char **tokens, int count, int target)
+{
+  static const struct { const char *name; ScriptOp op; bool swap; } operators[] =
+  {
+    {"+", OP_ADD, false}, {"-", OP_SUB, false}, {"*", OP_MUL, false}, {"/", OP_DIV, false}, {"%", OP_MOD, false},
+    {"==", OP_EQ, false}, {"!=", OP_NE, false}, {"<", OP_LT, false}, {"<=", OP_LE, false},
+    {">", OP_LT, true}, {">=", OP_LE, true},
+  };
+
+  if (count == 1)
+  {
+    int reg = compileOperand(compiler, tokens[0]);
+    if (target >= 0 && target != reg)
+    {
+      emit(compiler, ENCODE(OP_MOVE, target, reg, 0));
+      return target;
+    }
+    return reg;
+  }
+
+  if (count != 3)
+  {
+    compileError(compiler, "expected a value or \"value operator value\"");
+    return 0;
+  }
+
+  for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i)
+  {
+    if (strcmp(tokens[1], operators[i].name) == 0)
+    {
+      int left = compileOperand(compiler, tokens[0]);
+      int right = compileOperand(compiler, tokens[2]);
+      if (target < 0)
+      {
+        target = (*compiler).nextTemp < SCRIPT_REGISTERS ? (*compiler).nextTemp++ : left;
+      }
+      emit(compiler, operators[i].swap ? ENCODE(operators[i].op, target, right, left)
+                                       : ENCODE(operators[i].op, target, left, right));
+      return target;
+    }
+  }
+
+  compileError(compiler, "unknown operator");
+  return 0;
+}
+
+/**
+ * This function will split a line into whitespace separated tokens, stopping at a comment
+ *
+ * @param line the line, modified in place
+ * @param tokens the tokens found
+ *
+ * @return int the number of tokens, -1 if there were too many
+ */
+static int splitTokens (char *line, char **tokens)
+{
+  int count = 0;
+  char *cursor = line;
+
+  while (*cursor != '\0')
+  {
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n')
+    {
+      ++cursor;
+    }
+    if (*cursor == '\0' || *cursor == '#')
+    {
+      break;
+    }
+    if (count == SCRIPT_MAX_TOKENS)
+    {
+      return -1;
+    }
+
+    tokens[count++] = cursor;
+    while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '\n')
+    {
+      ++cursor;
+    }
+    if (*cursor != '\0')
+    {
+      *cursor++ = '\0';
+    }
+  }
+
+  return count;
+}
+
+/**
+ * This function will start a new program, a trigger or an actor
+ *
+ * @param compiler the compiler
+ * @param tokens the header line
+ * @param count the number of tokens
+ *
+ * @return void
+ */
+static void compileHeader (ScriptCompiler *compiler, char **tokens, int count)
+{
+  static const char *directions[INPUT_DIRECTION_COUNT] = {"up", "left", "down", "right"};
+  ScriptLibrary *library = (*compiler).library;
+
+  if ((*library).programCount == SCRIPT_MAX_PROGRAMS)
+  {
+    compileError(compiler, "too many scripts");
+    return;
+  }
+
+  ScriptProgram *program = &(*library).programs[(*library).programCount];
+  memset(program, 0, sizeof(*program));
+  (*program).entry = (Uint16) (*library).codeSize;
+
+  if (strcmp(tokens[0], "trigger") == 0)
+  {
+    // trigger <tile> <direction>, run when the player leaves that tile in that direction
+    int tile = count == 3 ? atoi(tokens[1]) : -1;
+    int direction = -1;
+    for (int i = 0; i < INPUT_DIRECTION_COUNT && count == 3; ++i)
+    {
+      direction = strcmp(tokens[2], directions[i]) == 0 ? i : direction;
+    }
+    if (tile < 0 || tile >= MAX_TILE_IDS || direction < 0)
+    {
+      compileError(compiler, "expected \"trigger <tile> <up|left|down|right>\"");
+      return;
+    }
+
+    (*program).kind = SCRIPT_TRIGGER;
+    snprintf((*program).name, sizeof((*program).name), "trigger %d %s", tile, directions[direction]);
+    (*library).triggers[tile][direction] = (Sint8) (*library).programCount;
+  }
+  else
+  {
+    // actor <name>, a routine that runs alongside the game
+    if (count != 2)
+    {
+      compileError(compiler, "expected \"actor <name>\"");
+      return;
+    }
+    (*program).kind = SCRIPT_ACTOR;
+    snprintf((*program).name, sizeof((*program).name), "%s", tokens[1]);
+  }
+
+  ++(*library).programCount;
+  (*compiler).inProgram = true;
+}
+
+/**
+ * This function will compile one statement inside a program
+ *
+ * @param compiler the compiler
+ * @param tokens the statement's tokens
+ * @param count the number of tokens
+ *
+ * @return void
+ */
+static void compileStatement (ScriptCompiler *compiler, char **tokens, int count)
+{
+  const char *keyword = tokens[0];
+
+  if (strcmp(keyword, "set") == 0)
+  {
+    int target = count >= 3 ? registerOf(tokens[1]) : -1;
+    if (target < 0)
+    {
+      compileError(compiler, "expected \"set <r0-r7> <expression>\"");
+      return;
+    }
+    compileExpression(compiler, tokens + 2, count - 2, target);
+  }
+  else if (strcmp(keyword, "if") == 0 || strcmp(keyword, "while") == 0)
+  {
+    if ((*compiler).depth == SCRIPT_MAX_DEPTH)
+    {
+      compileError(compiler, "blocks are nested too deeply");
+      return;
+    }
+
+    ScriptBlock *block = &(*compiler).blocks[(*compiler).depth++];
+    (*block).kind = keyword[0] == 'i' ? BLOCK_IF : BLOCK_WHILE;
+    (*block).start = (*(*compiler).library).codeSize;
+    int condition = compileExpression(compiler, tokens + 1, count - 1, -1);
+    (*block).jump = emit(compiler, ENCODE_BX(OP_JMPF, condition, 0));
+  }
+  else if (strcmp(keyword, "else") == 0)
+  {
+    ScriptBlock *block = (*compiler).depth > 0 ? &(*compiler).blocks[(*compiler).depth - 1] : NULL;
+    if (block == NULL || (*block).kind != BLOCK_IF)
+    {
+      compileError(compiler, "else without if");
+      return;
+    }
+
+    // the true branch jumps over the else branch, the condition's jump lands here
+    int skip = emit(compiler, ENCODE_BX(OP_JMP, 0, 0));
+    patchJump(compiler, (*block).jump, (*(*compiler).library).codeSize);
+    (*block).kind = BLOCK_ELSE;
+    (*block).jump = skip;
+  }
+  else if (strcmp(keyword, "end") == 0)
+  {
+    if ((*compiler).depth == 0)
+    {
+      // the end of the program itself
+      emit(compiler, ENCODE(OP_END, 0, 0, 0));
+      (*compiler).inProgram = false;
+      return;
+    }
+
+    ScriptBlock *block = &(*compiler).blocks[--(*compiler).depth];
+    if ((*block).kind == BLOCK_WHILE)
+    {
+      emit(compiler, ENCODE_BX(OP_JMP, 0, (*block).start));
+    }
+    patchJump(compiler, (*block).jump, (*(*compiler).library).codeSize);
+  }
+  else if (strcmp(keyword, "warp") == 0 && count == 4)
+  {
+    int map = compileOperand(compiler, tokens[1]);
+    int x = compileOperand(compiler, tokens[2]);
+    int y = compileOperand(compiler, tokens[3]);
+    emit(compiler, ENCODE(OP_WARP, map, x, y));
+  }
+  else if (strcmp(keyword, "music") == 0 && count == 2)
+  {
+    emit(compiler, ENCODE(OP_MUSIC, compileOperand(compiler, tokens[1]), 0, 0));
+  }
+  else if (strcmp(keyword, "wait") == 0 && count == 2)
+  {
+    emit(compiler, ENCODE(OP_WAIT, compileOperand(compiler, tokens[1]), 0, 0));
+  }
+  else if (strcmp(keyword, "yield") == 0 && count == 1)
+  {
+    emit(compiler, ENCODE(OP_YIELD, 0, 0, 0));
+  }
+  else if (strcmp(keyword, "stop") == 0 && count == 1)
+  {
+    emit(compiler, ENCODE(OP_END, 0, 0, 0));
+  }
+  else
+  {
+    compileError(compiler, "unknown statement");
+  }
+}
+
+/**
+ * This function will compile script source into a library, replacing whatever it held
+ *
+ * The source is a list of programs. "trigger <tile> <up|left|down|right>" runs when the player leaves
+ * that tile in that direction, "actor <name>" is a routine that runs alongside the game. Each is ended
+ * by "end". Statements are "set <reg> <a> [op b]", "if <a> [cmp b]", "else", "while <a> [cmp b]",
+ * "end", "warp <map> <x> <y>", "music <track>", "wait <ticks>", "yield" and "stop". Values are numbers,
+ * the registers r0-r7, or the game variables x, y, map, music, dir and tick. '#' starts a comment.
+ *
+ * @param library the library to compile into
+ * @param source the script source
+ * @param sourceName the name used in error messages
+ *
+ * @return bool whether everything compiled, the library is left empty if not
+ */
+bool scriptCompile (ScriptLibrary *library, const char *source, const char *sourceName)
+{
+  memset(library, 0, sizeof(*library));
+  memset((*library).triggers, -1, sizeof((*library).triggers));
+
+  ScriptCompiler compiler = {0};
+  compiler.library = library;
+  compiler.sourceName = sourceName;
+
+  const char *cursor = source;
+  while (*cursor != '\0' && !compiler.failed)
+  {
+    // copy out one line so it can be split in place
+    char line[256];
+    size_t length = strcspn(cursor, "\n");
+    if (length >= sizeof(line))
+    {
+      ++compiler.line;
+      compileError(&compiler, "line is too long");
+      break;
+    }
+    memcpy(line, cursor, length);
+    line[length] = '\0';
+    cursor += length + (cursor[length] == '\n' ? 1 : 0);
+    ++compiler.line;
+
+    char *tokens[SCRIPT_MAX_TOKENS];
+    int count = splitTokens(line, tokens);
+    if (count < 0)
+    {
+      compileError(&compiler, "too many words on one line");
+      break;
+    }
+    if (count == 0)
+    {
+      continue;
+    }
+
+    // temporaries only live for one statement
+    compiler.nextTemp = SCRIPT_USER_REGISTERS;
+
+    if (!compiler.inProgram)
+    {
+      if (strcmp(tokens[0], "trigger") != 0 && strcmp(tokens[0], "actor") != 0)
+      {
+        compileError(&compiler, "expected \"trigger\" or \"actor\"");
+        break;
+      }
+      compileHeader(&compiler, tokens, count);
+    }
+    else
+    {
+      compileStatement(&compiler, tokens, count);
+    }
+  }
+
+  if (!compiler.failed && compiler.inProgram)
+  {
+    compileError(&compiler, "script is missing its end");
+  }
+  if (compiler.failed)
+  {
+    memset(library, 0, sizeof(*library));
+    memset((*library).triggers, -1, sizeof((*library).triggers));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * This function will compile a script file into a library
+ *
+ * @param library the library to compile into
+ * @param path the script file
+ *
+ * @return bool whether the file exists and compiled
+ */
+bool scriptLoadFile (ScriptLibrary *library, const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  char *source = size >= 0 ? memAlloc(MEM_GENERAL, (size_t) size + 1) : NULL;
+  if (source == NULL)
+  {
+    fclose(file);
+    return false;
+  }
+
+  size_t read = fread(source, 1, (size_t) size, file);
+  source[read] = '\0';
+  fclose(file);
+
+  bool compiled = scriptCompile(library, source, path);
+  memFree(MEM_GENERAL, source);
+  return compiled;
+}
+
+/**
+ * This function will find a program by name
+ *
+ * @param library the library
+ * @param name the program's name
+ *
+ * @return int the program, or -1 if there is none
+ */
+int scriptFind (const ScriptLibrary *library, const char *name)
+{
+  for (int i = 0; i < (*library).programCount; ++i)
+  {
+    if (strcmp((*library).programs[i].name, name) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * This function will set up a coroutine at the start of a program
+ *
+ * @param library the library
+ * @param program the program to run
+ * @param context the coroutine
+ *
+ * @return void
+ */
+void scriptStart (const ScriptLibrary *library, int program, ScriptContext *context)
+{
+  memset(context, 0, sizeof(*context));
+  (*context).pc = (*library).programs[program].entry;
+  (*context).status = SCRIPT_RUNNING;
+}
+
+/**
+ * This function will read a game variable for a script
+ *
+ * @param instance the game, or NULL for scripts that run without one
+ * @param variable the variable
+ * @param tick the current tick
+ *
+ * @return Sint32 the value
+ */
+static Sint32 readVariable (const GameInstance *instance, int variable, Uint32 tick)
+{
+  if (variable == VAR_TICK)
+  {
+    return (Sint32) tick;
+  }
+  if (instance == NULL)
+  {
+    return 0;
+  }
+
+  switch (variable)
+  {
+    case VAR_X:
+      return (*instance).player.x;
+    case VAR_Y:
+      return (*instance).player.y;
+    case VAR_MAP:
+      return (*instance).chooseMap;
+    case VAR_MUSIC:
+      return (*instance).musicSelector;
+    case VAR_DIR:
+      return (Sint32) (*instance).player.direction;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * This function will run a coroutine until it yields, waits or ends
+ *
+ * @param library the library the coroutine's program is in
+ * @param context the coroutine
+ * @param instance the game the script acts on, or NULL
+ * @param tick the current tick, waits are counted in ticks
+ *
+ * @return ScriptStatus what the coroutine is doing now
+ */
+ScriptStatus scriptResume (const ScriptLibrary *library, ScriptContext *context, GameInstance *instance, Uint32 tick)
+{
+  if ((*context).status == SCRIPT_DONE)
+  {
+    return SCRIPT_DONE;
+  }
+  if ((*context).status == SCRIPT_WAITING && (Sint32) (tick - (*context).wakeTick) < 0)
+  {
+    return SCRIPT_WAITING;
+  }
+
+  const Uint32 *code = (*library).code;
+  Sint32 *r = (*context).registers;
+  Uint32 pc = (*context).pc;
+  Uint32 instruction;
+  int budget = SCRIPT_STEP_BUDGET;
+
+#ifdef SCRIPT_COMPUTED_GOTO
+  static const void *dispatch[OP_COUNT] =
+  {
+    [OP_LOADI] = &&VM_OP_LOADI, [OP_LOADK] = &&VM_OP_LOADK, [OP_MOVE] = &&VM_OP_MOVE,
+    [OP_ADD] = &&VM_OP_ADD, [OP_SUB] = &&VM_OP_SUB, [OP_MUL] = &&VM_OP_MUL, [OP_DIV] = &&VM_OP_DIV,
+    [OP_MOD] = &&VM_OP_MOD, [OP_EQ] = &&VM_OP_EQ, [OP_NE] = &&VM_OP_NE, [OP_LT] = &&VM_OP_LT,
+    [OP_LE] = &&VM_OP_LE, [OP_JMP] = &&VM_OP_JMP, [OP_JMPF] = &&VM_OP_JMPF, [OP_GETVAR] = &&VM_OP_GETVAR,
+    [OP_WARP] = &&VM_OP_WARP, [OP_MUSIC] = &&VM_OP_MUSIC, [OP_WAIT] = &&VM_OP_WAIT,
+    [OP_YIELD] = &&VM_OP_YIELD, [OP_END] = &&VM_OP_END,
+  };
+#define VM_CASE(op) VM_##op:
+#define VM_NEXT() do { instruction = code[pc++]; goto *dispatch[OPCODE(instruction)]; } while (0)
+  VM_NEXT();
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT() continue
+  for (;;)
+  {
+    instruction = code[pc++];
+    switch (OPCODE(instruction))
+#endif
+    {
+      VM_CASE(OP_LOADI)
+        r[ARG_A(instruction)] = ARG_SBX(instruction);
+        VM_NEXT();
+      VM_CASE(OP_LOADK)
+        r[ARG_A(instruction)] = (*library).constants[ARG_BX(instruction)];
+        VM_NEXT();
+      VM_CASE(OP_MOVE)
+        r[ARG_A(instruction)] = r[ARG_B(instruction)];
+        VM_NEXT();
+      // arithmetic wraps like the hardware does instead of being undefined
+      VM_CASE(OP_ADD)
+        r[ARG_A(instruction)] = (Sint32) ((Uint32) r[ARG_B(instruction)] + (Uint32) r[ARG_C(instruction)]);
+        VM_NEXT();
+      VM_CASE(OP_SUB)
+        r[ARG_A(instruction)] = (Sint32) ((Uint32) r[ARG_B(instruction)] - (Uint32) r[ARG_C(instruction)]);
+        VM_NEXT();
+      VM_CASE(OP_MUL)
+        r[ARG_A(instruction)] = (Sint32) ((Uint32) r[ARG_B(instruction)] * (Uint32) r[ARG_C(instruction)]);
+        VM_NEXT();
+      // dividing by zero gives zero, and the one quotient that does not fit wraps
+      VM_CASE(OP_DIV)
+      {
+        Sint32 divisor = r[ARG_C(instruction)];
+        if (divisor == 0)
+        {
+          r[ARG_A(instruction)] = 0;
+        }
+        else if (divisor == -1)
+        {
+          r[ARG_A(instruction)] = (Sint32) (0u - (Uint32) r[ARG_B(instruction)]);
+        }
+        else
+        {
+          r[ARG_A(instruction)] = r[ARG_B(instruction)] / divisor;
+        }
+        VM_NEXT();
+      }
+      VM_CASE(OP_MOD)
+      {
+        Sint32 divisor = r[ARG_C(instruction)];
+        r[ARG_A(instruction)] = divisor == 0 || divisor == -1 ? 0 : r[ARG_B(instruction)] % divisor;
+        VM_NEXT();
+      }
+      VM_CASE(OP_EQ)
+        r[ARG_A(instruction)] = r[ARG_B(instruction)] == r[ARG_C(instruction)];
+        VM_NEXT();
+      VM_CASE(OP_NE)
+        r[ARG_A(instruction)] = r[ARG_B(instruction)] != r[ARG_C(instruction)];
+        VM_NEXT();
+      VM_CASE(OP_LT)
+        r[ARG_A(instruction)] = r[ARG_B(instruction)] < r[ARG_C(instruction)];
+        VM_NEXT();
+      VM_CASE(OP_LE)
+        r[ARG_A(instruction)] = r[ARG_B(instruction)] <= r[ARG_C(instruction)];
+        VM_NEXT();
+      VM_CASE(OP_JMP)
+      {
+        Uint32 target = ARG_BX(instruction);
+        // only loops jump backwards, so that is where a runaway script is cut off
+        if (target < pc && --budget == 0)
+        {
+          (*context).pc = (Uint16) target;
+          (*context).status = SCRIPT_WAITING;
+          (*context).wakeTick = tick + 1;
+          return SCRIPT_WAITING;
+        }
+        pc = target;
+        VM_NEXT();
+      }
+      VM_CASE(OP_JMPF)
+        if (r[ARG_A(instruction)] == 0)
+        {
+          pc = ARG_BX(instruction);
+        }
+        VM_NEXT();
+      VM_CASE(OP_GETVAR)
+        r[ARG_A(instruction)] = readVariable(instance, ARG_B(instruction), tick);
+        VM_NEXT();
+      VM_CASE(OP_WARP)
+      {
+        Sint32 map = r[ARG_A(instruction)];
+        if (instance != NULL && map >= 1 && map <= 3)
+        {
+          // the map ids match the map types, one apart
+          (*instance).chooseMap = map;
+          loadMap((*instance).map, (MapType) (map - 1));
+          (*instance).player.x = r[ARG_B(instruction)];
+          (*instance).player.y = r[ARG_C(instruction)];
+          (*context).flags |= SCRIPT_WARPED;
+        }
+        VM_NEXT();
+      }
+      VM_CASE(OP_MUSIC)
+        if (instance != NULL)
+        {
+          (*instance).musicSelector = r[ARG_A(instruction)];
+        }
+        VM_NEXT();
+      VM_CASE(OP_WAIT)
+        (*context).pc = (Uint16) pc;
+        (*context).status = SCRIPT_WAITING;
+        (*context).wakeTick = tick + (Uint32) max(r[ARG_A(instruction)], 1);
+        return SCRIPT_WAITING;
+      VM_CASE(OP_YIELD)
+        (*context).pc = (Uint16) pc;
+        (*context).status = SCRIPT_WAITING;
+        (*context).wakeTick = tick + 1;
+        return SCRIPT_WAITING;
+      VM_CASE(OP_END)
+        (*context).pc = (Uint16) (pc - 1);
+        (*context).status = SCRIPT_DONE;
+        return SCRIPT_DONE;
+#ifndef SCRIPT_COMPUTED_GOTO
+      default:
+        (*context).status = SCRIPT_DONE;
+        return SCRIPT_DONE;
+#endif
+    }
+#ifndef SCRIPT_COMPUTED_GOTO
+  }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+}
+
+/**
+ * This function will run the trigger for leaving a tile in a direction, if the map has one
+ *
+ * Triggers run to completion within the tick, a trigger that waits is simply cut short.
+ *
+ * @param library the library holding the triggers
+ * @param instance the game
+ * @param tile the tile the player is leaving
+ * @param direction the direction the player is leaving in
+ *
+ * @return bool whether the trigger moved the player to another map
+ */
+bool scriptRunTrigger (const ScriptLibrary *library, GameInstance *instance, int tile, InputDirection direction)
+{
+  if (tile < 0 || tile >= MAX_TILE_IDS || (*library).triggers[tile][direction] < 0)
+  {
+    return false;
+  }
+
+  ScriptContext context;
+  scriptStart(library, (*library).triggers[tile][direction], &context);
+  scriptResume(library, &context, instance, 0);
+  return (context.flags & SCRIPT_WARPED) != 0;
+}
+
+/**
+ * This function will run a scripted routine on many actors at once and report what a resume costs
+ *
+ * @param actorCount the number of actors
+ * @param ticks the number of ticks to run
+ *
+ * @return int the process exit status
+ */
+int runScriptBenchmark (int actorCount, int ticks)
+{
+  if (actorCount <= 0 || ticks <= 0)
+  {
+    fprintf(stderr, "Usage: ./game --script-bench <actors> [ticks]\n");
+    return EXIT_FAILURE;
+  }
+
+  static ScriptLibrary library;
+  ScriptContext *actors = memCalloc(MEM_GENERAL, (size_t) actorCount, sizeof(ScriptContext));
+  if (actors == NULL || !scriptCompile(&library, benchmarkSource, "benchmark"))
+  {
+    fprintf(stderr, "Script benchmark could not be set up!\n");
+    memFree(MEM_GENERAL, actors);
+    return EXIT_FAILURE;
+  }
+
+  int program = scriptFind(&library, "patrol");
+  for (int i = 0; i < actorCount; ++i)
+  {
+    scriptStart(&library, program, &actors[i]);
+    actors[i].registers[7] = i; // every actor starts at a different point of its routine
+  }
+
+  long long resumes = 0;
+  Uint64 start = SDL_GetPerformanceCounter();
+
+  for (Uint32 tick = 1; tick <= (Uint32) ticks; ++tick)
+  {
+    for (int i = 0; i < actorCount; ++i)
+    {
+      // a waiting actor costs only the wake check
+      if (actors[i].status != SCRIPT_WAITING || (Sint32) (tick - actors[i].wakeTick) >= 0)
+      {
+        scriptResume(&library, &actors[i], NULL, tick);
+        ++resumes;
+      }
+    }
+  }
+
+  double seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+  Uint64 checksum = 0;
+  for (int i = 0; i < actorCount; ++i)
+  {
+    checksum = checksum * 31 + (Uint32) actors[i].registers[0] * 7 + (Uint32) actors[i].registers[2];
+  }
+
+  printf("SCRIPT BENCH: %d actors x %d ticks in %.3f s, %.1f ns per resume, %.2f million resumes/s, %d bytes per coroutine, checksum %016llx\n",
+         actorCount, ticks, seconds, resumes > 0 ? seconds * 1e9 / resumes : 0.0, resumes / seconds / 1e6,
+         (int) sizeof(ScriptContext), (unsigned long long) checksum);
+
+  memFree(MEM_GENERAL, actors);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "game.h"
+#include "input.h"
+#include "sim.h"
+#include "tiles.h"
+
+#define SCRIPT_REGISTERS 16 // r0-r7 belong to the script, r8-r15 hold the compiler's temporaries
+#define SCRIPT_USER_REGISTERS 8
+#define SCRIPT_MAX_CODE 4096
+#define SCRIPT_MAX_CONSTANTS 256
+#define SCRIPT_MAX_PROGRAMS 64
+#define SCRIPT_MAX_DEPTH 16 // nested if and while blocks
+#define SCRIPT_STEP_BUDGET 4096 // loop iterations a script may run before it is made to yield
+#define TRIGGER_SCRIPT_PATH "assets/data/triggers.txt"
+
+// the instructions, each packed into 32 bits as op, a, b, c or op, a, bx
+typedef enum
+{
+  OP_LOADI, // a = signed 16 bit immediate
+  OP_LOADK, // a = constant bx
+  OP_MOVE, // a = b
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, // a = b op c
+  OP_EQ, OP_NE, OP_LT, OP_LE, // a = b cmp c, 1 or 0
+  OP_JMP, // pc = bx
+  OP_JMPF, // if a == 0 then pc = bx
+  OP_GETVAR, // a = game variable b
+  OP_WARP, // move the player to map a at x b, y c
+  OP_MUSIC, // play track a
+  OP_WAIT, // sleep for a ticks
+  OP_YIELD, // sleep until the next tick
+  OP_END,
+  OP_COUNT
+} ScriptOp;
+
+// game variables a script can read
+typedef enum { VAR_X, VAR_Y, VAR_MAP, VAR_MUSIC, VAR_DIR, VAR_TICK, VAR_COUNT } ScriptVariable;
+
+typedef enum { SCRIPT_TRIGGER, SCRIPT_ACTOR } ScriptKind;
+
+typedef enum { SCRIPT_RUNNING, SCRIPT_WAITING, SCRIPT_DONE } ScriptStatus;
+
+#define SCRIPT_WARPED 1 // context flag, the script moved the player to another map
+
+// one compiled script
+typedef struct
+{
+  char name[32];
+  ScriptKind kind;
+  Uint16 entry; // first instruction
+} ScriptProgram;
+
+// every compiled script, sharing one code and constant array
+typedef struct
+{
+  Uint32 code[SCRIPT_MAX_CODE];
+  int codeSize;
+  Sint32 constants[SCRIPT_MAX_CONSTANTS];
+  int constantCount;
+  ScriptProgram programs[SCRIPT_MAX_PROGRAMS];
+  int programCount;
+  Sint8 triggers[MAX_TILE_IDS][INPUT_DIRECTION_COUNT]; // program run when leaving a tile that way, -1 for none
+} ScriptLibrary;
+
+// a running script, a coroutine whose whole stack is its registers
+typedef struct
+{
+  Uint16 pc;
+  Uint8 status;
+  Uint8 flags;
+  Uint32 wakeTick;
+  Sint32 registers[SCRIPT_REGISTERS];
+} ScriptContext;
+
+bool scriptCompile(ScriptLibrary *library, const char *source, const char *sourceName);
+bool scriptLoadFile(ScriptLibrary *library, const char *path);
+int scriptFind(const ScriptLibrary *library, const char *name);
+void scriptStart(const ScriptLibrary *library, int program, ScriptContext *context);
+ScriptStatus scriptResume(const ScriptLibrary *library, ScriptContext *context, GameInstance *instance, Uint32 tick);
+bool scriptRunTrigger(const ScriptLibrary *library, GameInstance *instance, int tile, InputDirection direction);
+const ScriptLibrary* triggerScripts(void);
+void replaceTriggerScripts(const ScriptLibrary *library);
+int runScriptBenchmark(int actorCount, int ticks);
+
+#endif
@@ -0,0 +1,684 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h> // for mkdir
+#include <pthread.h>
+#include "tiles.h"
+#include "sim.h"
+#include "script.h"
+
+// the exit points between the maps, used when there is no trigger file to override them
+// x and y are where the player stood, the player walks in from just outside the new map's edge
+static const char *defaultTriggers =
+  "# 12 leads up from Perllert Town into the Village Ruins\n"
+  "trigger 12 up\n"
+  "  warp 3 x 144\n"
+  "  music 3\n"
+  "end\n"
+  "# 3 leads left from the Perkemern Center back to Perllert Town\n"
+  "trigger 3 left\n"
+  "  warp 1 168 y\n"
+  "  music 1\n"
+  "end\n"
+  "# 13 leads down from the Village Ruins back to Perllert Town\n"
+  "trigger 13 down\n"
+  "  warp 1 x -16\n"
+  "  music 1\n"
+  "end\n"
+  "# 2 leads right from Perllert Town into the Perkemern Center\n"
+  "trigger 2 right\n"
+  "  warp 2 -8 y\n"
+  "  music 2\n"
+  "end\n";
+
+// the trigger scripts every game shares, compiled once before the first game needs them
+static ScriptLibrary triggerLibrary;
+static pthread_once_t triggersCompiled = PTHREAD_ONCE_INIT;
+static const char *triggerPath = NULL;
+
+/**
+ * This function will load the map into the game
+ * 
+ * @param map the map that will be loaded
+ * @param mapType the type of map that will be loaded
+ */
+void loadMap(int map[MAP_ROWS][MAP_COLS], MapType mapType) 
+{
+  switch (mapType) 
+  {
+    case PERLLERT_TOWN: 
+    {
+      // Map layout for Perllert Town
+      int perllert_town_map[MAP_ROWS][MAP_COLS] = 
+      {
+        {1, 1, 1, 1, 1, 1, 1, 1, 12, 1}, // 1 represents a wall, 12 represents an exit point
+        {1, 0, 0, 0, 0, 0, 0, 0, 0,  1}, // 0 represents a walkable tile
+        {1, 0, 0, 0, 0, 1, 1, 0, 0,  1}, 
+        {1, 0, 0, 0, 0, 0, 1, 0, 0,  1}, 
+        {1, 0, 0, 0, 0, 0, 1, 0, 0,  1}, 
+        {1, 0, 1, 0, 0, 0, 1, 0, 0,  1}, 
+        {1, 0, 0, 0, 0, 0, 0, 0, 0,  2}, // 2 represents an exit point
+        {1, 0, 0, 0, 0, 0, 0, 0, 0,  2}, 
+        {1, 0, 0, 1, 1, 1, 1, 1, 1,  1}, 
+      };
+      memmove(map, perllert_town_map, sizeof(perllert_town_map));
+      break;
+    }
+    case PKRMN_CTR:
+    {
+      // Map layout for Perkemern Center
+      int pkrmrn_ctr_map[MAP_ROWS][MAP_COLS] = 
+      {
+        {9, 11, 11, 11, 9, 9, 11, 11, 11, 9}, 
+        {9, 5,  4,  5,  9, 9, 4,  5,  4,  9}, 
+        {8, 10, 10, 10, 8, 8, 10, 10, 10, 8}, 
+        {4, 5,  4,  5,  4, 5, 4,  5,  4,  5}, 
+        {6, 7,  6,  7,  6, 7, 6,  7,  6,  7}, 
+        {4, 5,  4,  5,  4, 5, 4,  5,  4,  5}, 
+        {3, 7,  6,  7,  6, 7, 6,  7,  6,  7}, // 3 represents exit point
+        {3, 5,  4,  5,  4, 5, 4,  5,  4,  5}, 
+        {6, 7,  6,  7,  6, 7, 6,  7,  6,  7}, 
+      };
+      memmove(map, pkrmrn_ctr_map, sizeof(pkrmrn_ctr_map));
+      break;
+    }
+    case VILLAGE_RUINS:
+    {
+      // Map layout for Village Ruins
+      int village_ruins_map[MAP_ROWS][MAP_COLS] = 
+      {
+        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}, 
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, // 13 represents exit point
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 
+        {1, 1, 1, 1, 1, 1, 1, 1, 13, 1}, 
+      };
+      memmove(map, village_ruins_map, sizeof(village_ruins_map));
+      break;
+    }
+  }
+}
+
+/**
+ * This function will get the name a map is saved under
+ * 
+ * @param chooseMap the map (1 perllert town, 2 perkemern center, 3 village ruins)
+ * 
+ * @return char* the map name
+ */
+char* mapNameOf (int chooseMap)
+{
+  // determine which map we are on, and return the name appropriately
+  switch(chooseMap)
+  {
+    case 2:
+      return "pkrmrn_ctr_map";
+    case 3:
+      return "village_ruins_map";
+    default:
+      return "perllert_town_map";
+  }
+}
+
+/**
+ * This function will save the game state to a file
+ * 
+ * @param x the x position of the player
+ * @param y the y position of the player
+ * @param currentMap the current map that the player is on
+ * @param musicSelector the current music that is playing
+ * 
+ * @return void
+ */
+void saveGame (int x, int y, char* currentMap, int musicSelector) 
+{
+  // Try to create a directory for the save file (if it doesn't exist)
+  // this works because mkdir doesn't do anything if the directory already exists
+  mkdir("save_data", 0777); // 0777 permissions mean everyone can read/write/execute
+
+  // open file from the directory
+  // this will create the file if it doesn't exist
+  FILE *saveFile = fopen("save_data/save.txt", "w");
+  if (saveFile == NULL) 
+  {
+      fprintf(stderr, "Error opening or creating save file!\n");
+      return;
+  }
+
+  // save the current map
+  fprintf(saveFile, "map: %s\n", currentMap);
+
+  // save the music state
+  fprintf(saveFile, "music: %d\n", musicSelector);
+
+  // convert the player's position to grid coordinates and save
+  int gridX = (x - X_OFFSET) / TILE_WIDTH;
+  int gridY = y / TILE_HEIGHT;
+  fprintf(saveFile, "xpos: %d\n", gridX);
+  fprintf(saveFile, "ypos: %d\n", gridY);
+
+  fclose(saveFile);
+}
+
+/**
+ * This function will load the game state from a file
+ * 
+ * @param loadError the load error variable to determine whether we are in the load error state or not
+ * @param player the player struct, intended for the main character
+ * @param map the map that will be loaded in association with the current map name
+ * @param chooseMap the variable to determine which map to next load
+ * @param musicSelector the music that should be playing
+ * 
+ * @return void
+ */
+void loadGame(bool *loadError, Player *player, int map[MAP_ROWS][MAP_COLS], int *chooseMap, int *musicSelector)   
+{
+  // load the game
+  FILE* saveFile = fopen("save_data/save.txt", "r");
+  char line[100]; // Array to hold each line of the file
+
+  // Check if the file exists
+  if (saveFile == NULL) 
+  {
+    *loadError = true;
+    return;
+  }
+
+  // Read the file line by line
+  while (fgets(line, sizeof(line), saveFile) != NULL) 
+  {
+    // set up our checks in the save file
+    char mapPrefix[] = "map: ";
+    char musicPrefix[] = "music: ";
+    char xposPrefix[] = "xpos: ";
+    char yposPrefix[] = "ypos: ";
+
+    // check to see if the line is a map line
+    if(strncmp(mapPrefix, line, strlen(mapPrefix)) == 0)
+    {
+      // ensure that the line has a value
+      if(strlen(line) <= strlen(mapPrefix))
+      {
+        *loadError = true;
+        printf("map prefix has no value\n");
+        break;
+      }
+
+      // we will select the map based on the string after the prefix
+      char* mapChoice = line + strlen(mapPrefix);
+      
+      // now we have the map choice, we can change the map variable
+      // 18 is the number of characters in "perllert_town_map", not magic number
+      if(strncmp("perllert_town_map", mapChoice, strlen("perllert_town_map")) == 0)
+      {
+        loadMap(map, PERLLERT_TOWN);
+        *chooseMap = 1;
+      }
+      else if(strncmp("pkrmrn_ctr_map", mapChoice, strlen("pkrmrn_ctr_map")) == 0)
+      {
+        loadMap(map, PKRMN_CTR);
+        *chooseMap = 2;
+      }
+      else if(strncmp("village_ruins_map", mapChoice, strlen("village_ruins_map")) == 0)
+      {
+        loadMap(map, VILLAGE_RUINS);
+        *chooseMap = 3;
+      }
+    }
+    // check to see if the line is a music line
+    else if(strncmp(musicPrefix, line, strlen(musicPrefix)) == 0)
+    {
+      // ensure that the line has a value
+      if(strlen(line) <= strlen(musicPrefix))
+      {
+        *loadError = true;
+        printf("music prefix has no value\n");
+        break;
+      }
+
+      char musicChoice[100];
+      for (int i = (int) strlen(musicPrefix); i < (int) strlen(line) - 1; ++i)
+      {                    
+        // we will select the music based on the value after the prefix
+        musicChoice[i - strlen(musicPrefix)] = line[i];
+      }
+
+      *musicSelector = atoi(musicChoice);
+    }
+    // check to see if the line is an xpos line
+    else if(strncmp(xposPrefix, line, strlen(xposPrefix)) == 0)
+    {
+      // ensure that the line has a value
+      if(strlen(line) <= strlen(xposPrefix))
+      {
+        *loadError = true;
+        printf("xpos prefix has no value\n");
+        break;
+      }
+
+      char xChoice[100];
+      for (int i = (int) strlen(xposPrefix); i < (int) strlen(line) - 1; ++i)
+      {
+        // we will select the x pos based on the value after the prefix
+        xChoice[i - strlen(xposPrefix)] = line[i];
+      }
+      // reading in xpos
+      (*player).x = atoi(xChoice) * TILE_WIDTH + X_OFFSET;
+
+    }
+    // check to see if the line is a ypos line
+    else if(strncmp(yposPrefix, line, strlen(yposPrefix)) == 0)
+    {
+      // ensure that the line has a value
+      if(strlen(line) <= strlen(yposPrefix))
+      {
+        *loadError = true;
+        printf("ypos prefix has no value\n");
+        break;
+      }
+
+      char yChoice[100];
+      for (int i = (int) strlen(yposPrefix); i < (int) strlen(line) - 1; ++i)
+      {
+        // we will select the x pos based on the value after the prefix
+        yChoice[i - strlen(yposPrefix)] = line[i];
+      }
+      // reading in ypos
+      (*player).y = atoi(yChoice) * TILE_HEIGHT;
+    }
+  }
+  // close the file for safety
+  fclose(saveFile);
+  
+}
+
+/**
+ * This function will set up a fresh game in Perllert Town
+ * 
+ * @param instance the game to set up
+ * 
+ * @return void
+ */
+void gameInstanceInit (GameInstance *instance)
+{
+  memset(instance, 0, sizeof(*instance));
+  (*instance).currentGameState = GAME;
+  (*instance).currentMenuState = SAVE;
+  (*instance).player.x = (X_RESOLUTION - TILE_WIDTH) / 2; // default x position
+  (*instance).player.y = (Y_RESOLUTION - TILE_HEIGHT) / 2; // default y position
+  (*instance).player.direction = IDLE_DOWN; // default direction
+
+  // Copy the map from the array to the map variable, initialize settings
+  loadMap((*instance).map, PERLLERT_TOWN);
+  (*instance).musicSelector = 1; // start with perllert town music
+  (*instance).chooseMap = 1; // determine which map to load, start with perllert town map
+}
+
+/**
+ * This function will fill the map from a chunk of the world, moving the streamer's camera there first
+ * 
+ * @param instance the game walking the world
+ * @param chunkX the chunk column
+ * @param chunkY the chunk row
+ * 
+ * @return bool false if the streamer does not keep the chunk
+ */
+static bool enterChunk (GameInstance *instance, int chunkX, int chunkY)
+{
+  worldStreamerFocus((*instance).world, chunkX, chunkY);
+  const WorldChunk *chunk = worldStreamerGet((*instance).world, chunkX, chunkY);
+  if (chunk == NULL)
+  {
+    return false;
+  }
+
+  // the chunk is only kept while the camera is near it, so its tiles are copied straight away
+  memcpy((*instance).map, (*chunk).tiles, sizeof((*instance).map));
+  (*instance).chunkX = chunkX;
+  (*instance).chunkY = chunkY;
+  return true;
+}
+
+/**
+ * This function will move a fresh game into a generated world, standing on the first chunk's left exit
+ * 
+ * @param instance the game, set up by gameInstanceInit
+ * @param world the streamer the chunks come from, it has to outlive the game
+ * 
+ * @return bool false if the first chunk could not be generated
+ */
+bool gameInstanceEnterWorld (GameInstance *instance, WorldStreamer *world)
+{
+  (*instance).world = world;
+  if (!enterChunk(instance, 0, 0))
+  {
+    (*instance).world = NULL;
+    return false;
+  }
+
+  // the world is drawn, lit and scored like the hand-made map it looks like
+  (*instance).chooseMap = (*world).style == WORLD_RUINS ? 3 : 1;
+  (*instance).musicSelector = (*instance).chooseMap;
+
+  // the left edge of every chunk is open, so there is always an exit to start on
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    if ((*instance).map[row][0] == WORLD_EXIT_LEFT)
+    {
+      (*instance).player.x = X_OFFSET;
+      (*instance).player.y = row * TILE_HEIGHT;
+      break;
+    }
+  }
+  return true;
+}
+
+/**
+ * This function will give the map being played an id that changes whenever the player arrives somewhere else
+ * 
+ * @param instance the game
+ * 
+ * @return int the chooseMap number on the hand-made maps, an id from WORLD_MAP_ID_BASE up for each world chunk
+ */
+int mapIdOf (const GameInstance *instance)
+{
+  if ((*instance).world == NULL)
+  {
+    return (*instance).chooseMap;
+  }
+
+  // neighbouring chunks always get different ids, they only repeat 32768 chunks apart
+  return WORLD_MAP_ID_BASE + (((*instance).chunkY & 0x7FFF) << 15 | ((*instance).chunkX & 0x7FFF));
+}
+
+/**
+ * This function will compile the trigger scripts, from the trigger file if there is a valid one
+ * 
+ * @return void
+ */
+static void compileTriggers (void)
+{
+  if (triggerPath == NULL || !scriptLoadFile(&triggerLibrary, triggerPath))
+  {
+    scriptCompile(&triggerLibrary, defaultTriggers, "built-in triggers");
+  }
+}
+
+/**
+ * This function will get the trigger scripts, compiling them on first use
+ * 
+ * @return const ScriptLibrary* the trigger scripts
+ */
+const ScriptLibrary* triggerScripts (void)
+{
+  pthread_once(&triggersCompiled, compileTriggers);
+  return &triggerLibrary;
+}
+
+/**
+ * This function will choose the trigger file, it has to be called before any game is updated
+ * 
+ * @param path the trigger file, the built-in triggers are used if it is missing or does not compile
+ * 
+ * @return void
+ */
+void loadTriggerScripts (const char *path)
+{
+  triggerPath = path;
+  triggerScripts();
+}
+
+/**
+ * This function will swap in newly compiled trigger scripts, only while no game is being updated
+ * 
+ * @param library the trigger scripts to use from now on
+ * 
+ * @return void
+ */
+void replaceTriggerScripts (const ScriptLibrary *library)
+{
+  triggerScripts();
+  triggerLibrary = *library;
+}
+
+/**
+ * This function will take the player through a world exit into the neighbouring chunk
+ * 
+ * like the warp triggers between the hand-made maps, the player keeps the other coordinate
+ * and walks in from just outside the new chunk's opposite edge, onto the exit that matches
+ * 
+ * @param instance the game walking the world
+ * @param tile the tile the player is leaving
+ * @param leaving the direction the player is leaving it in
+ * 
+ * @return bool true if the player moved to another chunk
+ */
+static bool walkWorldExit (GameInstance *instance, int tile, InputDirection leaving)
+{
+  int chunkX = (*instance).chunkX;
+  int chunkY = (*instance).chunkY;
+  int x = (*instance).player.x;
+  int y = (*instance).player.y;
+
+  if (tile == WORLD_EXIT_UP && leaving == INPUT_UP)
+  {
+    --chunkY;
+    y = MAP_ROWS * TILE_HEIGHT;
+  }
+  else if (tile == WORLD_EXIT_RIGHT && leaving == INPUT_RIGHT)
+  {
+    ++chunkX;
+    x = X_OFFSET - TILE_WIDTH;
+  }
+  else if (tile == WORLD_EXIT_DOWN && leaving == INPUT_DOWN)
+  {
+    ++chunkY;
+    y = -TILE_HEIGHT;
+  }
+  else if (tile == WORLD_EXIT_LEFT && leaving == INPUT_LEFT)
+  {
+    --chunkX;
+    x = MAP_COLS * TILE_WIDTH + X_OFFSET;
+  }
+  else
+  {
+    return false;
+  }
+
+  if (!enterChunk(instance, chunkX, chunkY))
+  {
+    return false;
+  }
+  (*instance).player.x = x;
+  (*instance).player.y = y;
+  return true;
+}
+
+/**
+ * This function will advance one game by one tick, moving the player and switching maps
+ * 
+ * @param instance the game to advance
+ * @param input the movement keys drained from the input queue this tick
+ * @param latency the input-to-present latency tracker, or NULL when nothing is presented
+ * @param currentTime the game's clock in milliseconds, the wall clock or a simulated one
+ * 
+ * @return void
+ */
+void updateGame (GameInstance *instance, InputState *input, InputLatency *latency, Uint32 currentTime)
+{
+  // nothing moves while the menu is open, and the presses that moved through it are not kept as steps
+  if ((*instance).currentGameState != GAME)
+  {
+    memset((*input).tapped, 0, sizeof((*input).tapped));
+    return;
+  }
+
+  Player *player = &(*instance).player;
+  int (*map)[MAP_COLS] = (*instance).map;
+  Uint32 *lastMoveTime = &(*instance).lastMoveTime;
+
+  // handle user input and acceptable time window for input 
+  // Check if enough time has passed since the last move
+  if (currentTime - (*lastMoveTime) >= MOVEMENT_DELAY) 
+  {
+    // Handle keyboard input, taps since the last move are latched so they are not lost
+    int moved = 0;
+
+    // track our new coordinates
+    int newX = (*player).x;
+    int newY = (*player).y;
+
+    // track our grid position
+    int gridX = (*player).x / TILE_WIDTH;
+    int gridY = (*player).y / TILE_HEIGHT;
+
+    // after a map switch the player can start just outside the grid, where there is no tile to check
+    int currentTile = -1;
+    if (gridX >= 0 && gridX < MAP_COLS && gridY >= 0 && gridY < MAP_ROWS)
+    {
+      currentTile = map[gridY][gridX];
+    }
+
+    // track the direction we are leaving the current tile in, if any
+    int leaving = -1;
+
+    // determine which direction we are moving
+    if (inputIsDown(input, INPUT_UP)) 
+    {
+      inputConsume(input, INPUT_UP, latency);
+
+      // update animation variables
+      (*player).direction = UP;
+
+      // case we are moving up
+      newY -= TILE_HEIGHT; 
+      moved = 1;
+      leaving = INPUT_UP;
+    }
+    else if (inputIsDown(input, INPUT_LEFT)) 
+    {
+      inputConsume(input, INPUT_LEFT, latency);
+
+      // update animation variables
+      (*player).direction = LEFT;
+
+      // case we are moving left
+      newX -= TILE_WIDTH;
+      moved = 1;
+      leaving = INPUT_LEFT;
+    }
+    else if (inputIsDown(input, INPUT_DOWN)) 
+    {
+      inputConsume(input, INPUT_DOWN, latency);
+
+      // update animation variables
+      (*player).direction = DOWN;
+
+      // case we are moving down
+      newY += TILE_HEIGHT;
+      moved = 1;
+      leaving = INPUT_DOWN;
+    }
+    else if (inputIsDown(input, INPUT_RIGHT)) 
+    {
+      inputConsume(input, INPUT_RIGHT, latency);
+
+      // update animation variables
+      (*player).direction = RIGHT;
+
+      // case we are moving right
+      newX += TILE_WIDTH; 
+      moved = 1;
+      leaving = INPUT_RIGHT;
+    }
+
+    // leaving some tiles runs a trigger script, the exit points between maps are all triggers
+    // in a generated world the exits lead to the neighbouring chunk instead
+    bool switchMap = false;
+    if (leaving >= 0 && (*instance).world != NULL)
+    {
+      switchMap = walkWorldExit(instance, currentTile, (InputDirection) leaving);
+    }
+    else if (leaving >= 0)
+    {
+      switchMap = scriptRunTrigger(triggerScripts(), instance, currentTile, (InputDirection) leaving);
+    }
+    if (switchMap)
+    {
+      // the trigger already placed us on the new map, so this is not a move
+      moved = 0;
+    }
+
+    // Reset to idle state if no movement keys are pressed
+    if (!inputAnyDown(input))
+    {
+        (*instance).currentFrame = 0; // reset animation frame for idle
+        switch((*player).direction)
+        {
+          case UP:
+            (*player).direction = IDLE_UP;
+            break;
+          case LEFT:
+            (*player).direction = IDLE_LEFT;
+            break;
+          case DOWN:
+            (*player).direction = IDLE_DOWN;
+            break;
+          case RIGHT:
+            (*player).direction = IDLE_RIGHT;
+            break;
+          default:
+            break;
+        }
+    }
+
+    // otherwise, we are just moving around the map
+    if (!switchMap && newX >= 0 && 
+        // we do not subtract TILE_WIDTH because we already account for x position
+        newX <= (MAP_COLS * TILE_WIDTH) && //- TILE_WIDTH + TILE_WIDTH &&
+        newY >= 0 && 
+        newY <= ((MAP_ROWS * TILE_HEIGHT) - TILE_HEIGHT))
+    {
+      // determine the grid position of the new coordinates
+      int newGridX = newX / TILE_WIDTH;
+      int newGridY = newY / TILE_HEIGHT;
+
+      // determine if the new position is a wall or not
+      if (tileIsWalkable(map[newGridY][newGridX]))
+      {
+        // ensure the character is within map bounds
+        (*player).x = newX;
+        (*player).y = newY;
+      }
+    }
+
+    // determine if we have moved or not
+    if (moved != 0)
+    {
+      // Update the last move time if we have moved for the delay
+      *lastMoveTime = currentTime;
+    }
+  }
+
+  // Finalize changes to frame 
+  if ((*player).direction != IDLE_RIGHT && (*player).direction != IDLE_LEFT && 
+      (*player).direction != IDLE_UP && (*player).direction != IDLE_DOWN) 
+  {
+    // Update the frame if the character is not idle
+    if (currentTime - (*instance).lastAnimationFrame >= ANIMATION_DELAY) 
+    {
+      (*instance).currentFrame = ((*instance).currentFrame + 1) % SPRITE_FRAMES;
+      (*instance).lastAnimationFrame = currentTime;
+    }
+  } 
+  else 
+  {
+    // Reset to the first frame when idle
+    (*instance).currentFrame = 0;
+  }
+}
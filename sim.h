@@ -0,0 +1,56 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "game.h"
+#include "input.h"
+#include "worldgen.h"
+
+// this will set up for our start menu
+typedef enum { MENU, GAME } GameState;
+
+// This will set up our menu options
+typedef enum { SAVE, LOAD, EXIT } MenuState;
+
+// Variables for tracking character direction and state
+typedef enum { RIGHT, LEFT, UP, DOWN, IDLE_RIGHT, IDLE_LEFT, IDLE_UP, IDLE_DOWN } Direction;
+
+// Define map types
+typedef enum { PERLLERT_TOWN, PKRMN_CTR, VILLAGE_RUINS } MapType;
+
+// Structs for managing game data
+typedef struct
+{
+    int x, y;
+    Direction direction;
+} Player;
+
+// everything one running game needs, so several games can run side by side in one process
+typedef struct
+{
+  GameState currentGameState;
+  MenuState currentMenuState;
+  Player player;
+  int map[MAP_ROWS][MAP_COLS];
+  int chooseMap; // determine which map to load (1 perllert town, 2 perkemern center, 3 village ruins)
+  bool loadError; // whether we are in the load error state or not
+  Uint32 lastMoveTime; // Time of the last movement
+  int currentFrame; // the current frame of the sprite animation
+  Uint32 lastAnimationFrame;
+  int musicSelector; // the music that should be playing, read by the music thread
+  WorldStreamer *world; // the generated world being walked, NULL on the hand-made maps
+  int chunkX, chunkY; // the world chunk the map was filled from, kept apart from chooseMap, which stays 1 or 3
+} GameInstance;
+
+void loadMap(int map[MAP_ROWS][MAP_COLS], MapType mapType);
+char* mapNameOf(int chooseMap);
+void saveGame(int x, int y, char* currentMap, int musicSelector);
+void loadGame(bool *loadError, Player *player, int map[MAP_ROWS][MAP_COLS], int *chooseMap, int *musicSelector);
+void gameInstanceInit(GameInstance *instance);
+bool gameInstanceEnterWorld(GameInstance *instance, WorldStreamer *world);
+int mapIdOf(const GameInstance *instance);
+void loadTriggerScripts(const char *path);
+void updateGame(GameInstance *instance, InputState *input, InputLatency *latency, Uint32 currentTime);
+
+#endif
@@ -0,0 +1,225 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <string.h>
+#include "alloc.h"
+#include "renderstats.h"
+#include "spritebatch.h"
+
+/**
+ * This function will set up an empty sprite batch
+ *
+ * @param batch the sprite batch
+ * @param arena the frame arena the sort and the vertices take their memory from, swapped once a frame
+ *
+ * @return bool true if its memory could be allocated
+ */
+bool spriteBatchInit (SpriteBatch *batch, FrameArena *arena)
+{
+  memset(batch, 0, sizeof(*batch));
+  (*batch).arena = arena;
+  (*batch).sprites = memAlloc(MEM_RENDER, SPRITE_BATCH_CAPACITY * sizeof(BatchedSprite));
+  (*batch).indices = memAlloc(MEM_RENDER, SPRITE_BATCH_CAPACITY * 6 * sizeof(int));
+  if ((*batch).sprites == NULL || (*batch).indices == NULL)
+  {
+    fprintf(stderr, "Sprite batch could not be allocated!\n");
+    spriteBatchDestroy(batch);
+    return false;
+  }
+
+  // every sprite is a quad of two triangles
+  for (int i = 0; i < SPRITE_BATCH_CAPACITY; ++i)
+  {
+    int *quad = &(*batch).indices[i * 6];
+    quad[0] = i * 4;
+    quad[1] = i * 4 + 1;
+    quad[2] = i * 4 + 2;
+    quad[3] = i * 4 + 2;
+    quad[4] = i * 4 + 1;
+    quad[5] = i * 4 + 3;
+  }
+  return true;
+}
+
+/**
+ * This function will add a sprite to the frame, placed by where its feet are
+ *
+ * @param batch the sprite batch
+ * @param layer the layer it is drawn in
+ * @param texture the texture it is cut from
+ * @param src the part of the texture to draw
+ * @param anchorX the middle of the sprite's bottom edge on the screen
+ * @param anchorY the sprite's bottom edge on the screen, sprites lower down are drawn over higher ones
+ *
+ * @return bool false if the batch is full
+ */
+bool spriteBatchAdd (SpriteBatch *batch, SpriteLayer layer, int texture, const SDL_Rect *src, int anchorX, int anchorY)
+{
+  if ((*batch).count == SPRITE_BATCH_CAPACITY)
+  {
+    ++(*batch).dropped;
+    return false;
+  }
+
+  BatchedSprite *sprite = &(*batch).sprites[(*batch).count++];
+  (*sprite).key = ((Uint32) layer << 24) | ((Uint32) (anchorY + SPRITE_Y_BIAS) & 0xFFFF) << 8 | (Uint32) (texture & 0xFF);
+  (*sprite).x = (Sint16) (anchorX - (*src).w / 2);
+  (*sprite).y = (Sint16) (anchorY - (*src).h);
+  (*sprite).srcX = (Sint16) (*src).x;
+  (*sprite).srcY = (Sint16) (*src).y;
+  (*sprite).w = (Uint8) (*src).w;
+  (*sprite).h = (Uint8) (*src).h;
+  (*sprite).texture = (Uint8) texture;
+  return true;
+}
+
+/**
+ * This function will put the sprites in drawing order with a radix sort on their keys, a byte at a time
+ *
+ * the sort is stable, so sprites with the same key keep the order they were added in
+ * a byte that every key shares, like the layer when everything is on one layer, costs no pass
+ * each pass writes into the other buffer, the one taken from the frame arena
+ *
+ * @param batch the sprite batch
+ *
+ * @return const BatchedSprite* the sorted sprites, valid until the batch is added to again, unsorted if the arena is full
+ */
+const BatchedSprite* spriteBatchSort (SpriteBatch *batch)
+{
+  int count = (*batch).count;
+  BatchedSprite *from = (*batch).sprites;
+  BatchedSprite *to = ARENA_ALLOC((*batch).arena, BatchedSprite, count, MEM_RENDER);
+  if (to == NULL)
+  {
+    return from;
+  }
+
+  for (int shift = 0; shift < 32; shift += 8)
+  {
+    int offsets[256] = {0};
+    for (int i = 0; i < count; ++i)
+    {
+      ++offsets[(from[i].key >> shift) & 0xFF];
+    }
+    if (count == 0 || offsets[(from[0].key >> shift) & 0xFF] == count)
+    {
+      continue;
+    }
+
+    int total = 0;
+    for (int digit = 0; digit < 256; ++digit)
+    {
+      int digitCount = offsets[digit];
+      offsets[digit] = total;
+      total += digitCount;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+      to[offsets[(from[i].key >> shift) & 0xFF]++] = from[i];
+    }
+
+    BatchedSprite *sorted = to;
+    to = from;
+    from = sorted;
+  }
+  return from;
+}
+
+/**
+ * This function will sort the frame's sprites and draw them, each run sharing a texture in one submission
+ *
+ * @param batch the sprite batch, empty again afterwards
+ * @param renderer the renderer to draw with
+ * @param textures the textures the sprites are cut from
+ *
+ * @return void
+ */
+void spriteBatchDraw (SpriteBatch *batch, SDL_Renderer *renderer, SDL_Texture **textures)
+{
+  const BatchedSprite *sprites = spriteBatchSort(batch);
+
+  int start = 0;
+  while (start < (*batch).count)
+  {
+    int texture = sprites[start].texture;
+    int end = start;
+    while (end < (*batch).count && sprites[end].texture == texture)
+    {
+      ++end;
+    }
+
+    // the texture coordinates are fractions of the texture's size
+    int width, height;
+    SDL_Vertex *vertices = NULL;
+    if (textures[texture] != NULL && SDL_QueryTexture(textures[texture], NULL, NULL, &width, &height) == 0 && width > 0
+        && height > 0)
+    {
+      vertices = ARENA_ALLOC((*batch).arena, SDL_Vertex, (end - start) * 4, MEM_RENDER);
+      if (vertices == NULL)
+      {
+        (*batch).dropped += end - start;
+      }
+    }
+    if (vertices != NULL)
+    {
+      float scaleX = 1.0f / (float) width;
+      float scaleY = 1.0f / (float) height;
+      for (int i = start; i < end; ++i)
+      {
+        const BatchedSprite *sprite = &sprites[i];
+        SDL_Vertex *quad = &vertices[(i - start) * 4];
+        float left = (float) (*sprite).x;
+        float top = (float) (*sprite).y;
+        float u = (float) (*sprite).srcX * scaleX;
+        float v = (float) (*sprite).srcY * scaleY;
+        float du = (float) (*sprite).w * scaleX;
+        float dv = (float) (*sprite).h * scaleY;
+        quad[0].position = (SDL_FPoint) {left, top};
+        quad[1].position = (SDL_FPoint) {left + (*sprite).w, top};
+        quad[2].position = (SDL_FPoint) {left, top + (*sprite).h};
+        quad[3].position = (SDL_FPoint) {left + (*sprite).w, top + (*sprite).h};
+        quad[0].tex_coord = (SDL_FPoint) {u, v};
+        quad[1].tex_coord = (SDL_FPoint) {u + du, v};
+        quad[2].tex_coord = (SDL_FPoint) {u, v + dv};
+        quad[3].tex_coord = (SDL_FPoint) {u + du, v + dv};
+        quad[0].color = quad[1].color = quad[2].color = quad[3].color = (SDL_Color) {255, 255, 255, 255};
+      }
+      renderGeometry(renderer, textures[texture], vertices, (end - start) * 4, (*batch).indices, (end - start) * 6);
+      (*batch).drawn += end - start;
+      ++(*batch).submissions;
+    }
+    start = end;
+  }
+  (*batch).count = 0;
+}
+
+/**
+ * This function will print how many sprites were drawn in how many submissions and start a new report
+ *
+ * @param batch the sprite batch
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void spriteBatchPrintReport (SpriteBatch *batch, FILE *out)
+{
+  fprintf(out, "SPRITES: %d drawn in %d submissions (%.1f per submission), %d dropped\n",
+          (*batch).drawn, (*batch).submissions,
+          (*batch).submissions > 0 ? (double) (*batch).drawn / (*batch).submissions : 0.0, (*batch).dropped);
+  (*batch).drawn = 0;
+  (*batch).submissions = 0;
+  (*batch).dropped = 0;
+}
+
+/**
+ * This function will free the sprite batch's memory
+ *
+ * @param batch the sprite batch
+ *
+ * @return void
+ */
+void spriteBatchDestroy (SpriteBatch *batch)
+{
+  memFree(MEM_RENDER, (*batch).sprites);
+  memFree(MEM_RENDER, (*batch).indices);
+  memset(batch, 0, sizeof(*batch));
+}
@@ -0,0 +1,50 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL.h>
+#include "game.h"
+#include "alloc.h"
+
+#define SPRITE_BATCH_CAPACITY 4096 // sprites one frame can draw, the rest are dropped
+#define SPRITE_Y_BIAS 32768 // added to a sprite's y so sprites above the screen still sort first
+
+// the layers sprites are drawn in, within one layer the sprite lower on the screen is drawn over the other
+typedef enum
+{
+  SPRITE_LAYER_GROUND,   // lying on the map, under everything that stands on it
+  SPRITE_LAYER_OBJECTS,  // characters and props
+  SPRITE_LAYER_OVERHEAD, // over everyone's heads, like roofs and treetops
+  SPRITE_LAYER_COUNT
+} SpriteLayer;
+
+// one sprite waiting to be drawn, its key orders it by layer, then the y of its feet, then its texture
+typedef struct
+{
+  Uint32 key;
+  Sint16 x, y; // the top left corner on the screen
+  Sint16 srcX, srcY;
+  Uint8 w, h;
+  Uint8 texture;
+} BatchedSprite;
+
+// collects a frame's sprites, sorts them and draws every run that shares a texture in one submission
+// the radix sort's other buffer and the vertices only live for the frame, so they come from the frame arena
+typedef struct
+{
+  BatchedSprite *sprites;
+  int count;
+  int *indices; // the same two triangles per sprite, filled in once
+  FrameArena *arena;
+  int drawn, submissions, dropped; // since the last report
+} SpriteBatch;
+
+bool spriteBatchInit(SpriteBatch *batch, FrameArena *arena);
+bool spriteBatchAdd(SpriteBatch *batch, SpriteLayer layer, int texture, const SDL_Rect *src, int anchorX, int anchorY);
+const BatchedSprite* spriteBatchSort(SpriteBatch *batch);
+void spriteBatchDraw(SpriteBatch *batch, SDL_Renderer *renderer, SDL_Texture **textures);
+void spriteBatchPrintReport(SpriteBatch *batch, FILE *out);
+void spriteBatchDestroy(SpriteBatch *batch);
+
+#endif
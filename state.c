@@ -0,0 +1,427 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "state.h"
+
+// the state is handled as raw bytes everywhere, so it must not grow padding behind our back
+_Static_assert(sizeof(SimState) == 120, "SimState must stay tightly packed");
+
+/**
+ * This function will copy a game into the compact state layout
+ *
+ * @param instance the game to copy
+ * @param state the packed state
+ *
+ * @return void
+ */
+void statePack (const GameInstance *instance, SimState *state)
+{
+  memset(state, 0, sizeof(*state));
+  (*state).lastMoveTime = (*instance).lastMoveTime;
+  (*state).lastAnimationFrame = (*instance).lastAnimationFrame;
+  (*state).chunkX = (*instance).chunkX;
+  (*state).chunkY = (*instance).chunkY;
+  (*state).x = (Sint16) (*instance).player.x;
+  (*state).y = (Sint16) (*instance).player.y;
+  (*state).direction = (Uint8) (*instance).player.direction;
+  (*state).chooseMap = (Uint8) (*instance).chooseMap;
+  (*state).gameState = (Uint8) (*instance).currentGameState;
+  (*state).menuState = (Uint8) (*instance).currentMenuState;
+  (*state).loadError = (*instance).loadError ? 1 : 0;
+  (*state).currentFrame = (Uint8) (*instance).currentFrame;
+  (*state).musicSelector = (Sint8) (*instance).musicSelector;
+
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    for (int col = 0; col < MAP_COLS; ++col)
+    {
+      (*state).map[row][col] = (Uint8) (*instance).map[row][col];
+    }
+  }
+}
+
+/**
+ * This function will copy a packed state back into a game
+ *
+ * @param state the packed state
+ * @param instance the game to overwrite
+ *
+ * @return void
+ */
+void stateUnpack (const SimState *state, GameInstance *instance)
+{
+  (*instance).lastMoveTime = (*state).lastMoveTime;
+  (*instance).lastAnimationFrame = (*state).lastAnimationFrame;
+  (*instance).chunkX = (*state).chunkX;
+  (*instance).chunkY = (*state).chunkY;
+  (*instance).player.x = (*state).x;
+  (*instance).player.y = (*state).y;
+  (*instance).player.direction = (Direction) (*state).direction;
+  (*instance).chooseMap = (*state).chooseMap;
+  (*instance).currentGameState = (GameState) (*state).gameState;
+  (*instance).currentMenuState = (MenuState) (*state).menuState;
+  (*instance).loadError = (*state).loadError != 0;
+  (*instance).currentFrame = (*state).currentFrame;
+  (*instance).musicSelector = (*state).musicSelector;
+
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    for (int col = 0; col < MAP_COLS; ++col)
+    {
+      (*instance).map[row][col] = (*state).map[row][col];
+    }
+  }
+}
+
+/**
+ * This function will hash a packed state (64 bit FNV-1a), equal states always give equal hashes
+ *
+ * @param state the packed state
+ *
+ * @return Uint64 the hash
+ */
+Uint64 stateHash (const SimState *state)
+{
+  const Uint8 *bytes = (const Uint8 *) state;
+  Uint64 hash = 14695981039346656037ull;
+
+  for (size_t i = 0; i < sizeof(*state); ++i)
+  {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+
+  return hash;
+}
+
+/**
+ * This function will hash a game, two games that hash alike have not desynced
+ *
+ * @param instance the game
+ *
+ * @return Uint64 the hash
+ */
+Uint64 gameInstanceHash (const GameInstance *instance)
+{
+  SimState state;
+  statePack(instance, &state);
+  return stateHash(&state);
+}
+
+/**
+ * This function will compress a state XORed against its predecessor
+ *
+ * The XOR leaves zeros wherever nothing changed, so the bytes are stored as runs: a control byte below 128
+ * is followed by that many + 1 literal bytes, a control byte of 128 or more skips that many - 127 zeros.
+ *
+ * @param out the compressed bytes, at least STATE_MAX_PACKED long
+ * @param state the state to store
+ * @param previous the state it is stored against, or NULL for a keyframe
+ *
+ * @return int the compressed size
+ */
+static int compressState (Uint8 *out, const SimState *state, const SimState *previous)
+{
+  Uint8 delta[sizeof(SimState)];
+  const Uint8 *current = (const Uint8 *) state;
+  const Uint8 *base = (const Uint8 *) previous;
+
+  for (size_t i = 0; i < sizeof(delta); ++i)
+  {
+    delta[i] = base != NULL ? (Uint8) (current[i] ^ base[i]) : current[i];
+  }
+
+  int size = 0;
+  int i = 0;
+  int length = (int) sizeof(delta);
+  while (i < length)
+  {
+    // a zero run is only worth a control byte when it is at least two long
+    int run = 0;
+    while (i + run < length && run < 128 && delta[i + run] == 0)
+    {
+      ++run;
+    }
+    if (run >= 2 || (run == 1 && i + 1 == length))
+    {
+      out[size++] = (Uint8) (127 + run);
+      i += run;
+      continue;
+    }
+
+    int start = i;
+    while (i < length && i - start < 128 && !(delta[i] == 0 && i + 1 < length && delta[i + 1] == 0))
+    {
+      ++i;
+    }
+    out[size++] = (Uint8) (i - start - 1);
+    memcpy(out + size, delta + start, (size_t) (i - start));
+    size += i - start;
+  }
+
+  return size;
+}
+
+/**
+ * This function will XOR a compressed entry onto a state
+ *
+ * @param state the state to apply it to, zeroed for a keyframe
+ * @param in the compressed bytes
+ * @param size the compressed size
+ *
+ * @return void
+ */
+static void applyState (SimState *state, const Uint8 *in, int size)
+{
+  Uint8 *bytes = (Uint8 *) state;
+  int position = 0;
+
+  for (int i = 0; i < size && position < (int) sizeof(*state);)
+  {
+    int control = in[i++];
+    if (control >= 128)
+    {
+      position += control - 127;
+      continue;
+    }
+
+    for (int n = 0; n <= control && i < size && position < (int) sizeof(*state); ++n)
+    {
+      bytes[position++] ^= in[i++];
+    }
+  }
+}
+
+/**
+ * This function will set up an empty history
+ *
+ * @param history the history to set up
+ *
+ * @return bool whether the pool could be allocated
+ */
+bool stateHistoryInit (StateHistory *history)
+{
+  memset(history, 0, sizeof(*history));
+  (*history).pool = memAlloc(MEM_SAVE, STATE_POOL_SIZE);
+  if ((*history).pool == NULL)
+  {
+    fprintf(stderr, "State history could not be allocated!\n");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * This function will drop the oldest entry, and any deltas left without their keyframe
+ *
+ * @param history the history
+ *
+ * @return void
+ */
+static void evictOldest (StateHistory *history)
+{
+  do
+  {
+    (*history).first = ((*history).first + 1) % STATE_HISTORY_ENTRIES;
+    --(*history).count;
+  }
+  while ((*history).count > 0 && !(*history).entries[(*history).first].keyframe);
+}
+
+/**
+ * This function will decode one entry by replaying from the keyframe before it
+ *
+ * @param history the history
+ * @param index the entry, counted from the oldest
+ * @param state the decoded state
+ *
+ * @return void
+ */
+static void decodeEntry (const StateHistory *history, int index, SimState *state)
+{
+  int keyframe = index;
+  while (keyframe > 0 && !(*history).entries[((*history).first + keyframe) % STATE_HISTORY_ENTRIES].keyframe)
+  {
+    --keyframe;
+  }
+
+  memset(state, 0, sizeof(*state));
+  for (int i = keyframe; i <= index; ++i)
+  {
+    const StateEntry *entry = &(*history).entries[((*history).first + i) % STATE_HISTORY_ENTRIES];
+    applyState(state, (*history).pool + (*entry).offset, (*entry).size);
+  }
+
+  const StateEntry *entry = &(*history).entries[((*history).first + index) % STATE_HISTORY_ENTRIES];
+  if ((Uint32) stateHash(state) != (*entry).hash)
+  {
+    fprintf(stderr, "State history entry at %u ms failed its hash check!\n", (*entry).time);
+  }
+}
+
+/**
+ * This function will record the game's state, at most once every STATE_RECORD_MS
+ *
+ * @param history the history
+ * @param instance the game to record
+ * @param now the current time in milliseconds
+ *
+ * @return void
+ */
+void stateHistoryRecord (StateHistory *history, const GameInstance *instance, Uint32 now)
+{
+  if ((*history).pool == NULL || ((*history).count > 0 && now - (*history).lastRecord < STATE_RECORD_MS))
+  {
+    return;
+  }
+  (*history).lastRecord = now;
+
+  // make room for the worst case first, the pool is written front to back and wraps to the start
+  if ((*history).count == STATE_HISTORY_ENTRIES)
+  {
+    evictOldest(history);
+  }
+  Uint32 offset = (*history).writeOffset;
+  if (offset + STATE_MAX_PACKED > STATE_POOL_SIZE)
+  {
+    offset = 0;
+  }
+  while ((*history).count > 0)
+  {
+    const StateEntry *oldest = &(*history).entries[(*history).first];
+    if ((*oldest).offset + (*oldest).size <= offset || (*oldest).offset >= offset + STATE_MAX_PACKED)
+    {
+      break;
+    }
+    evictOldest(history);
+  }
+
+  // everything older may have been evicted, then this entry has to stand on its own
+  bool keyframe = (*history).count == 0 || (*history).sinceKeyframe >= STATE_KEYFRAME_INTERVAL;
+
+  SimState state;
+  statePack(instance, &state);
+  int size = compressState((*history).pool + offset, &state, keyframe ? NULL : &(*history).last);
+
+  StateEntry *entry = &(*history).entries[((*history).first + (*history).count) % STATE_HISTORY_ENTRIES];
+  (*entry).time = now;
+  (*entry).offset = offset;
+  (*entry).size = (Uint16) size;
+  (*entry).keyframe = keyframe;
+  (*entry).hash = (Uint32) stateHash(&state);
+  ++(*history).count;
+
+  (*history).sinceKeyframe = keyframe ? 0 : (*history).sinceKeyframe + 1;
+  (*history).writeOffset = offset + (Uint32) size;
+  (*history).last = state;
+}
+
+/**
+ * This function will step the game back by one recorded state, forgetting the newest one
+ *
+ * @param history the history
+ * @param instance the game to rewind
+ *
+ * @return bool whether there was anything older to go back to
+ */
+bool stateHistoryRewind (StateHistory *history, GameInstance *instance)
+{
+  if ((*history).count <= 1)
+  {
+    return false;
+  }
+
+  const StateEntry *newest = &(*history).entries[((*history).first + (*history).count - 1) % STATE_HISTORY_ENTRIES];
+  (*history).writeOffset = (*newest).offset;
+  --(*history).count;
+
+  decodeEntry(history, (*history).count - 1, &(*history).last);
+  stateUnpack(&(*history).last, instance);
+
+  // the next recording continues the keyframe group the restored entry belongs to
+  (*history).sinceKeyframe = 0;
+  while ((*history).sinceKeyframe < (*history).count - 1 &&
+         !(*history).entries[((*history).first + (*history).count - 1 - (*history).sinceKeyframe) % STATE_HISTORY_ENTRIES].keyframe)
+  {
+    ++(*history).sinceKeyframe;
+  }
+  (*history).lastRecord = (*newest).time;
+  return true;
+}
+
+/**
+ * This function will keep the game's state in the save slot
+ *
+ * @param history the history holding the slot
+ * @param instance the game to save
+ *
+ * @return void
+ */
+void stateHistorySave (StateHistory *history, const GameInstance *instance)
+{
+  statePack(instance, &(*history).saveSlot);
+  (*history).hasSave = true;
+}
+
+/**
+ * This function will put the game back to the state in the save slot
+ *
+ * @param history the history holding the slot
+ * @param instance the game to restore
+ *
+ * @return bool whether there was a saved state
+ */
+bool stateHistoryLoad (StateHistory *history, GameInstance *instance)
+{
+  if (!(*history).hasSave)
+  {
+    return false;
+  }
+  stateUnpack(&(*history).saveSlot, instance);
+  return true;
+}
+
+/**
+ * This function will print how much history is kept and what each second of it costs
+ *
+ * @param history the history
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void stateHistoryPrintReport (const StateHistory *history, FILE *out)
+{
+  if ((*history).count == 0)
+  {
+    return;
+  }
+
+  Uint64 bytes = 0;
+  for (int i = 0; i < (*history).count; ++i)
+  {
+    bytes += (*history).entries[((*history).first + i) % STATE_HISTORY_ENTRIES].size;
+  }
+
+  const StateEntry *oldest = &(*history).entries[(*history).first];
+  const StateEntry *newest = &(*history).entries[((*history).first + (*history).count - 1) % STATE_HISTORY_ENTRIES];
+  double seconds = ((*newest).time - (*oldest).time) / 1000.0;
+
+  fprintf(out, "REWIND: %d states over %.1f s in %llu bytes, %.0f bytes/s (%.1fx smaller than raw states)\n",
+          (*history).count, seconds, (unsigned long long) bytes, seconds > 0 ? bytes / seconds : 0.0,
+          bytes > 0 ? (double) (*history).count * sizeof(SimState) / bytes : 0.0);
+}
+
+/**
+ * This function will free the history
+ *
+ * @param history the history
+ *
+ * @return void
+ */
+void stateHistoryDestroy (StateHistory *history)
+{
+  memFree(MEM_SAVE, (*history).pool);
+  (*history).pool = NULL;
+  (*history).count = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL.h>
+#include "game.h"
+#include "sim.h"
+
+#define STATE_RECORD_MS 16 // a state is recorded about 60 times a second
+#define STATE_HISTORY_ENTRIES 2048 // a little over 30 seconds of rewind
+#define STATE_KEYFRAME_INTERVAL 64 // every this many entries one is stored whole, so a restore decodes at most this many
+#define STATE_POOL_SIZE 128 * 1024 // bytes of compressed history
+#define STATE_MAX_PACKED (sizeof(SimState) + sizeof(SimState) / 128 + 1) // worst case after compression
+
+// the whole simulation in fixed-width fields with no hidden padding, so it can be copied, XORed and hashed as bytes
+typedef struct
+{
+  Uint32 lastMoveTime;
+  Uint32 lastAnimationFrame;
+  Sint32 chunkX, chunkY; // the world chunk, 0 0 on the hand-made maps
+  Sint16 x, y;
+  Uint8 direction;
+  Uint8 chooseMap;
+  Uint8 gameState;
+  Uint8 menuState;
+  Uint8 loadError;
+  Uint8 currentFrame;
+  Sint8 musicSelector;
+  Uint8 reserved;
+  Uint8 map[MAP_ROWS][MAP_COLS]; // tile ids, which are always below MAX_TILE_IDS
+  Uint8 padding[2];
+} SimState;
+
+// one recorded state, stored XORed against the entry before it unless it is a keyframe
+typedef struct
+{
+  Uint32 time;
+  Uint32 offset; // where the compressed bytes start in the pool
+  Uint16 size;
+  bool keyframe;
+  Uint32 hash; // low half of the state's hash, checked when it is restored
+} StateEntry;
+
+// a ring of compressed states for rewind, plus one in-memory save slot
+typedef struct
+{
+  Uint8 *pool;
+  Uint32 writeOffset;
+  StateEntry entries[STATE_HISTORY_ENTRIES];
+  int first; // oldest entry, always a keyframe
+  int count;
+  int sinceKeyframe; // entries recorded since the newest keyframe
+  SimState last; // what the newest entry decodes to
+  Uint32 lastRecord;
+  SimState saveSlot;
+  bool hasSave;
+  bool rewinding; // set while the rewind key is held
+} StateHistory;
+
+void statePack(const GameInstance *instance, SimState *state);
+void stateUnpack(const SimState *state, GameInstance *instance);
+Uint64 stateHash(const SimState *state);
+Uint64 gameInstanceHash(const GameInstance *instance);
+
+bool stateHistoryInit(StateHistory *history);
+void stateHistoryRecord(StateHistory *history, const GameInstance *instance, Uint32 now);
+bool stateHistoryRewind(StateHistory *history, GameInstance *instance);
+void stateHistorySave(StateHistory *history, const GameInstance *instance);
+bool stateHistoryLoad(StateHistory *history, GameInstance *instance);
+void stateHistoryPrintReport(const StateHistory *history, FILE *out);
+void stateHistoryDestroy(StateHistory *history);
+
+#endif
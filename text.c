@@ -0,0 +1,470 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_image.h>
+#include "alloc.h"
+#include "text.h"
+#include "renderstats.h"
+
+// the built-in font, used when there is no font atlas, glyphs are 3x5 in a 4x6 cell
+#define BUILTIN_CELL_WIDTH 4
+#define BUILTIN_CELL_HEIGHT 6
+
+// each glyph is five rows of three pixels, one octal digit per row from the top, the high bit on the left
+// lowercase letters are drawn with the uppercase glyphs
+static const Uint16 builtinGlyphs[FONT_CHAR_COUNT] =
+{
+  [' ' - FONT_FIRST_CHAR] = 0,
+  ['!' - FONT_FIRST_CHAR] = 022202, ['\'' - FONT_FIRST_CHAR] = 022000, ['(' - FONT_FIRST_CHAR] = 024442,
+  [')' - FONT_FIRST_CHAR] = 021112, ['+' - FONT_FIRST_CHAR] = 002720, [',' - FONT_FIRST_CHAR] = 000024,
+  ['-' - FONT_FIRST_CHAR] = 000700, ['.' - FONT_FIRST_CHAR] = 000002, ['/' - FONT_FIRST_CHAR] = 011244,
+  ['%' - FONT_FIRST_CHAR] = 051245, [':' - FONT_FIRST_CHAR] = 002020, ['<' - FONT_FIRST_CHAR] = 012421,
+  ['=' - FONT_FIRST_CHAR] = 007070, ['>' - FONT_FIRST_CHAR] = 042124, ['?' - FONT_FIRST_CHAR] = 061202,
+  ['_' - FONT_FIRST_CHAR] = 000007,
+  ['0' - FONT_FIRST_CHAR] = 075557, ['1' - FONT_FIRST_CHAR] = 026227, ['2' - FONT_FIRST_CHAR] = 071747,
+  ['3' - FONT_FIRST_CHAR] = 071317, ['4' - FONT_FIRST_CHAR] = 055711, ['5' - FONT_FIRST_CHAR] = 074717,
+  ['6' - FONT_FIRST_CHAR] = 074757, ['7' - FONT_FIRST_CHAR] = 071122, ['8' - FONT_FIRST_CHAR] = 075757,
+  ['9' - FONT_FIRST_CHAR] = 075717,
+  ['A' - FONT_FIRST_CHAR] = 025755, ['B' - FONT_FIRST_CHAR] = 065656, ['C' - FONT_FIRST_CHAR] = 034443,
+  ['D' - FONT_FIRST_CHAR] = 065556, ['E' - FONT_FIRST_CHAR] = 074647, ['F' - FONT_FIRST_CHAR] = 074644,
+  ['G' - FONT_FIRST_CHAR] = 034553, ['H' - FONT_FIRST_CHAR] = 055755, ['I' - FONT_FIRST_CHAR] = 072227,
+  ['J' - FONT_FIRST_CHAR] = 011152, ['K' - FONT_FIRST_CHAR] = 055655, ['L' - FONT_FIRST_CHAR] = 044447,
+  ['M' - FONT_FIRST_CHAR] = 057755, ['N' - FONT_FIRST_CHAR] = 065555, ['O' - FONT_FIRST_CHAR] = 025552,
+  ['P' - FONT_FIRST_CHAR] = 065644, ['Q' - FONT_FIRST_CHAR] = 025563, ['R' - FONT_FIRST_CHAR] = 065655,
+  ['S' - FONT_FIRST_CHAR] = 034216, ['T' - FONT_FIRST_CHAR] = 072222, ['U' - FONT_FIRST_CHAR] = 055557,
+  ['V' - FONT_FIRST_CHAR] = 055552, ['W' - FONT_FIRST_CHAR] = 055775, ['X' - FONT_FIRST_CHAR] = 055255,
+  ['Y' - FONT_FIRST_CHAR] = 055222, ['Z' - FONT_FIRST_CHAR] = 071247,
+};
+
+/**
+ * This function will find the atlas cell for a character
+ *
+ * @param text the text renderer
+ * @param character the character
+ *
+ * @return int the cell, unknown characters get the '?' cell
+ */
+static int glyphOf (const TextRenderer *text, unsigned char character)
+{
+  // the built-in font only has capitals
+  if ((*text).builtin && character >= 'a' && character <= 'z')
+  {
+    character = (unsigned char) (character - 'a' + 'A');
+  }
+  if (character < FONT_FIRST_CHAR || character >= FONT_FIRST_CHAR + FONT_CHAR_COUNT)
+  {
+    character = '?';
+  }
+  return character - FONT_FIRST_CHAR;
+}
+
+/**
+ * This function will bake the built-in font into an atlas texture
+ *
+ * @param text the text renderer
+ * @param renderer the renderer that owns the texture
+ *
+ * @return bool whether the texture was created
+ */
+static bool createBuiltinAtlas (TextRenderer *text, SDL_Renderer *renderer)
+{
+  enum { WIDTH = FONT_COLUMNS * BUILTIN_CELL_WIDTH, HEIGHT = FONT_ROWS * BUILTIN_CELL_HEIGHT };
+  static Uint32 pixels[HEIGHT][WIDTH];
+  memset(pixels, 0, sizeof(pixels));
+
+  for (int glyph = 0; glyph < FONT_CHAR_COUNT; ++glyph)
+  {
+    int cellX = (glyph % FONT_COLUMNS) * BUILTIN_CELL_WIDTH;
+    int cellY = (glyph / FONT_COLUMNS) * BUILTIN_CELL_HEIGHT;
+
+    for (int row = 0; row < 5; ++row)
+    {
+      int bits = (builtinGlyphs[glyph] >> ((4 - row) * 3)) & 7;
+      for (int col = 0; col < 3; ++col)
+      {
+        if (bits & (4 >> col))
+        {
+          pixels[cellY + row][cellX + col] = 0xFFFFFFFF; // white, tinted by the vertex color
+        }
+      }
+    }
+  }
+
+  (*text).atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, WIDTH, HEIGHT);
+  if ((*text).atlas == NULL)
+  {
+    fprintf(stderr, "Font atlas could not be created! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+  renderUpdateTexture((*text).atlas, NULL, pixels, WIDTH * (int) sizeof(Uint32));
+  SDL_SetTextureBlendMode((*text).atlas, SDL_BLENDMODE_BLEND);
+
+  (*text).atlasWidth = WIDTH;
+  (*text).atlasHeight = HEIGHT;
+  (*text).cellWidth = BUILTIN_CELL_WIDTH;
+  (*text).cellHeight = BUILTIN_CELL_HEIGHT;
+  (*text).builtin = true;
+  return true;
+}
+
+/**
+ * This function will return every cached layout to the pool
+ *
+ * @param text the text renderer
+ *
+ * @return void
+ */
+static void releaseRuns (TextRenderer *text)
+{
+  for (int i = 0; i < TEXT_MAX_RUNS; ++i)
+  {
+    if ((*text).runs[i] != NULL)
+    {
+      objectPoolRelease(&(*text).runPool, (*text).runs[i]);
+      (*text).runs[i] = NULL;
+    }
+  }
+}
+
+/**
+ * This function will set up the text renderer with a font atlas
+ *
+ * @param text the text renderer
+ * @param renderer the renderer that will draw the text
+ * @param fontPath the font atlas, the built-in font is used if it cannot be loaded
+ *
+ * @return bool whether text can be drawn
+ */
+bool textInit (TextRenderer *text, SDL_Renderer *renderer, const char *fontPath)
+{
+  memset(text, 0, sizeof(*text));
+
+  bool pooled = POOL_INIT(&(*text).runPool, TextRun, TEXT_MAX_RUNS, MEM_RENDER);
+  (*text).vertices = memAlloc(MEM_RENDER, TEXT_MAX_BATCH_GLYPHS * 4 * sizeof(SDL_Vertex));
+  (*text).indices = memAlloc(MEM_RENDER, TEXT_MAX_BATCH_GLYPHS * 6 * sizeof(int));
+  if (!pooled || (*text).vertices == NULL || (*text).indices == NULL)
+  {
+    fprintf(stderr, "Text buffers could not be allocated!\n");
+    textDestroy(text);
+    return false;
+  }
+
+  // every glyph is a quad of two triangles
+  for (int i = 0; i < TEXT_MAX_BATCH_GLYPHS; ++i)
+  {
+    int *quad = &(*text).indices[i * 6];
+    quad[0] = i * 4;
+    quad[1] = i * 4 + 1;
+    quad[2] = i * 4 + 2;
+    quad[3] = i * 4 + 2;
+    quad[4] = i * 4 + 1;
+    quad[5] = i * 4 + 3;
+  }
+
+  // the atlas is a grid of equal cells, so the cell size follows from the texture size
+  (*text).atlas = fontPath != NULL ? IMG_LoadTexture(renderer, fontPath) : NULL;
+  if ((*text).atlas != NULL)
+  {
+    SDL_QueryTexture((*text).atlas, NULL, NULL, &(*text).atlasWidth, &(*text).atlasHeight);
+    (*text).cellWidth = (*text).atlasWidth / FONT_COLUMNS;
+    (*text).cellHeight = (*text).atlasHeight / FONT_ROWS;
+    SDL_SetTextureBlendMode((*text).atlas, SDL_BLENDMODE_BLEND);
+    return true;
+  }
+
+  if (!createBuiltinAtlas(text, renderer))
+  {
+    textDestroy(text);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * This function will swap in a new font atlas, the laid out strings are dropped since their cells may have changed
+ *
+ * @param text the text renderer
+ * @param renderer the renderer that draws the text
+ * @param surface the decoded font atlas, the caller still owns it
+ *
+ * @return bool false if the texture could not be made, the old atlas is kept
+ */
+bool textReplaceAtlas (TextRenderer *text, SDL_Renderer *renderer, SDL_Surface *surface)
+{
+  SDL_Texture *atlas = SDL_CreateTextureFromSurface(renderer, surface);
+  if (atlas == NULL)
+  {
+    fprintf(stderr, "Font atlas could not be replaced! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  if ((*text).atlas != NULL)
+  {
+    SDL_DestroyTexture((*text).atlas);
+  }
+  (*text).atlas = atlas;
+  (*text).atlasWidth = (*surface).w;
+  (*text).atlasHeight = (*surface).h;
+  (*text).cellWidth = (*text).atlasWidth / FONT_COLUMNS;
+  (*text).cellHeight = (*text).atlasHeight / FONT_ROWS;
+  (*text).builtin = false;
+  SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+  releaseRuns(text);
+  return true;
+}
+
+/**
+ * This function will measure the widest line of a string
+ *
+ * @param text the text renderer
+ * @param string the string
+ *
+ * @return int the width in pixels
+ */
+int textWidth (const TextRenderer *text, const char *string)
+{
+  int widest = 0;
+  int line = 0;
+
+  for (const char *c = string; *c != '\0'; ++c)
+  {
+    line = *c == '\n' ? 0 : line + 1;
+    widest = max(widest, line);
+  }
+
+  return widest * (*text).cellWidth;
+}
+
+/**
+ * This function will lay a string out into glyphs, breaking lines at '\n' and wrapping words
+ *
+ * @param text the text renderer
+ * @param string the string
+ * @param wrapWidth the widest a line may be in pixels, 0 for no wrapping
+ * @param glyphs the glyphs laid out
+ * @param maxGlyphs the room in glyphs
+ *
+ * @return int the number of glyphs, spaces take no glyph
+ */
+static int shapeText (const TextRenderer *text, const char *string, int wrapWidth, TextGlyph *glyphs, int maxGlyphs)
+{
+  int count = 0;
+  int x = 0;
+  int y = 0;
+
+  for (const char *c = string; *c != '\0' && count < maxGlyphs; ++c)
+  {
+    if (*c == '\n')
+    {
+      x = 0;
+      y += (*text).cellHeight;
+      continue;
+    }
+
+    if (*c == ' ')
+    {
+      // wrap before a word that would run past the edge
+      int word = 0;
+      while (c[word + 1] != '\0' && c[word + 1] != ' ' && c[word + 1] != '\n')
+      {
+        ++word;
+      }
+      if (wrapWidth > 0 && x > 0 && x + (word + 1) * (*text).cellWidth > wrapWidth)
+      {
+        x = 0;
+        y += (*text).cellHeight;
+      }
+      else
+      {
+        x += (*text).cellWidth;
+      }
+      continue;
+    }
+
+    glyphs[count].x = (Sint16) x;
+    glyphs[count].y = (Sint16) y;
+    glyphs[count].glyph = (Uint8) glyphOf(text, (unsigned char) *c);
+    ++count;
+    x += (*text).cellWidth;
+  }
+
+  return count;
+}
+
+/**
+ * This function will queue laid out glyphs for the next flush
+ *
+ * @param text the text renderer
+ * @param glyphs the glyphs
+ * @param count the number of glyphs
+ * @param x where the run starts
+ * @param y where the run starts
+ * @param color the text color
+ *
+ * @return void
+ */
+static void queueGlyphs (TextRenderer *text, const TextGlyph *glyphs, int count, int x, int y, SDL_Color color)
+{
+  float cellU = (float) (*text).cellWidth / (*text).atlasWidth;
+  float cellV = (float) (*text).cellHeight / (*text).atlasHeight;
+
+  for (int i = 0; i < count && (*text).glyphCount < TEXT_MAX_BATCH_GLYPHS; ++i)
+  {
+    SDL_Vertex *quad = &(*text).vertices[(*text).glyphCount++ * 4];
+    float left = (float) (x + glyphs[i].x);
+    float top = (float) (y + glyphs[i].y);
+    float u = (glyphs[i].glyph % FONT_COLUMNS) * cellU;
+    float v = (glyphs[i].glyph / FONT_COLUMNS) * cellV;
+
+    quad[0] = (SDL_Vertex) {{left, top}, color, {u, v}};
+    quad[1] = (SDL_Vertex) {{left + (*text).cellWidth, top}, color, {u + cellU, v}};
+    quad[2] = (SDL_Vertex) {{left, top + (*text).cellHeight}, color, {u, v + cellV}};
+    quad[3] = (SDL_Vertex) {{left + (*text).cellWidth, top + (*text).cellHeight}, color, {u + cellU, v + cellV}};
+  }
+}
+
+/**
+ * This function will queue a string that changes from frame to frame, it is laid out again every call
+ *
+ * @param text the text renderer
+ * @param string the string
+ * @param x where the string starts
+ * @param y where the string starts
+ * @param wrapWidth the widest a line may be in pixels, 0 for no wrapping
+ * @param color the text color
+ *
+ * @return void
+ */
+void textDraw (TextRenderer *text, const char *string, int x, int y, int wrapWidth, SDL_Color color)
+{
+  if ((*text).atlas == NULL)
+  {
+    return;
+  }
+
+  TextGlyph glyphs[TEXT_MAX_RUN_GLYPHS];
+  int count = shapeText(text, string, wrapWidth, glyphs, TEXT_MAX_RUN_GLYPHS);
+  queueGlyphs(text, glyphs, count, x, y, color);
+}
+
+/**
+ * This function will queue a string that rarely changes, such as a menu item or a line of dialogue
+ *
+ * The layout is cached, the least recently drawn run makes room when the cache is full.
+ *
+ * @param text the text renderer
+ * @param string the string
+ * @param x where the string starts
+ * @param y where the string starts
+ * @param wrapWidth the widest a line may be in pixels, 0 for no wrapping
+ * @param color the text color
+ *
+ * @return void
+ */
+void textDrawStatic (TextRenderer *text, const char *string, int x, int y, int wrapWidth, SDL_Color color)
+{
+  if ((*text).atlas == NULL)
+  {
+    return;
+  }
+
+  // FNV-1a over the string and the wrap width
+  Uint64 hash = 14695981039346656037ull ^ (Uint64) wrapWidth;
+  for (const char *c = string; *c != '\0'; ++c)
+  {
+    hash = (hash ^ (unsigned char) *c) * 1099511628211ull;
+  }
+  hash |= 1;
+
+  // look for the run, remembering a free slot or else the least recently drawn one
+  int pick = -1;
+  for (int i = 0; i < TEXT_MAX_RUNS; ++i)
+  {
+    TextRun *run = (*text).runs[i];
+    if (run == NULL)
+    {
+      if (pick < 0 || (*text).runs[pick] != NULL)
+      {
+        pick = i;
+      }
+      continue;
+    }
+    if ((*run).hash == hash && (*run).wrapWidth == wrapWidth && strcmp((*run).text, string) == 0)
+    {
+      (*run).lastUsed = (*text).flushes;
+      queueGlyphs(text, (*run).glyphs, (*run).glyphCount, x, y, color);
+      return;
+    }
+    if (pick < 0 || ((*text).runs[pick] != NULL && (*run).lastUsed < (*(*text).runs[pick]).lastUsed))
+    {
+      pick = i;
+    }
+  }
+
+  // strings too long to cache are laid out every time
+  if (strlen(string) > TEXT_MAX_RUN_GLYPHS)
+  {
+    textDraw(text, string, x, y, wrapWidth, color);
+    return;
+  }
+
+  // the least recently drawn run goes back to the pool to make room, so the pool never runs dry
+  if ((*text).runs[pick] != NULL)
+  {
+    objectPoolRelease(&(*text).runPool, (*text).runs[pick]);
+  }
+  TextRun *slot = POOL_ACQUIRE(&(*text).runPool, TextRun);
+  (*text).runs[pick] = slot;
+  if (slot == NULL)
+  {
+    textDraw(text, string, x, y, wrapWidth, color);
+    return;
+  }
+
+  (*slot).hash = hash;
+  strcpy((*slot).text, string);
+  (*slot).wrapWidth = wrapWidth;
+  (*slot).glyphCount = shapeText(text, string, wrapWidth, (*slot).glyphs, TEXT_MAX_RUN_GLYPHS);
+  (*slot).lastUsed = (*text).flushes;
+  queueGlyphs(text, (*slot).glyphs, (*slot).glyphCount, x, y, color);
+}
+
+/**
+ * This function will draw every queued glyph with a single geometry call
+ *
+ * @param text the text renderer
+ * @param renderer the renderer
+ *
+ * @return void
+ */
+void textFlush (TextRenderer *text, SDL_Renderer *renderer)
+{
+  if ((*text).glyphCount > 0)
+  {
+    renderGeometry(renderer, (*text).atlas, (*text).vertices, (*text).glyphCount * 4,
+                   (*text).indices, (*text).glyphCount * 6);
+  }
+  (*text).glyphCount = 0;
+  ++(*text).flushes;
+}
+
+/**
+ * This function will free the atlas and the text buffers
+ *
+ * @param text the text renderer
+ *
+ * @return void
+ */
+void textDestroy (TextRenderer *text)
+{
+  if ((*text).atlas != NULL)
+  {
+    SDL_DestroyTexture((*text).atlas);
+  }
+  releaseRuns(text);
+  objectPoolDestroy(&(*text).runPool);
+  memFree(MEM_RENDER, (*text).vertices);
+  memFree(MEM_RENDER, (*text).indices);
+  memset(text, 0, sizeof(*text));
+}
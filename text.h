@@ -0,0 +1,59 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "game.h"
+#include "alloc.h"
+
+#define FONT_PATH "assets/textures/font/font.png" // 16 columns by 6 rows of glyphs, ASCII 32 to 127
+#define FONT_FIRST_CHAR 32
+#define FONT_CHAR_COUNT 96
+#define FONT_COLUMNS 16
+#define FONT_ROWS 6
+#define TEXT_MAX_RUNS 64 // static strings whose layout is kept
+#define TEXT_MAX_RUN_GLYPHS 128
+#define TEXT_MAX_BATCH_GLYPHS 1024 // glyphs drawn by a single flush
+
+// one glyph placed in a run, relative to the run's origin
+typedef struct
+{
+  Sint16 x, y;
+  Uint8 glyph; // atlas cell
+} TextGlyph;
+
+// a laid out string, kept so static text is only shaped once
+typedef struct
+{
+  Uint64 hash; // of the string and the wrap width, 0 for an unused slot
+  char text[TEXT_MAX_RUN_GLYPHS + 1];
+  int wrapWidth;
+  int glyphCount;
+  TextGlyph glyphs[TEXT_MAX_RUN_GLYPHS];
+  Uint32 lastUsed; // flush count when the run was last drawn
+} TextRun;
+
+// draws strings from one glyph atlas, every string queued in a frame goes out in one geometry call
+typedef struct
+{
+  SDL_Texture *atlas;
+  int atlasWidth, atlasHeight;
+  int cellWidth, cellHeight; // glyph cell size, which is also the advance and the line height
+  bool builtin; // the built-in font, which only has capitals
+  TextRun *runs[TEXT_MAX_RUNS]; // the cached layouts, NULL for a free slot
+  ObjectPool runPool; // where the cached layouts come from, an evicted one goes back
+  SDL_Vertex *vertices;
+  int *indices; // the same two triangles per glyph, filled in once
+  int glyphCount; // glyphs queued since the last flush
+  Uint32 flushes;
+} TextRenderer;
+
+bool textInit(TextRenderer *text, SDL_Renderer *renderer, const char *fontPath);
+bool textReplaceAtlas(TextRenderer *text, SDL_Renderer *renderer, SDL_Surface *surface);
+int textWidth(const TextRenderer *text, const char *string);
+void textDraw(TextRenderer *text, const char *string, int x, int y, int wrapWidth, SDL_Color color);
+void textDrawStatic(TextRenderer *text, const char *string, int x, int y, int wrapWidth, SDL_Color color);
+void textFlush(TextRenderer *text, SDL_Renderer *renderer);
+void textDestroy(TextRenderer *text);
+
+#endif
@@ -0,0 +1,329 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_image.h>
+#include "tiles.h"
+#include "renderstats.h"
+
+/**
+ * This function will determine whether the player can stand on a tile, anything else is a wall
+ *
+ * @param tile the tile id
+ *
+ * @return bool whether the tile is walkable
+ */
+bool tileIsWalkable (int tile)
+{
+  switch (tile)
+  {
+    case 0:
+    case 2:
+    case 3:
+    case 4:
+    case 5:
+    case 6:
+    case 7:
+    case 12:
+    case 13:
+      return true;
+    default: // default is that the texture is a wall
+      return false;
+  }
+}
+
+/**
+ * This function will set up the frame table so every tile id draws its own texture
+ *
+ * @param table the frame table to set up
+ *
+ * @return void
+ */
+void tileFrameTableInit (TileFrameTable *table)
+{
+  for (int i = 0; i < MAX_TILE_IDS; ++i)
+  {
+    table->frame[i] = i;
+  }
+  table->animationCount = 0;
+}
+
+/**
+ * This function will load the animated tile definitions and their frame textures
+ *
+ * Each line of the file is "<tile id> <milliseconds per frame> <frame png> <frame png> ...".
+ * Lines starting with '#' are comments. The frame textures are appended after the textures
+ * that are already loaded, and the tile id keeps whatever collision and warp behaviour it has.
+ *
+ * @param table the frame table to add the animations to
+ * @param path the definition file to read
+ * @param renderer the renderer that will be used to load the textures
+ * @param textures the array of game textures to append to
+ * @param textureCount the number of textures already loaded
+ * @param tileSet the tile set the frames are stored in as palette indices, NULL to load them as they are
+ *
+ * @return int the number of textures loaded in total
+ */
+int loadTileAnimations (TileFrameTable *table, const char *path, SDL_Renderer **renderer,
+                        SDL_Texture **textures, int textureCount, TileSet *tileSet)
+{
+  // animated tiles are optional, so a missing file just means there are none
+  FILE *file = fopen(path, "r");
+  if (file == NULL)
+  {
+    return textureCount;
+  }
+
+  char line[1024];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    ++lineNumber;
+
+    char *token = strtok(line, " \t\r\n");
+    if (token == NULL || token[0] == '#')
+    {
+      continue;
+    }
+
+    if (table->animationCount == MAX_ANIMATED_TILES)
+    {
+      fprintf(stderr, "Too many animated tiles in %s, ignoring line %d\n", path, lineNumber);
+      break;
+    }
+
+    TileAnimation *animation = &table->animations[table->animationCount];
+    animation->tileId = atoi(token);
+    token = strtok(NULL, " \t\r\n");
+    animation->frameDuration = token != NULL ? (Uint32) atoi(token) : 0;
+    animation->frameCount = 0;
+
+    if (animation->tileId < 0 || animation->tileId >= MAX_TILE_IDS || animation->frameDuration == 0)
+    {
+      fprintf(stderr, "Invalid animated tile on line %d of %s\n", lineNumber, path);
+      continue;
+    }
+
+    // load every frame texture listed on the line
+    while ((token = strtok(NULL, " \t\r\n")) != NULL && animation->frameCount < MAX_TILE_FRAMES
+           && textureCount < MAX_GAME_TEXTURES)
+    {
+      SDL_Texture *texture = tileSet != NULL ? tileSetLoadImage(tileSet, *renderer, token) : IMG_LoadTexture(*renderer, token);
+      if (texture == NULL)
+      {
+        fprintf(stderr, "Animated tile frame %s could not be loaded! SDL_image Error: %s\n", token, IMG_GetError());
+        continue;
+      }
+
+      textures[textureCount] = texture;
+      animation->frames[animation->frameCount++] = textureCount++;
+    }
+
+    if (animation->frameCount > 0)
+    {
+      table->frame[animation->tileId] = animation->frames[0];
+      ++table->animationCount;
+    }
+  }
+
+  fclose(file);
+  return textureCount;
+}
+
+/**
+ * This function will move every animated tile to its frame for this tick, run once per tick
+ *
+ * @param table the frame table to advance
+ * @param now the current time in milliseconds
+ *
+ * @return bool whether any tile changed frame
+ */
+bool tileFrameTableAdvance (TileFrameTable *table, Uint32 now)
+{
+  bool changed = false;
+
+  // frames are picked from the clock rather than stepped, so every tile stays in sync after a stall
+  for (int i = 0; i < table->animationCount; ++i)
+  {
+    TileAnimation *animation = &table->animations[i];
+    int frame = animation->frames[(now / animation->frameDuration) % animation->frameCount];
+    if (table->frame[animation->tileId] != frame)
+    {
+      table->frame[animation->tileId] = frame;
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * This function will find how long it is until any animated tile shows its next frame
+ *
+ * @param table the frame table
+ * @param now the current time in milliseconds
+ *
+ * @return Uint32 milliseconds until the next frame change, UINT32_MAX when nothing is animated
+ */
+Uint32 tileFrameTableNextChange (const TileFrameTable *table, Uint32 now)
+{
+  Uint32 wait = UINT32_MAX;
+  for (int i = 0; i < table->animationCount; ++i)
+  {
+    const TileAnimation *animation = &table->animations[i];
+    if (animation->frameCount > 1)
+    {
+      wait = min(wait, animation->frameDuration - now % animation->frameDuration);
+    }
+  }
+  return wait;
+}
+
+/**
+ * This function will create the texture the map is baked into
+ *
+ * @param layer the map layer to set up
+ * @param renderer the renderer the layer belongs to
+ *
+ * @return bool whether the layer can be used, if not the map is drawn tile by tile
+ */
+bool mapLayerInit (MapLayer *layer, SDL_Renderer *renderer)
+{
+  layer->texture = NULL;
+  mapLayerInvalidate(layer);
+
+  if (!SDL_RenderTargetSupported(renderer))
+  {
+    return false;
+  }
+
+  layer->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                     MAP_COLS * TILE_WIDTH, MAP_ROWS * TILE_HEIGHT);
+  if (layer->texture == NULL)
+  {
+    fprintf(stderr, "Map layer could not be created! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * This function will force every cell of the layer to be baked again
+ *
+ * @param layer the map layer
+ *
+ * @return void
+ */
+void mapLayerInvalidate (MapLayer *layer)
+{
+  memset(layer->baked, -1, sizeof(layer->baked));
+}
+
+/**
+ * This function will re-bake only the cells whose texture differs from what is already baked
+ *
+ * A map switch or edit changes the tile id, an animation changes the frame, both show up here.
+ *
+ * @param layer the map layer
+ * @param renderer the renderer the layer belongs to
+ * @param map the current map
+ * @param table the frame table for this tick
+ * @param textures the game textures
+ *
+ * @return int the number of cells that were re-baked
+ */
+int mapLayerUpdate (MapLayer *layer, SDL_Renderer *renderer, int map[MAP_ROWS][MAP_COLS],
+                    const TileFrameTable *table, SDL_Texture **textures)
+{
+  if (layer->texture == NULL)
+  {
+    return 0;
+  }
+
+  int rebaked = 0;
+  SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer); // the window, or the frame being recorded
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    for (int col = 0; col < MAP_COLS; ++col)
+    {
+      int texture = table->frame[map[row][col]];
+      if (layer->baked[row][col] == texture)
+      {
+        continue;
+      }
+
+      // only switch targets once a cell actually needs work
+      if (rebaked == 0)
+      {
+        renderSetTarget(renderer, layer->texture);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+      }
+
+      // clear the cell first so tiles with transparency do not blend over the old frame
+      SDL_Rect srcRect = {0, 0, TILE_WIDTH, TILE_HEIGHT};
+      SDL_Rect destRect = {col * TILE_WIDTH, row * TILE_HEIGHT, TILE_WIDTH, TILE_HEIGHT};
+      renderFillRect(renderer, &destRect);
+      renderCopy(renderer, textures[texture], &srcRect, &destRect);
+
+      layer->baked[row][col] = texture;
+      ++rebaked;
+    }
+  }
+
+  if (rebaked > 0)
+  {
+    renderSetTarget(renderer, previousTarget);
+  }
+
+  return rebaked;
+}
+
+/**
+ * This function will draw the map, from the baked layer when there is one
+ *
+ * @param layer the map layer
+ * @param renderer the renderer to draw with
+ * @param map the current map, used when there is no baked layer
+ * @param table the frame table for this tick
+ * @param textures the game textures
+ *
+ * @return void
+ */
+void mapLayerDraw (MapLayer *layer, SDL_Renderer *renderer, int map[MAP_ROWS][MAP_COLS],
+                   const TileFrameTable *table, SDL_Texture **textures)
+{
+  if (layer->texture != NULL)
+  {
+    renderCopy(renderer, layer->texture, NULL, NULL);
+    return;
+  }
+
+  // without render targets, draw each tile directly, an animated tile costs the same as a static one
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    for (int col = 0; col < MAP_COLS; ++col)
+    {
+      SDL_Rect srcRect = {0, 0, TILE_WIDTH, TILE_HEIGHT}; // Source rectangle for the texture
+      SDL_Rect destRect = {col * TILE_WIDTH, row * TILE_HEIGHT, TILE_WIDTH, TILE_HEIGHT}; // Destination rectangle on screen
+      renderCopy(renderer, textures[table->frame[map[row][col]]], &srcRect, &destRect);
+    }
+  }
+}
+
+/**
+ * This function will free the map layer texture
+ *
+ * @param layer the map layer
+ *
+ * @return void
+ */
+void mapLayerDestroy (MapLayer *layer)
+{
+  if (layer->texture != NULL)
+  {
+    SDL_DestroyTexture(layer->texture);
+    layer->texture = NULL;
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdbool.h>
+#include <SDL.h>
+#include "game.h"
+#include "palette.h"
+
+#define MAX_TILE_IDS 256 // tile ids a map cell can hold
+#define MAX_ANIMATED_TILES 64
+#define MAX_TILE_FRAMES 16
+#define ANIMATED_TILES_PATH "assets/data/animated_tiles.txt"
+
+// one animated tile, a tile id that cycles through a sequence of textures
+typedef struct
+{
+  int tileId;
+  Uint32 frameDuration; // milliseconds each frame is shown
+  int frameCount;
+  int frames[MAX_TILE_FRAMES]; // indices into the game textures
+} TileAnimation;
+
+// the texture every tile id should be drawn with this tick, shared by every cell using that id
+typedef struct
+{
+  int frame[MAX_TILE_IDS];
+  TileAnimation animations[MAX_ANIMATED_TILES];
+  int animationCount;
+} TileFrameTable;
+
+// the whole map baked into one texture, so a frame costs a single copy
+typedef struct
+{
+  SDL_Texture *texture; // NULL if the renderer cannot render to textures
+  int baked[MAP_ROWS][MAP_COLS]; // texture index currently baked into each cell, -1 if none yet
+} MapLayer;
+
+bool tileIsWalkable(int tile);
+
+void tileFrameTableInit(TileFrameTable *table);
+int loadTileAnimations(TileFrameTable *table, const char *path, SDL_Renderer **renderer,
+                       SDL_Texture **textures, int textureCount, TileSet *tileSet);
+bool tileFrameTableAdvance(TileFrameTable *table, Uint32 now);
+Uint32 tileFrameTableNextChange(const TileFrameTable *table, Uint32 now);
+
+bool mapLayerInit(MapLayer *layer, SDL_Renderer *renderer);
+void mapLayerInvalidate(MapLayer *layer);
+int mapLayerUpdate(MapLayer *layer, SDL_Renderer *renderer, int map[MAP_ROWS][MAP_COLS],
+                   const TileFrameTable *table, SDL_Texture **textures);
+void mapLayerDraw(MapLayer *layer, SDL_Renderer *renderer, int map[MAP_ROWS][MAP_COLS],
+                  const TileFrameTable *table, SDL_Texture **textures);
+void mapLayerDestroy(MapLayer *layer);
+
+#endif
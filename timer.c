@@ -0,0 +1,439 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <string.h>
+#include "game.h"
+#include "alloc.h"
+#include "timer.h"
+
+#define FIRING_HEAD (TIMER_HEADS - 1) // the list a slot's timers are moved to while they fire
+
+/**
+ * This function will read the monotonic high-resolution clock the timers run on
+ *
+ * @return Uint64 milliseconds since an unspecified start, never going backwards
+ */
+Uint64 timerNow (void)
+{
+  return SDL_GetPerformanceCounter() / (SDL_GetPerformanceFrequency() / 1000);
+}
+
+/**
+ * This function will link a node onto the end of a list
+ *
+ * @param wheel the wheel the node belongs to
+ * @param head the list head
+ * @param node the node to link
+ *
+ * @return void
+ */
+static void listAppend (TimerWheel *wheel, int head, int node)
+{
+  TimerNode *nodes = (*wheel).nodes;
+  nodes[node].head = head;
+  nodes[node].next = head;
+  nodes[node].prev = nodes[head].prev;
+  nodes[nodes[head].prev].next = node;
+  nodes[head].prev = node;
+}
+
+/**
+ * This function will take a node out of its list, and clear the slot's bit when it was the last one
+ *
+ * @param wheel the wheel the node belongs to
+ * @param node the node to unlink
+ *
+ * @return void
+ */
+static void listUnlink (TimerWheel *wheel, int node)
+{
+  TimerNode *nodes = (*wheel).nodes;
+  int head = nodes[node].head;
+  nodes[nodes[node].prev].next = nodes[node].next;
+  nodes[nodes[node].next].prev = nodes[node].prev;
+  nodes[node].next = nodes[node].prev = node;
+
+  if (head != FIRING_HEAD && nodes[head].next == head)
+  {
+    (*wheel).occupied[head / TIMER_SLOTS][(head % TIMER_SLOTS) / 64] &= ~(1ull << (head % 64));
+  }
+}
+
+/**
+ * This function will put a timer in the slot its deadline falls in
+ *
+ * a timer less than 256 ms away goes in the first level, one less than 65536 ms away in the second, and so on,
+ * each slot of a higher level is moved down a level when the wheel reaches it
+ *
+ * @param wheel the wheel to place the timer in
+ * @param node the timer, its deadline is not before the wheel's current time
+ *
+ * @return void
+ */
+static void place (TimerWheel *wheel, int node)
+{
+  Uint64 deadline = (*wheel).nodes[node].deadline;
+  Uint64 delta = deadline > (*wheel).current ? deadline - (*wheel).current : 0;
+
+  int level = 0;
+  while (level < TIMER_LEVELS - 1 && delta >= (1ull << (TIMER_SLOT_BITS * (level + 1))))
+  {
+    ++level;
+  }
+
+  int slot = (int) ((deadline >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1));
+  listAppend(wheel, level * TIMER_SLOTS + slot, node);
+  (*wheel).occupied[level][slot / 64] |= 1ull << (slot % 64);
+}
+
+/**
+ * This function will return a node to the free list, so ids that named it stop matching
+ *
+ * @param wheel the wheel the node belongs to
+ * @param node the node to free, already unlinked
+ *
+ * @return void
+ */
+static void freeNode (TimerWheel *wheel, int node)
+{
+  TimerNode *nodes = (*wheel).nodes;
+  ++nodes[node].generation;
+  nodes[node].head = -1;
+  nodes[node].next = (*wheel).freeList;
+  (*wheel).freeList = node;
+  --(*wheel).activeCount;
+}
+
+/**
+ * This function will find the first level-one slot with timers after the current millisecond
+ *
+ * @param wheel the wheel to search
+ *
+ * @return Uint64 the millisecond that slot is due, UINT64_MAX if every slot is empty
+ */
+static Uint64 nextFirstLevelSlot (const TimerWheel *wheel)
+{
+  // search the bitmap from the slot after the current one, wrapping around once
+  int start = (int) (((*wheel).current + 1) & (TIMER_SLOTS - 1));
+  for (int i = 0; i <= TIMER_SLOTS / 64; ++i)
+  {
+    int word = (start / 64 + i) % (TIMER_SLOTS / 64);
+    Uint64 bits = (*wheel).occupied[0][word];
+    if (i == 0)
+    {
+      bits &= ~0ull << (start % 64);
+    }
+    else if (i == TIMER_SLOTS / 64)
+    {
+      bits &= (start % 64) == 0 ? 0 : ~0ull >> (64 - start % 64);
+    }
+    if (bits != 0)
+    {
+      int slot = word * 64 + __builtin_ctzll(bits);
+      return (*wheel).current + 1 + (Uint64) ((slot - start + TIMER_SLOTS) % TIMER_SLOTS);
+    }
+  }
+  return UINT64_MAX;
+}
+
+/**
+ * This function will set up an empty wheel
+ *
+ * @param wheel the wheel to set up
+ * @param capacity the most timers that can be active at once
+ * @param now the current time in milliseconds
+ *
+ * @return bool true if its memory could be allocated
+ */
+bool timerWheelInit (TimerWheel *wheel, int capacity, Uint64 now)
+{
+  memset(wheel, 0, sizeof(*wheel));
+  (*wheel).nodes = memAlloc(MEM_GENERAL, (size_t) (TIMER_HEADS + capacity) * sizeof(TimerNode));
+  if ((*wheel).nodes == NULL)
+  {
+    fprintf(stderr, "Timer wheel of %d timers could not be allocated\n", capacity);
+    return false;
+  }
+
+  (*wheel).capacity = capacity;
+  (*wheel).current = now;
+  for (int i = 0; i < TIMER_HEADS; ++i)
+  {
+    (*wheel).nodes[i] = (TimerNode) {0};
+    (*wheel).nodes[i].next = (*wheel).nodes[i].prev = (*wheel).nodes[i].head = i;
+  }
+
+  // the free list runs through every timer node in order
+  (*wheel).freeList = -1;
+  for (int i = TIMER_HEADS + capacity - 1; i >= TIMER_HEADS; --i)
+  {
+    (*wheel).nodes[i] = (TimerNode) {0};
+    (*wheel).nodes[i].head = -1;
+    (*wheel).nodes[i].next = (*wheel).freeList;
+    (*wheel).freeList = i;
+  }
+  return true;
+}
+
+/**
+ * This function will start a timer
+ *
+ * @param wheel the wheel to add the timer to
+ * @param delay milliseconds from the wheel's current time until it fires, at least 1
+ * @param period milliseconds between repeats after that, 0 to fire once
+ * @param callback the function to call when it fires, NULL for a timer that is only checked with timerPending
+ * @param userdata handed to the callback
+ *
+ * @return TimerId the timer, TIMER_NONE if the wheel is full
+ */
+TimerId timerSchedule (TimerWheel *wheel, Uint64 delay, Uint32 period, TimerCallback callback, void *userdata)
+{
+  int node = (*wheel).freeList;
+  if (node < 0)
+  {
+    fprintf(stderr, "Timer wheel is full, %d timers are active\n", (*wheel).activeCount);
+    return TIMER_NONE;
+  }
+
+  TimerNode *timer = &(*wheel).nodes[node];
+  (*wheel).freeList = (*timer).next;
+  (*timer).deadline = (*wheel).current + min(max(delay, 1ull), TIMER_MAX_DELAY);
+  (*timer).period = period;
+  (*timer).callback = callback;
+  (*timer).userdata = userdata;
+  ++(*wheel).activeCount;
+  place(wheel, node);
+  return ((Uint64) (*timer).generation << 32) | (Uint64) node;
+}
+
+/**
+ * This function will find the node an id names, if it is still active
+ *
+ * @param wheel the wheel the timer was scheduled on
+ * @param id the timer
+ *
+ * @return int the node, -1 if the timer has fired or been cancelled
+ */
+static int nodeOf (const TimerWheel *wheel, TimerId id)
+{
+  Uint64 node = id & 0xFFFFFFFFull;
+  if (node < TIMER_HEADS || node >= (Uint64) (TIMER_HEADS + (*wheel).capacity))
+  {
+    return -1;
+  }
+
+  const TimerNode *timer = &(*wheel).nodes[node];
+  return (*timer).head >= 0 && (*timer).generation == (Uint32) (id >> 32) ? (int) node : -1;
+}
+
+/**
+ * This function will stop a timer before it fires, or stop a repeating one
+ *
+ * @param wheel the wheel the timer was scheduled on
+ * @param id the timer
+ *
+ * @return bool false if the timer had already fired or been cancelled
+ */
+bool timerCancel (TimerWheel *wheel, TimerId id)
+{
+  int node = nodeOf(wheel, id);
+  if (node < 0)
+  {
+    return false;
+  }
+
+  listUnlink(wheel, node);
+  freeNode(wheel, node);
+  return true;
+}
+
+/**
+ * This function will check whether a timer is still waiting to fire
+ *
+ * @param wheel the wheel the timer was scheduled on
+ * @param id the timer
+ *
+ * @return bool whether it is active
+ */
+bool timerPending (const TimerWheel *wheel, TimerId id)
+{
+  return nodeOf(wheel, id) >= 0;
+}
+
+/**
+ * This function will check a cooldown, and start it again if it has run out
+ *
+ * each entity keeps a TimerId per cooldown, it costs nothing while it runs and frees itself when it ends
+ *
+ * @param wheel the wheel the cooldown runs on
+ * @param cooldown the entity's cooldown, TIMER_NONE to start with
+ * @param duration milliseconds the cooldown lasts once started
+ *
+ * @return bool true if the cooldown had run out, and it has been started again
+ */
+bool timerCooldownReady (TimerWheel *wheel, TimerId *cooldown, Uint32 duration)
+{
+  if (timerPending(wheel, *cooldown))
+  {
+    return false;
+  }
+
+  *cooldown = timerSchedule(wheel, duration, 0, NULL, NULL);
+  return true;
+}
+
+/**
+ * This function will move the timers in one slot of a higher level down to the levels below
+ *
+ * @param wheel the wheel to cascade
+ * @param level the level of the slot
+ * @param slot the slot
+ *
+ * @return void
+ */
+static void cascade (TimerWheel *wheel, int level, int slot)
+{
+  TimerNode *nodes = (*wheel).nodes;
+  int head = level * TIMER_SLOTS + slot;
+  while (nodes[head].next != head)
+  {
+    int node = nodes[head].next;
+    listUnlink(wheel, node);
+    place(wheel, node);
+    ++(*wheel).cascaded;
+  }
+}
+
+/**
+ * This function will advance the wheel, firing every timer that falls due on the way
+ *
+ * empty stretches are skipped using the slot bitmaps, so the cost is in the slots with timers, not the time passed
+ *
+ * @param wheel the wheel to advance
+ * @param now the time to advance to, in milliseconds
+ *
+ * @return int the number of timers fired
+ */
+int timerWheelAdvance (TimerWheel *wheel, Uint64 now)
+{
+  TimerNode *nodes = (*wheel).nodes;
+  int fired = 0;
+
+  while ((*wheel).current < now)
+  {
+    // step to whichever comes first, the next slot with timers, the next cascade, or now
+    Uint64 boundary = ((*wheel).current | (TIMER_SLOTS - 1)) + 1;
+    (*wheel).current = min(min(now, boundary), nextFirstLevelSlot(wheel));
+    Uint64 current = (*wheel).current;
+
+    // at the start of every 256 ms, the higher levels' slots for this time are moved down, the highest first
+    if ((current & (TIMER_SLOTS - 1)) == 0)
+    {
+      for (int level = TIMER_LEVELS - 1; level > 0; --level)
+      {
+        if ((current & ((1ull << (TIMER_SLOT_BITS * level)) - 1)) == 0)
+        {
+          cascade(wheel, level, (int) ((current >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1)));
+        }
+      }
+    }
+
+    // move the slot's timers aside first, so callbacks can schedule and cancel freely
+    int slot = (int) (current & (TIMER_SLOTS - 1));
+    while (nodes[slot].next != slot)
+    {
+      int node = nodes[slot].next;
+      listUnlink(wheel, node);
+      listAppend(wheel, FIRING_HEAD, node);
+    }
+
+    while (nodes[FIRING_HEAD].next != FIRING_HEAD)
+    {
+      int node = nodes[FIRING_HEAD].next;
+      TimerCallback callback = nodes[node].callback;
+      void *userdata = nodes[node].userdata;
+      Uint64 deadline = nodes[node].deadline;
+      listUnlink(wheel, node);
+
+      // a repeating timer is placed again before its callback runs, so the callback can cancel it
+      if (nodes[node].period > 0)
+      {
+        nodes[node].deadline += nodes[node].period;
+        place(wheel, node);
+      }
+      else
+      {
+        freeNode(wheel, node);
+      }
+
+      if (callback != NULL)
+      {
+        callback(userdata, deadline);
+      }
+      ++fired;
+    }
+  }
+
+  (*wheel).fired += fired;
+  return fired;
+}
+
+/**
+ * This function will give a time the wheel should next be advanced at, for sleeping until then
+ *
+ * it is exact for timers in the first level, and the next cascade when higher levels have timers
+ *
+ * @param wheel the wheel to check
+ *
+ * @return Uint64 the time in milliseconds, never later than the next timer, UINT64_MAX when none are active
+ */
+Uint64 timerWheelNextDeadline (const TimerWheel *wheel)
+{
+  if ((*wheel).activeCount == 0)
+  {
+    return UINT64_MAX;
+  }
+
+  Uint64 next = nextFirstLevelSlot(wheel);
+  for (int level = 1; level < TIMER_LEVELS; ++level)
+  {
+    for (int word = 0; word < TIMER_SLOTS / 64; ++word)
+    {
+      if ((*wheel).occupied[level][word] != 0)
+      {
+        return min(next, ((*wheel).current | (TIMER_SLOTS - 1)) + 1);
+      }
+    }
+  }
+  return next;
+}
+
+/**
+ * This function will print the wheel's activity since the last report and start a new one
+ *
+ * @param wheel the wheel to report on
+ * @param out the stream to print to
+ *
+ * @return void
+ */
+void timerWheelPrintReport (TimerWheel *wheel, FILE *out)
+{
+  fprintf(out, "TIMERS: %d active, %d fired, %d moved down a level\n",
+          (*wheel).activeCount, (*wheel).fired, (*wheel).cascaded);
+  (*wheel).fired = 0;
+  (*wheel).cascaded = 0;
+}
+
+/**
+ * This function will free the wheel, its timers are dropped without firing
+ *
+ * @param wheel the wheel to free
+ *
+ * @return void
+ */
+void timerWheelDestroy (TimerWheel *wheel)
+{
+  memFree(MEM_GENERAL, (*wheel).nodes);
+  (*wheel).nodes = NULL;
+  (*wheel).capacity = 0;
+  (*wheel).activeCount = 0;
+}
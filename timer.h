@@ -0,0 +1,57 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL.h>
+
+#define TIMER_LEVELS 4 // each level covers 256 times the span of the one below, 2^32 ms in total
+#define TIMER_SLOT_BITS 8
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_HEADS (TIMER_LEVELS * TIMER_SLOTS + 1) // a list head per slot, and one for timers being fired
+#define TIMER_MAX_DELAY 0xFFFFFFFFull // milliseconds, longer delays are cut to this
+#define TIMER_NONE 0 // an id that never names a timer
+
+// a handle to a timer, it stops naming the timer once the timer has fired or been cancelled
+typedef Uint64 TimerId;
+
+// called when a timer is due, with the time it was due at
+typedef void (*TimerCallback)(void *userdata, Uint64 deadline);
+
+// one timer, kept in a circular list with the others due in the same slot
+typedef struct
+{
+  Uint64 deadline; // milliseconds
+  Uint32 period; // milliseconds between repeats, 0 for a timer that fires once
+  Uint32 generation; // bumped whenever the node is freed, so old ids stop matching
+  int next, prev;
+  int head; // the list the timer is in, -1 when the node is free
+  TimerCallback callback;
+  void *userdata;
+} TimerNode;
+
+// a hierarchical timer wheel with 1 ms slots, scheduling and cancelling never search
+typedef struct
+{
+  TimerNode *nodes; // the list heads come first, then the timers
+  int capacity;
+  int freeList;
+  int activeCount;
+  Uint64 current; // the last millisecond advanced to
+  Uint64 occupied[TIMER_LEVELS][TIMER_SLOTS / 64]; // a bit per slot that has timers in it
+  int fired; // callbacks run since the last report
+  int cascaded; // timers moved down a level since the last report
+} TimerWheel;
+
+Uint64 timerNow(void);
+bool timerWheelInit(TimerWheel *wheel, int capacity, Uint64 now);
+TimerId timerSchedule(TimerWheel *wheel, Uint64 delay, Uint32 period, TimerCallback callback, void *userdata);
+bool timerCancel(TimerWheel *wheel, TimerId id);
+bool timerPending(const TimerWheel *wheel, TimerId id);
+bool timerCooldownReady(TimerWheel *wheel, TimerId *cooldown, Uint32 duration);
+int timerWheelAdvance(TimerWheel *wheel, Uint64 now);
+Uint64 timerWheelNextDeadline(const TimerWheel *wheel);
+void timerWheelPrintReport(TimerWheel *wheel, FILE *out);
+void timerWheelDestroy(TimerWheel *wheel);
+
+#endif
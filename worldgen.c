@@ -0,0 +1,840 @@
+// libraries being used for this file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "tiles.h"
+#include "worldgen.h"
+
+#define TILE_FLOOR 0
+#define TILE_WALL 1
+
+// salts that keep the hashes for different decisions independent
+#define SALT_CHUNK 1
+#define SALT_NOISE 2
+#define SALT_EDGE_VERTICAL 3
+#define SALT_EDGE_HORIZONTAL 4
+
+#define NOISE_WALL_LEVEL 150 // noise above this is a wall
+
+// where an edge between two chunks can be crossed, both chunks see the same exit
+typedef struct
+{
+  int position; // first row or column of the opening
+  int width; // 0 when the edge is closed
+} WorldEdge;
+
+/**
+ * This function will hash a seed, a position and a salt (splitmix64), every random choice starts here
+ *
+ * @param seed the world seed
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @param salt what the hash is used for
+ *
+ * @return Uint64 the hash
+ */
+static Uint64 worldHash (Uint64 seed, Sint64 x, Sint64 y, Uint64 salt)
+{
+  Uint64 z = seed ^ (Uint64) x * 0x9E3779B97F4A7C15ull ^ (Uint64) y * 0xC2B2AE3D27D4EB4Full ^ salt * 0x165667B19E3779F9ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+/**
+ * This function will advance a chunk's random number generator (xorshift32)
+ *
+ * @param state the generator state, never zero
+ *
+ * @return Uint32 the next random number
+ */
+static Uint32 nextRandom (Uint32 *state)
+{
+  Uint32 x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/**
+ * This function will divide rounding towards negative infinity, so chunks left of 0 line up with the rest
+ *
+ * @param value the value
+ * @param divisor the divisor, positive
+ *
+ * @return Sint64 the quotient
+ */
+static Sint64 floorDivide (Sint64 value, Sint64 divisor)
+{
+  return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+/**
+ * This function will sample value noise at a world tile, in whole numbers so every machine agrees
+ *
+ * The noise is taken at world coordinates rather than chunk coordinates, so terrain runs on across chunk edges.
+ *
+ * @param seed the world seed
+ * @param x the world tile column
+ * @param y the world tile row
+ * @param cell the spacing of the random lattice in tiles
+ *
+ * @return int the noise, 0 to 255
+ */
+static int valueNoise (Uint64 seed, Sint64 x, Sint64 y, int cell)
+{
+  Sint64 gx = floorDivide(x, cell);
+  Sint64 gy = floorDivide(y, cell);
+  int fx = (int) (x - gx * cell);
+  int fy = (int) (y - gy * cell);
+
+  int a = (int) (worldHash(seed, gx, gy, SALT_NOISE) & 255);
+  int b = (int) (worldHash(seed, gx + 1, gy, SALT_NOISE) & 255);
+  int c = (int) (worldHash(seed, gx, gy + 1, SALT_NOISE) & 255);
+  int d = (int) (worldHash(seed, gx + 1, gy + 1, SALT_NOISE) & 255);
+
+  int top = a * (cell - fx) + b * fx;
+  int bottom = c * (cell - fx) + d * fx;
+  return (top * (cell - fy) + bottom * fy) / (cell * cell);
+}
+
+/**
+ * This function will find the opening on the edge to the right of a chunk, or below it
+ *
+ * Left and right edges are always open so every row of chunks can be walked end to end,
+ * half of the top and bottom edges are open.
+ *
+ * @param seed the world seed
+ * @param chunkX the chunk left of, or above, the edge
+ * @param chunkY the chunk left of, or above, the edge
+ * @param vertical true for the edge on the right, false for the edge below
+ *
+ * @return WorldEdge the opening
+ */
+static WorldEdge worldEdge (Uint64 seed, int chunkX, int chunkY, bool vertical)
+{
+  Uint64 hash = worldHash(seed, chunkX, chunkY, vertical ? SALT_EDGE_VERTICAL : SALT_EDGE_HORIZONTAL);
+  WorldEdge edge = {0, 0};
+
+  if (!vertical && ((hash >> 16) & 1) == 0)
+  {
+    return edge;
+  }
+
+  // openings stay off the corners, the same as the hand-made maps
+  edge.width = 1 + (int) ((hash >> 8) & 1);
+  int length = vertical ? MAP_ROWS : MAP_COLS;
+  edge.position = 1 + (int) (hash % (Uint64) (length - 1 - edge.width));
+  return edge;
+}
+
+/**
+ * This function will carve a floor corridor between two cells, along one axis and then the other
+ *
+ * @param tiles the chunk
+ * @param fromRow the start row
+ * @param fromCol the start column
+ * @param toRow the end row
+ * @param toCol the end column
+ * @param rowsFirst whether to move along the rows first
+ *
+ * @return void
+ */
+static void carveCorridor (int tiles[MAP_ROWS][MAP_COLS], int fromRow, int fromCol, int toRow, int toCol, bool rowsFirst)
+{
+  int row = fromRow, col = fromCol;
+  tiles[row][col] = TILE_FLOOR;
+
+  for (int leg = 0; leg < 2; ++leg)
+  {
+    if (rowsFirst == (leg == 0))
+    {
+      while (row != toRow)
+      {
+        row += row < toRow ? 1 : -1;
+        tiles[row][col] = TILE_FLOOR;
+      }
+    }
+    else
+    {
+      while (col != toCol)
+      {
+        col += col < toCol ? 1 : -1;
+        tiles[row][col] = TILE_FLOOR;
+      }
+    }
+  }
+}
+
+/**
+ * This function will fill the inside of an overworld chunk with noise terrain
+ *
+ * @param tiles the chunk
+ * @param seed the world seed
+ * @param chunkX the chunk column
+ * @param chunkY the chunk row
+ *
+ * @return void
+ */
+static void generateOverworld (int tiles[MAP_ROWS][MAP_COLS], Uint64 seed, int chunkX, int chunkY)
+{
+  for (int row = 1; row < MAP_ROWS - 1; ++row)
+  {
+    for (int col = 1; col < MAP_COLS - 1; ++col)
+    {
+      Sint64 x = (Sint64) chunkX * MAP_COLS + col;
+      Sint64 y = (Sint64) chunkY * MAP_ROWS + row;
+
+      // broad hills with a finer octave on top
+      int noise = (2 * valueNoise(seed, x, y, 8) + valueNoise(seed, x, y, 3)) / 3;
+      tiles[row][col] = noise > NOISE_WALL_LEVEL ? TILE_WALL : TILE_FLOOR;
+    }
+  }
+}
+
+/**
+ * This function will fill the inside of a ruins chunk with rooms joined by corridors
+ *
+ * @param tiles the chunk
+ * @param rng the chunk's random number generator
+ * @param anchorRow set to the row the exits are joined to
+ * @param anchorCol set to the column the exits are joined to
+ *
+ * @return void
+ */
+static void generateRuins (int tiles[MAP_ROWS][MAP_COLS], Uint32 *rng, int *anchorRow, int *anchorCol)
+{
+  int roomCount = 2 + (int) (nextRandom(rng) % 3);
+  int lastRow = 0, lastCol = 0;
+
+  for (int room = 0; room < roomCount; ++room)
+  {
+    int height = 2 + (int) (nextRandom(rng) % 2);
+    int width = 2 + (int) (nextRandom(rng) % 3);
+    int top = 1 + (int) (nextRandom(rng) % (MAP_ROWS - 1 - height));
+    int left = 1 + (int) (nextRandom(rng) % (MAP_COLS - 1 - width));
+
+    for (int row = top; row < top + height; ++row)
+    {
+      for (int col = left; col < left + width; ++col)
+      {
+        tiles[row][col] = TILE_FLOOR;
+      }
+    }
+
+    // each room is joined to the one before it, so they are all connected
+    int centerRow = top + height / 2;
+    int centerCol = left + width / 2;
+    if (room == 0)
+    {
+      *anchorRow = centerRow;
+      *anchorCol = centerCol;
+    }
+    else
+    {
+      carveCorridor(tiles, lastRow, lastCol, centerRow, centerCol, (nextRandom(rng) & 1) != 0);
+    }
+    lastRow = centerRow;
+    lastCol = centerCol;
+  }
+
+  // the ruins have crumbled in places
+  for (int row = 1; row < MAP_ROWS - 1; ++row)
+  {
+    for (int col = 1; col < MAP_COLS - 1; ++col)
+    {
+      if (tiles[row][col] == TILE_WALL && nextRandom(rng) % 8 == 0)
+      {
+        tiles[row][col] = TILE_FLOOR;
+      }
+    }
+  }
+}
+
+/**
+ * This function will open one side of a chunk and join the opening to the anchor
+ *
+ * @param tiles the chunk
+ * @param edge the opening
+ * @param exitTile the exit tile for this side
+ * @param anchorRow the row every exit is joined to
+ * @param anchorCol the column every exit is joined to
+ * @param rng the chunk's random number generator
+ *
+ * @return void
+ */
+static void openExit (int tiles[MAP_ROWS][MAP_COLS], WorldEdge edge, int exitTile, int anchorRow, int anchorCol, Uint32 *rng)
+{
+  for (int i = 0; i < edge.width; ++i)
+  {
+    int row, col, innerRow, innerCol;
+    switch (exitTile)
+    {
+      case WORLD_EXIT_UP:
+        row = 0, col = edge.position + i, innerRow = 1, innerCol = col;
+        break;
+      case WORLD_EXIT_DOWN:
+        row = MAP_ROWS - 1, col = edge.position + i, innerRow = MAP_ROWS - 2, innerCol = col;
+        break;
+      case WORLD_EXIT_LEFT:
+        row = edge.position + i, col = 0, innerRow = row, innerCol = 1;
+        break;
+      default:
+        row = edge.position + i, col = MAP_COLS - 1, innerRow = row, innerCol = MAP_COLS - 2;
+        break;
+    }
+
+    tiles[row][col] = exitTile;
+    if (i == 0)
+    {
+      carveCorridor(tiles, innerRow, innerCol, anchorRow, anchorCol, (nextRandom(rng) & 1) != 0);
+    }
+    tiles[innerRow][innerCol] = TILE_FLOOR;
+  }
+}
+
+/**
+ * This function will generate one chunk of the world
+ *
+ * The chunk only depends on the seed and its coordinates, so chunks can be made in any order on any thread.
+ * The border is wall apart from the exits, and the exit on each edge is shared with the chunk on the other side.
+ *
+ * @param seed the world seed
+ * @param style overworld terrain or ruined rooms
+ * @param chunkX the chunk column
+ * @param chunkY the chunk row
+ * @param tiles the chunk's tiles
+ *
+ * @return void
+ */
+void worldGenerateChunk (Uint64 seed, WorldStyle style, int chunkX, int chunkY, int tiles[MAP_ROWS][MAP_COLS])
+{
+  Uint32 rng = (Uint32) worldHash(seed, chunkX, chunkY, SALT_CHUNK) | 1;
+  int anchorRow = MAP_ROWS / 2, anchorCol = MAP_COLS / 2;
+
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    for (int col = 0; col < MAP_COLS; ++col)
+    {
+      tiles[row][col] = TILE_WALL;
+    }
+  }
+
+  if (style == WORLD_RUINS)
+  {
+    generateRuins(tiles, &rng, &anchorRow, &anchorCol);
+  }
+  else
+  {
+    generateOverworld(tiles, seed, chunkX, chunkY);
+  }
+
+  // the edge above belongs to the chunk above, and the edge on the left to the chunk on the left
+  WorldEdge up = worldEdge(seed, chunkX, chunkY - 1, false);
+  WorldEdge right = worldEdge(seed, chunkX, chunkY, true);
+  WorldEdge down = worldEdge(seed, chunkX, chunkY, false);
+  WorldEdge left = worldEdge(seed, chunkX - 1, chunkY, true);
+  openExit(tiles, up, WORLD_EXIT_UP, anchorRow, anchorCol, &rng);
+  openExit(tiles, right, WORLD_EXIT_RIGHT, anchorRow, anchorCol, &rng);
+  openExit(tiles, down, WORLD_EXIT_DOWN, anchorRow, anchorCol, &rng);
+  openExit(tiles, left, WORLD_EXIT_LEFT, anchorRow, anchorCol, &rng);
+}
+
+/**
+ * This function will check that every exit of a chunk can be walked to from every other
+ *
+ * @param tiles the chunk
+ *
+ * @return bool true when the exits are connected
+ */
+bool worldChunkConnected (int tiles[MAP_ROWS][MAP_COLS])
+{
+  bool reached[MAP_ROWS][MAP_COLS] = {{false}};
+  int stack[MAP_ROWS * MAP_COLS];
+  int top = 0;
+
+  // start the flood from the first exit found
+  for (int cell = 0; cell < MAP_ROWS * MAP_COLS && top == 0; ++cell)
+  {
+    int tile = tiles[cell / MAP_COLS][cell % MAP_COLS];
+    if (tile == WORLD_EXIT_UP || tile == WORLD_EXIT_RIGHT || tile == WORLD_EXIT_DOWN || tile == WORLD_EXIT_LEFT)
+    {
+      reached[cell / MAP_COLS][cell % MAP_COLS] = true;
+      stack[top++] = cell;
+    }
+  }
+
+  while (top > 0)
+  {
+    int cell = stack[--top];
+    int row = cell / MAP_COLS, col = cell % MAP_COLS;
+    static const int steps[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (int i = 0; i < 4; ++i)
+    {
+      int nextRow = row + steps[i][0], nextCol = col + steps[i][1];
+      if (nextRow >= 0 && nextRow < MAP_ROWS && nextCol >= 0 && nextCol < MAP_COLS
+          && !reached[nextRow][nextCol] && tileIsWalkable(tiles[nextRow][nextCol]))
+      {
+        reached[nextRow][nextCol] = true;
+        stack[top++] = nextRow * MAP_COLS + nextCol;
+      }
+    }
+  }
+
+  for (int row = 0; row < MAP_ROWS; ++row)
+  {
+    for (int col = 0; col < MAP_COLS; ++col)
+    {
+      int tile = tiles[row][col];
+      if ((tile == WORLD_EXIT_UP || tile == WORLD_EXIT_RIGHT || tile == WORLD_EXIT_DOWN || tile == WORLD_EXIT_LEFT)
+          && !reached[row][col])
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * This thread function will generate queued chunks until the streamer is destroyed
+ *
+ * @param arg the streamer
+ *
+ * @return void
+ */
+static void* worldWorker (void *arg)
+{
+  WorldStreamer *streamer = arg;
+
+  pthread_mutex_lock(&(*streamer).lock);
+  while (true)
+  {
+    while (!(*streamer).stopping && (*streamer).queueCount == 0)
+    {
+      pthread_cond_wait(&(*streamer).work, &(*streamer).lock);
+    }
+    if ((*streamer).stopping)
+    {
+      break;
+    }
+
+    WorldChunk *chunk = &(*streamer).chunks[(*streamer).queue[(*streamer).queueHead]];
+    (*streamer).queueHead = ((*streamer).queueHead + 1) % WORLD_CACHE_SIZE;
+    --(*streamer).queueCount;
+    (*chunk).state = WORLD_CHUNK_GENERATING;
+
+    // a generating chunk is never handed out or evicted, so its tiles can be written without the lock
+    pthread_mutex_unlock(&(*streamer).lock);
+    worldGenerateChunk((*streamer).seed, (*streamer).style, (*chunk).x, (*chunk).y, (*chunk).tiles);
+    pthread_mutex_lock(&(*streamer).lock);
+
+    (*chunk).state = WORLD_CHUNK_READY;
+    pthread_cond_broadcast(&(*streamer).done);
+  }
+  pthread_mutex_unlock(&(*streamer).lock);
+
+  return NULL;
+}
+
+/**
+ * This function will set up a streamer and start its worker threads
+ *
+ * @param streamer the streamer
+ * @param seed the world seed
+ * @param style overworld terrain or ruined rooms
+ * @param threadCount the number of worker threads, 0 for one per core
+ *
+ * @return bool whether the streamer could start
+ */
+bool worldStreamerInit (WorldStreamer *streamer, Uint64 seed, WorldStyle style, int threadCount)
+{
+  memset(streamer, 0, sizeof(*streamer));
+  (*streamer).seed = seed;
+  (*streamer).style = style;
+
+  (*streamer).chunks = memCalloc(MEM_MAP, WORLD_CACHE_SIZE, sizeof(WorldChunk));
+  if ((*streamer).chunks == NULL)
+  {
+    fprintf(stderr, "World chunks could not be allocated!\n");
+    return false;
+  }
+
+  pthread_mutex_init(&(*streamer).lock, NULL);
+  pthread_cond_init(&(*streamer).work, NULL);
+  pthread_cond_init(&(*streamer).done, NULL);
+
+  if (threadCount <= 0)
+  {
+    threadCount = SDL_GetCPUCount();
+  }
+  threadCount = max(1, min(threadCount, WORLD_MAX_THREADS));
+  for (int t = 0; t < threadCount; ++t)
+  {
+    if (pthread_create(&(*streamer).threads[(*streamer).threadCount], NULL, worldWorker, streamer) == 0)
+    {
+      ++(*streamer).threadCount;
+    }
+  }
+
+  if ((*streamer).threadCount == 0)
+  {
+    fprintf(stderr, "World generation threads could not be started!\n");
+    worldStreamerDestroy(streamer);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * This function will find the slot holding a chunk, the lock must be held
+ *
+ * @param streamer the streamer
+ * @param chunkX the chunk column
+ * @param chunkY the chunk row
+ *
+ * @return WorldChunk* the chunk, or NULL when it is not kept
+ */
+static WorldChunk* findChunk (WorldStreamer *streamer, int chunkX, int chunkY)
+{
+  for (int i = 0; i < WORLD_CACHE_SIZE; ++i)
+  {
+    WorldChunk *chunk = &(*streamer).chunks[i];
+    if ((*chunk).state != WORLD_CHUNK_EMPTY && (*chunk).x == chunkX && (*chunk).y == chunkY)
+    {
+      return chunk;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * This function will move the camera to a chunk and queue every chunk around it that is not kept yet
+ *
+ * Chunks are queued nearest first, so the ones the camera reaches next are ready first.
+ * The slots reused are the ones the camera wanted longest ago, never one near the camera.
+ *
+ * @param streamer the streamer
+ * @param chunkX the chunk column the camera is on
+ * @param chunkY the chunk row the camera is on
+ *
+ * @return void
+ */
+void worldStreamerFocus (WorldStreamer *streamer, int chunkX, int chunkY)
+{
+  pthread_mutex_lock(&(*streamer).lock);
+  Uint32 focus = ++(*streamer).focusCount;
+  (*streamer).focusX = chunkX;
+  (*streamer).focusY = chunkY;
+
+  for (int ring = 0; ring <= WORLD_STREAM_RADIUS; ++ring)
+  {
+    for (int dy = -ring; dy <= ring; ++dy)
+    {
+      for (int dx = -ring; dx <= ring; ++dx)
+      {
+        if (max(abs(dx), abs(dy)) != ring)
+        {
+          continue;
+        }
+
+        WorldChunk *chunk = findChunk(streamer, chunkX + dx, chunkY + dy);
+        if (chunk == NULL)
+        {
+          // take the least recently wanted slot that is not being worked on
+          int victim = -1;
+          for (int i = 0; i < WORLD_CACHE_SIZE; ++i)
+          {
+            WorldChunk *slot = &(*streamer).chunks[i];
+            bool available = (*slot).state == WORLD_CHUNK_EMPTY || (*slot).state == WORLD_CHUNK_READY;
+            if (available && (*slot).lastUsed != focus
+                && (victim < 0 || (*slot).lastUsed < (*streamer).chunks[victim].lastUsed))
+            {
+              victim = i;
+            }
+          }
+          if (victim < 0)
+          {
+            continue;
+          }
+
+          chunk = &(*streamer).chunks[victim];
+          (*chunk).x = chunkX + dx;
+          (*chunk).y = chunkY + dy;
+          (*chunk).state = WORLD_CHUNK_QUEUED;
+          (*streamer).queue[((*streamer).queueHead + (*streamer).queueCount) % WORLD_CACHE_SIZE] = victim;
+          ++(*streamer).queueCount;
+          pthread_cond_signal(&(*streamer).work);
+        }
+        (*chunk).lastUsed = focus;
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&(*streamer).lock);
+}
+
+/**
+ * This function will return a chunk near the camera, waiting for it if it is still being generated
+ *
+ * @param streamer the streamer
+ * @param chunkX the chunk column, within WORLD_STREAM_RADIUS of the last focus
+ * @param chunkY the chunk row, within WORLD_STREAM_RADIUS of the last focus
+ *
+ * @return const WorldChunk* the chunk, valid until the camera moves away from it, or NULL when it is not kept
+ */
+const WorldChunk* worldStreamerGet (WorldStreamer *streamer, int chunkX, int chunkY)
+{
+  pthread_mutex_lock(&(*streamer).lock);
+
+  WorldChunk *chunk = findChunk(streamer, chunkX, chunkY);
+  if (chunk != NULL)
+  {
+    if ((*chunk).state == WORLD_CHUNK_READY)
+    {
+      ++(*streamer).hits;
+    }
+    else
+    {
+      ++(*streamer).misses;
+      while ((*chunk).state != WORLD_CHUNK_READY)
+      {
+        pthread_cond_wait(&(*streamer).done, &(*streamer).lock);
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&(*streamer).lock);
+  return chunk;
+}
+
+/**
+ * This function will stop the worker threads and free the chunks
+ *
+ * @param streamer the streamer
+ *
+ * @return void
+ */
+void worldStreamerDestroy (WorldStreamer *streamer)
+{
+  pthread_mutex_lock(&(*streamer).lock);
+  (*streamer).stopping = true;
+  pthread_cond_broadcast(&(*streamer).work);
+  pthread_mutex_unlock(&(*streamer).lock);
+
+  for (int t = 0; t < (*streamer).threadCount; ++t)
+  {
+    pthread_join((*streamer).threads[t], NULL);
+  }
+  (*streamer).threadCount = 0;
+
+  pthread_cond_destroy(&(*streamer).work);
+  pthread_cond_destroy(&(*streamer).done);
+  pthread_mutex_destroy(&(*streamer).lock);
+  memFree(MEM_MAP, (*streamer).chunks);
+  (*streamer).chunks = NULL;
+}
+
+// the slice of a region one benchmark thread generates
+typedef struct
+{
+  Uint64 seed;
+  WorldStyle style;
+  int size; // the region is size by size chunks
+  int first, count;
+  int (*tiles)[MAP_ROWS][MAP_COLS];
+} WorldSlice;
+
+/**
+ * This thread function will generate its slice of a region
+ *
+ * @param arg the slice
+ *
+ * @return void
+ */
+static void* worldSliceWorker (void *arg)
+{
+  WorldSlice *slice = arg;
+  for (int i = (*slice).first; i < (*slice).first + (*slice).count; ++i)
+  {
+    // the region is centred on chunk 0, 0 so negative coordinates are covered too
+    int chunkX = i % (*slice).size - (*slice).size / 2;
+    int chunkY = i / (*slice).size - (*slice).size / 2;
+    worldGenerateChunk((*slice).seed, (*slice).style, chunkX, chunkY, (*slice).tiles[i]);
+  }
+  return NULL;
+}
+
+/**
+ * This function will generate a region of chunks split across threads and hash the result
+ *
+ * @param seed the world seed
+ * @param style the world style
+ * @param size the region is size by size chunks
+ * @param threadCount the number of threads
+ * @param tiles the region's chunks, size * size of them
+ * @param seconds set to how long generation took
+ *
+ * @return Uint64 the hash of every tile in the region
+ */
+static Uint64 generateRegion (Uint64 seed, WorldStyle style, int size, int threadCount,
+                              int (*tiles)[MAP_ROWS][MAP_COLS], double *seconds)
+{
+  int chunkCount = size * size;
+  WorldSlice slices[WORLD_MAX_THREADS];
+  pthread_t threads[WORLD_MAX_THREADS];
+  bool started[WORLD_MAX_THREADS];
+  int first = 0;
+  Uint64 start = SDL_GetPerformanceCounter();
+
+  for (int t = 0; t < threadCount; ++t)
+  {
+    int count = chunkCount / threadCount + (t < chunkCount % threadCount ? 1 : 0);
+    slices[t] = (WorldSlice) {seed, style, size, first, count, tiles};
+    first += count;
+
+    started[t] = pthread_create(&threads[t], NULL, worldSliceWorker, &slices[t]) == 0;
+    if (!started[t])
+    {
+      worldSliceWorker(&slices[t]);
+    }
+  }
+  for (int t = 0; t < threadCount; ++t)
+  {
+    if (started[t])
+    {
+      pthread_join(threads[t], NULL);
+    }
+  }
+  *seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+  Uint64 hash = 14695981039346656037ull;
+  const Uint8 *bytes = (const Uint8*) tiles;
+  for (size_t i = 0; i < (size_t) chunkCount * sizeof(*tiles); ++i)
+  {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+/**
+ * This function will check that neighbouring chunks in a region share their exits and every chunk is connected
+ *
+ * @param tiles the region's chunks
+ * @param size the region is size by size chunks
+ *
+ * @return int the number of problems found
+ */
+static int validateRegion (int (*tiles)[MAP_ROWS][MAP_COLS], int size)
+{
+  int problems = 0;
+  for (int i = 0; i < size * size; ++i)
+  {
+    int x = i % size, y = i / size;
+    problems += worldChunkConnected(tiles[i]) ? 0 : 1;
+
+    // an exit on the right must line up with one on the left of the next chunk, and the same going down
+    for (int k = 0; k < MAP_ROWS && x + 1 < size; ++k)
+    {
+      bool here = tiles[i][k][MAP_COLS - 1] == WORLD_EXIT_RIGHT;
+      bool there = tiles[i + 1][k][0] == WORLD_EXIT_LEFT;
+      problems += here != there ? 1 : 0;
+    }
+    for (int k = 0; k < MAP_COLS && y + 1 < size; ++k)
+    {
+      bool here = tiles[i][MAP_ROWS - 1][k] == WORLD_EXIT_DOWN;
+      bool there = tiles[i + size][0][k] == WORLD_EXIT_UP;
+      problems += here != there ? 1 : 0;
+    }
+  }
+  return problems;
+}
+
+/**
+ * This function will measure world generation and check that it does not depend on the thread count
+ *
+ * Each style is generated once on one thread and once on every thread, the two must hash the same.
+ * Then a camera walks across the world through a streamer and counts how often a chunk was not ready in time.
+ *
+ * @param seed the world seed
+ * @param size the region generated is size by size chunks
+ * @param threadCount the number of threads, 0 for one per core
+ *
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE when the output differed or a chunk was broken
+ */
+int runWorldBenchmark (Uint64 seed, int size, int threadCount)
+{
+  if (size <= 0)
+  {
+    fprintf(stderr, "Usage: ./game --world-bench <seed> <size> [threads]\n");
+    return EXIT_FAILURE;
+  }
+  if (threadCount <= 0)
+  {
+    threadCount = SDL_GetCPUCount();
+  }
+  threadCount = max(1, min(threadCount, WORLD_MAX_THREADS));
+
+  int chunkCount = size * size;
+  int (*single)[MAP_ROWS][MAP_COLS] = memCalloc(MEM_MAP, chunkCount, sizeof(*single));
+  int (*parallel)[MAP_ROWS][MAP_COLS] = memCalloc(MEM_MAP, chunkCount, sizeof(*parallel));
+  if (single == NULL || parallel == NULL)
+  {
+    fprintf(stderr, "World benchmark region could not be allocated!\n");
+    memFree(MEM_MAP, single);
+    memFree(MEM_MAP, parallel);
+    return EXIT_FAILURE;
+  }
+
+  bool ok = true;
+  static const char *styleNames[] = {"overworld", "ruins"};
+  for (int style = WORLD_OVERWORLD; style <= WORLD_RUINS; ++style)
+  {
+    double singleSeconds, parallelSeconds;
+    Uint64 singleHash = generateRegion(seed, (WorldStyle) style, size, 1, single, &singleSeconds);
+    Uint64 parallelHash = generateRegion(seed, (WorldStyle) style, size, threadCount, parallel, &parallelSeconds);
+    int problems = validateRegion(parallel, size);
+
+    printf("WORLD %s: %d chunks, %.2f us/chunk on 1 thread, %.0f chunks/s on %d threads, hash %016llx %s, %d problems\n",
+           styleNames[style], chunkCount, singleSeconds * 1e6 / chunkCount, chunkCount / parallelSeconds, threadCount,
+           (unsigned long long) parallelHash, singleHash == parallelHash ? "matches" : "DIFFERS", problems);
+    ok = ok && singleHash == parallelHash && problems == 0;
+  }
+
+  // walk a camera east with a drift up and down, one chunk a step, and see if the streamer keeps ahead
+  WorldStreamer streamer;
+  if (worldStreamerInit(&streamer, seed, WORLD_OVERWORLD, threadCount))
+  {
+    int x = 0, y = 0, mismatches = 0;
+    double worstWait = 0;
+    for (int step = 0; step < chunkCount; ++step)
+    {
+      worldStreamerFocus(&streamer, x, y);
+      Uint64 start = SDL_GetPerformanceCounter();
+      const WorldChunk *chunk = worldStreamerGet(&streamer, x, y);
+      worstWait = max(worstWait, (double) (SDL_GetPerformanceCounter() - start) * 1e6 / SDL_GetPerformanceFrequency());
+
+      int expected[MAP_ROWS][MAP_COLS];
+      worldGenerateChunk(seed, WORLD_OVERWORLD, x, y, expected);
+      mismatches += chunk == NULL || memcmp((*chunk).tiles, expected, sizeof(expected)) != 0 ? 1 : 0;
+
+      // leave the step to the workers, as a frame of the game would
+      SDL_Delay(1);
+      x += 1;
+      y += step % 7 == 3 ? 1 : step % 11 == 5 ? -1 : 0;
+    }
+
+    printf("WORLD streaming: %d steps, %d chunks ready ahead, %d waited for (worst %.1f us), %d mismatches\n",
+           chunkCount, streamer.hits, streamer.misses, worstWait, mismatches);
+    ok = ok && mismatches == 0;
+    worldStreamerDestroy(&streamer);
+  }
+
+  memFree(MEM_MAP, single);
+  memFree(MEM_MAP, parallel);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
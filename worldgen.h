@@ -0,0 +1,62 @@
+#ifndef WORLDGEN_H
+#define WORLDGEN_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <SDL.h>
+#include "game.h"
+
+#define WORLD_CACHE_SIZE 64 // chunks a streamer keeps, at least (2 * WORLD_STREAM_RADIUS + 1) squared
+#define WORLD_STREAM_RADIUS 2 // chunks generated ahead of the camera in every direction
+#define WORLD_MAX_THREADS 64
+
+// the exit tiles, matching the warp conventions of the hand-made maps
+#define WORLD_EXIT_UP 12
+#define WORLD_EXIT_RIGHT 2
+#define WORLD_EXIT_DOWN 13
+#define WORLD_EXIT_LEFT 3
+#define WORLD_MAP_ID_BASE 4 // map ids from here on are world chunks, the ones below are the hand-made maps
+
+typedef enum { WORLD_OVERWORLD, WORLD_RUINS } WorldStyle;
+
+typedef enum { WORLD_CHUNK_EMPTY, WORLD_CHUNK_QUEUED, WORLD_CHUNK_GENERATING, WORLD_CHUNK_READY } WorldChunkState;
+
+// one screen of the world, a chunk is the same size as a map
+typedef struct
+{
+  int x, y; // chunk coordinates
+  WorldChunkState state;
+  Uint32 lastUsed; // the focus that last wanted this chunk
+  int tiles[MAP_ROWS][MAP_COLS];
+} WorldChunk;
+
+// keeps the chunks around a moving camera, generated ahead of time by worker threads
+typedef struct
+{
+  Uint64 seed;
+  WorldStyle style;
+  WorldChunk *chunks;
+  int queue[WORLD_CACHE_SIZE]; // chunk slots waiting for a worker, nearest to the camera first
+  int queueHead, queueCount;
+  pthread_mutex_t lock;
+  pthread_cond_t work; // signalled when a chunk is queued
+  pthread_cond_t done; // signalled when a chunk is ready
+  pthread_t threads[WORLD_MAX_THREADS];
+  int threadCount;
+  bool stopping;
+  Uint32 focusCount;
+  int focusX, focusY; // the chunk the camera was last moved to
+  int hits, misses; // chunks that were, or were not, ready when first asked for
+} WorldStreamer;
+
+void worldGenerateChunk(Uint64 seed, WorldStyle style, int chunkX, int chunkY, int tiles[MAP_ROWS][MAP_COLS]);
+bool worldChunkConnected(int tiles[MAP_ROWS][MAP_COLS]);
+
+bool worldStreamerInit(WorldStreamer *streamer, Uint64 seed, WorldStyle style, int threadCount);
+void worldStreamerFocus(WorldStreamer *streamer, int chunkX, int chunkY);
+const WorldChunk* worldStreamerGet(WorldStreamer *streamer, int chunkX, int chunkY);
+void worldStreamerDestroy(WorldStreamer *streamer);
+
+int runWorldBenchmark(Uint64 seed, int size, int threadCount);
+
+#endif